@@ -20,7 +20,9 @@
 // Based on ISO7816
 
 #define APDU_CODE_OK                        0x9000
+#define APDU_CODE_BUSY                      0x9001
 #define APDU_CODE_EXECUTION_ERROR           0x6400
+#define APDU_CODE_WRONG_LENGTH              0x6700
 #define APDU_CODE_EMPTY_BUFFER              0x6982
 #define APDU_CODE_OUTPUT_BUFFER_TOO_SMALL   0x6983
 #define APDU_CODE_DATA_INVALID              0x6984
@@ -19,11 +19,21 @@
 #include "view.h"
 #include "transaction.h"
 #include "signature.h"
+#include "restream.h"
+#include "scheduler.h"
+#include "pubkey_cache.h"
+#include "bip32_cache.h"
+#include "ecdsa_der.h"
+#include "validator.h"
+#include "batch.h"
+#include "policy_store.h"
+#include "policy.h"
 
 #include <os_io_seproxyhal.h>
 #include <os.h>
 
 #include <string.h>
+#include <stdio.h>
 
 #ifdef TESTING_ENABLED
 // Generate using always the same private data
@@ -41,6 +51,55 @@ uint8_t bip32_depth;
 uint32_t bip32_path[10];
 sigtype_t current_sigtype;
 
+// FORMAT_* flags set with INS_SET_FORMAT
+uint8_t response_format = 0;
+
+// Keys of INS_SIGN_SECP256K1_MULTI_PATH, sign_path_count is 0 for single key requests
+uint8_t sign_path_count = 0;
+uint8_t sign_path_depths[SIGN_MAX_PATHS];
+uint32_t sign_paths[SIGN_MAX_PATHS][10];
+
+void sign_uploaded_transaction();
+
+// Key of the batch, other commands may change bip32_path before the signatures are fetched
+uint8_t batch_bip32_depth;
+uint32_t batch_bip32_path[10];
+
+// Key of the restream transaction, taken from its first packet
+uint8_t restream_bip32_depth;
+uint32_t restream_bip32_path[10];
+
+// A command waits for the user's decision, its reply is sent once the user decides
+bool reply_pending = false;
+
+// Chunked upload progress, package_count is 0 when no upload is in progress
+uint8_t upload_next_index = 0;
+uint8_t upload_package_count = 0;
+
+// v2 upload progress, next_index is 0 when no upload is in progress.
+// total_length counts uploaded bytes, whitespace is dropped before they are
+// stored, so it may exceed the capacity as long as the compacted json fits.
+#define UPLOAD_V2_MAX_LENGTH 0xFFFF
+uint16_t upload_v2_next_index = 0;
+uint32_t upload_v2_total_length = 0;
+uint32_t upload_v2_received = 0;
+
+// INS_BATCH_ADD progress of the transaction being added, as for the v1 upload
+uint8_t batch_upload_next_index = 0;
+uint8_t batch_upload_package_count = 0;
+
+// Starting any upload abandons the others, their packets are refused afterwards
+void upload_reset()
+{
+    upload_next_index = 0;
+    upload_package_count = 0;
+    upload_v2_next_index = 0;
+    upload_v2_total_length = 0;
+    upload_v2_received = 0;
+    batch_upload_next_index = 0;
+    batch_upload_package_count = 0;
+}
+
 unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
 
 unsigned char io_event(unsigned char channel)
@@ -60,6 +119,7 @@ unsigned char io_event(unsigned char channel)
         break;
 
     case SEPROXYHAL_TAG_TICKER_EVENT:   //
+        scheduler_run();
         UX_TICKER_EVENT(G_io_seproxyhal_spi_buffer, {
                 if (UX_ALLOWED) {
                     int redisplay = 0;
@@ -148,34 +208,524 @@ void app_init()
     USB_power(0);
     USB_power(1);
     view_idle(0);
+    transaction_init_slots();
+    scheduler_add(&pubkey_cache_warm);
 }
 
-bool process_chunk(volatile uint32_t* tx, uint32_t rx, bool getBip32)
+// The reply is sent from the UI callbacks once the user decided
+void reply_after_review(volatile uint32_t* flags)
+{
+    *flags |= IO_ASYNCH_REPLY;
+    reply_pending = true;
+}
+
+// Sends the reply of the command that waits for the user. Nothing is sent
+// if no command waits, the host would take it for the reply to its next command.
+// Returns false then.
+bool send_pending_reply(unsigned short length)
+{
+    if (!reply_pending) {
+        return false;
+    }
+    reply_pending = false;
+    io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, length);
+    return true;
+}
+
+// Appends an uploaded chunk to the transaction buffer, json is compacted first
+void append_chunk(uint8_t* data, uint32_t length, bool json)
+{
+    if (json) {
+        int compacted = transaction_compact_json(data, length);
+        if (compacted < 0) {
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        length = compacted;
+    }
+    if (transaction_get_length() + length > transaction_get_capacity()) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    transaction_append(data, length);
+}
+
+bool process_chunk(volatile uint32_t* tx, uint32_t rx, bool getBip32, bool json)
 {
     int packageIndex = G_io_apdu_buffer[OFFSET_PCK_INDEX];
     int packageCount = G_io_apdu_buffer[OFFSET_PCK_COUNT];
 
     uint16_t offset = OFFSET_DATA;
-    if (rx<offset) {
+    if (rx<offset || packageIndex==0 || packageIndex>packageCount) {
         THROW(APDU_CODE_DATA_INVALID);
     }
 
     if (packageIndex==1) {
+        restream_stop();
+        batch_stop();
+        policy_store_cancel();
+        sign_path_count = 0;
         transaction_initialize();
         transaction_reset();
+        upload_reset();
+        upload_next_index = 2;
+        upload_package_count = packageCount;
         if (getBip32) {
             if (!extractBip32(&bip32_depth, bip32_path, rx, OFFSET_DATA)) {
+                upload_package_count = 0;
                 THROW(APDU_CODE_DATA_INVALID);
             }
             return packageIndex==packageCount;
         }
     }
+    else {
+        if (upload_package_count == 0 || packageCount != upload_package_count || packageIndex > upload_next_index) {
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        if (packageIndex < upload_next_index) {
+            // Packet was already appended, the host did not get our reply
+            return packageIndex==packageCount;
+        }
+        upload_next_index++;
+    }
 
-    transaction_append(&(G_io_apdu_buffer[offset]), rx-offset);
+    append_chunk(&(G_io_apdu_buffer[offset]), rx-offset, json);
 
     return packageIndex==packageCount;
 }
 
+uint32_t read_uint32_be(const uint8_t* buffer)
+{
+    return ((uint32_t) buffer[0] << 24) | ((uint32_t) buffer[1] << 16) | ((uint32_t) buffer[2] << 8) | buffer[3];
+}
+
+void write_uint32_be(uint8_t* buffer, uint32_t value)
+{
+    buffer[0] = value >> 24;
+    buffer[1] = value >> 16;
+    buffer[2] = value >> 8;
+    buffer[3] = value;
+}
+
+bool process_chunk_v2(volatile uint32_t* tx, uint32_t rx)
+{
+    uint16_t packageIndex = (G_io_apdu_buffer[OFFSET_V2_INDEX] << 8) | G_io_apdu_buffer[OFFSET_V2_INDEX + 1];
+
+    uint16_t offset = OFFSET_V2_DATA;
+    if (rx<offset) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    if (packageIndex==0) {
+        if (rx<offset+4) {
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        uint32_t total_length = read_uint32_be(&(G_io_apdu_buffer[offset]));
+        if (total_length == 0 || total_length > UPLOAD_V2_MAX_LENGTH) {
+            THROW(APDU_CODE_WRONG_LENGTH);
+        }
+        offset += 4;
+
+        upload_reset();
+        restream_stop();
+        batch_stop();
+        policy_store_cancel();
+        sign_path_count = 0;
+        transaction_initialize();
+        transaction_reset();
+        if (!extractBip32(&bip32_depth, bip32_path, rx, offset)) {
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        offset += 1 + 4 * bip32_depth;
+
+        upload_v2_total_length = total_length;
+        upload_v2_received = 0;
+        upload_v2_next_index = 1;
+    }
+    else {
+        if (upload_v2_next_index == 0 || packageIndex > upload_v2_next_index) {
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        if (packageIndex < upload_v2_next_index) {
+            // Package was already appended, the host did not get our reply
+            bool last = packageIndex == upload_v2_next_index - 1 && upload_v2_received == upload_v2_total_length;
+            if (!last) {
+                write_uint32_be(G_io_apdu_buffer, upload_v2_received);
+                *tx += 4;
+            }
+            return last;
+        }
+        upload_v2_next_index++;
+    }
+
+    uint32_t length = rx - offset;
+    if (upload_v2_received + length > upload_v2_total_length) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    append_chunk(&(G_io_apdu_buffer[offset]), length, true);
+    upload_v2_received += length;
+
+    if (upload_v2_received < upload_v2_total_length) {
+        write_uint32_be(G_io_apdu_buffer, upload_v2_received);
+        *tx += 4;
+        return false;
+    }
+    return true;
+}
+
+// Converts the DER signature in place if compact signatures were requested.
+// Returns the new signature length or 0 if the signature could not be converted.
+unsigned int format_secp256k1_signature(uint8_t* signature, unsigned int length)
+{
+    if (!(response_format & FORMAT_COMPACT_SIGNATURE)) {
+        return length;
+    }
+    uint8_t compact[ECDSA_COMPACT_SIZE];
+    if (ecdsa_der_to_compact(signature, length, compact) != 0) {
+        return 0;
+    }
+    os_memmove(signature, compact, sizeof(compact));
+    return sizeof(compact);
+}
+
+// Writes a secp256k1 public key to the APDU buffer in the requested format
+unsigned int format_secp256k1_public_key(const uint8_t compressed[33])
+{
+    if (response_format & FORMAT_COMPRESSED_PUBLIC_KEY) {
+        os_memmove(G_io_apdu_buffer, compressed, 33);
+        return 33;
+    }
+    keys_decompress_secp256k1(compressed, G_io_apdu_buffer);
+    return 65;
+}
+
+// Reads the bip32 paths (depth followed by the path, repeated) of the first
+// INS_SIGN_SECP256K1_MULTI_PATH packet
+void extract_sign_paths(uint32_t rx)
+{
+    uint8_t count = 0;
+    uint32_t offset = OFFSET_DATA;
+    while (offset < rx) {
+        if (count == SIGN_MAX_PATHS || !extractBip32(&sign_path_depths[count], sign_paths[count], rx, offset)) {
+            upload_package_count = 0;
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        offset += 1 + 4 * sign_path_depths[count];
+        count++;
+    }
+    if (count == 0) {
+        upload_package_count = 0;
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+    sign_path_count = count;
+}
+
+// The first review page shows how many keys sign the transaction
+int multi_path_get_page(char* key, char* value, int page)
+{
+    if (page == 0) {
+        snprintf(key, 32, "Signing keys");
+        snprintf(value, 32, "%d", sign_path_count);
+        return 0;
+    }
+    return transaction_get_page(key, value, page - 1);
+}
+
+// Signs the transaction with every key of the request into the APDU buffer: the number of
+// signatures, then every signature prefixed with its length. The transaction is hashed once
+// for all keys. Returns the reply length or 0 if a signature failed.
+unsigned int write_multi_path_signatures()
+{
+    cx_ecfp_private_key_t privateKey;
+    cx_ecfp_public_key_t* publicKey = NULL;
+#ifdef SIGN_SELF_VERIFY
+    cx_ecfp_public_key_t verifyKey;
+    publicKey = &verifyKey;
+#endif
+
+    uint8_t message_digest[CX_SHA256_SIZE];
+    cx_hash_sha256(transaction_get_buffer(), transaction_get_buffer_length(), message_digest, CX_SHA256_SIZE);
+
+    uint8_t signature[SECP256K1_MAX_SIGNATURE_SIZE];
+    unsigned int position = 1;
+    for (uint8_t i = 0; i < sign_path_count; i++) {
+        unsigned int length = 0;
+        keys_derive(CX_CURVE_256K1, sign_paths[i], sign_path_depths[i], publicKey, &privateKey);
+        int result = sign_secp256k1_digest(
+                message_digest,
+                signature,
+                sizeof(signature),
+                &length,
+                &privateKey,
+                publicKey);
+        os_memset(&privateKey, 0, sizeof(privateKey));
+        if (result == 1) {
+            length = format_secp256k1_signature(signature, length);
+        }
+        if (result != 1 || length == 0) {
+            return 0;
+        }
+
+        G_io_apdu_buffer[position] = length;
+        os_memmove(G_io_apdu_buffer + position + 1, signature, length);
+        position += 1 + length;
+    }
+
+    G_io_apdu_buffer[0] = sign_path_count;
+    return position;
+}
+
+// A sign instruction was answered with APDU_CODE_BUSY, INS_PARSE_POLL continues it
+bool review_pending = false;
+
+// Parse steps a command runs before it is answered with APDU_CODE_BUSY.
+// Every step does a bounded amount of work, common transactions need fewer.
+#define REVIEW_PARSE_STEPS  16
+
+// Runs the steps of a parse job until it is done or the budget is used up
+int run_parse_steps(int (*step)())
+{
+    int status = TRANSACTION_PARSE_BUSY;
+    for (int i = 0; i < REVIEW_PARSE_STEPS && status == TRANSACTION_PARSE_BUSY; i++) {
+        status = step();
+    }
+    return status;
+}
+
+// Runs steps of the parse job and shows the transaction once it is done.
+// The host polls with INS_PARSE_POLL while APDU_CODE_BUSY is returned.
+// The ticker may have finished the job in between, its status is used then.
+void review_transaction(volatile uint32_t *flags)
+{
+    int status = run_parse_steps(&transaction_parse_step);
+    review_pending = status == TRANSACTION_PARSE_BUSY;
+    if (status == TRANSACTION_PARSE_BUSY) {
+        THROW(APDU_CODE_BUSY);
+    }
+    if (status == TRANSACTION_PARSE_FAILED) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    uint8_t policy_curve = POLICY_CURVE_SECP256K1;
+#ifdef FEATURE_ED25519
+    if (current_sigtype == ED25519) {
+        policy_curve = POLICY_CURVE_ED25519;
+    }
+#endif
+    // The policy is bound to a single key, several keys are always reviewed
+    if (sign_path_count == 0
+        && policy_store_allows(transaction_get_parsed(), transaction_get_selected(),
+                               policy_curve, bip32_path, bip32_depth)) {
+        // No review, the reply is sent while signing
+        reply_after_review(flags);
+        sign_uploaded_transaction();
+        return;
+    }
+
+    if (sign_path_count > 0) {
+        view_add_update_transaction_info_event_handler(&multi_path_get_page);
+        view_display_transaction_menu(transaction_get_page_count() + 1);
+    }
+    else {
+        view_add_update_transaction_info_event_handler(&transaction_get_page);
+        view_display_transaction_menu(transaction_get_page_count());
+    }
+
+    reply_after_review(flags);
+}
+
+// Same as review_transaction for all transactions of the batch
+void review_batch(volatile uint32_t *flags)
+{
+    int status = run_parse_steps(&batch_review_step);
+    if (status == TRANSACTION_PARSE_BUSY) {
+        THROW(APDU_CODE_BUSY);
+    }
+    if (status == TRANSACTION_PARSE_FAILED) {
+        batch_stop();
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    view_add_update_transaction_info_event_handler(&batch_get_page);
+    view_display_transaction_menu(batch_get_page_count());
+
+    reply_after_review(flags);
+}
+
+// Adds a transaction to the batch, packets are numbered as for process_chunk.
+// Every reply carries the number of completed transactions.
+void process_batch_chunk(volatile uint32_t* tx, uint32_t rx)
+{
+    int packageIndex = G_io_apdu_buffer[OFFSET_PCK_INDEX];
+    int packageCount = G_io_apdu_buffer[OFFSET_PCK_COUNT];
+
+    if (rx<OFFSET_DATA || packageIndex==0 || packageIndex>packageCount) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    // Only packet 1 was received, its reply was lost
+    bool resent_first = packageIndex==1 && packageCount > 1
+                        && batch_upload_package_count == packageCount && batch_upload_next_index == 2;
+
+    if (packageIndex==1 && !resent_first) {
+        batch_begin_transaction();
+        upload_reset();
+        batch_upload_next_index = 2;
+        batch_upload_package_count = packageCount;
+    }
+    else {
+        if (batch_upload_package_count == 0 || packageCount != batch_upload_package_count
+            || packageIndex > batch_upload_next_index) {
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        if (packageIndex < batch_upload_next_index) {
+            // Packet was already appended, the host did not get our reply
+            G_io_apdu_buffer[0] = batch_get_count();
+            *tx += 1;
+            return;
+        }
+        batch_upload_next_index++;
+    }
+
+    batch_append(&(G_io_apdu_buffer[OFFSET_DATA]), rx-OFFSET_DATA);
+    if (packageIndex==packageCount) {
+        batch_end_transaction();
+    }
+
+    G_io_apdu_buffer[0] = batch_get_count();
+    *tx += 1;
+}
+
+// Signs the batch transactions from first on into the APDU buffer: the number of
+// signatures, then every signature prefixed with its length. Signatures that do not
+// fit are left for the next INS_BATCH_GET_SIGNATURES. Returns the reply length.
+unsigned int batch_write_signatures(uint8_t first)
+{
+    cx_ecfp_private_key_t privateKey;
+    cx_ecfp_public_key_t* publicKey = NULL;
+#ifdef SIGN_SELF_VERIFY
+    cx_ecfp_public_key_t verifyKey;
+    publicKey = &verifyKey;
+#endif
+    keys_derive(CX_CURVE_256K1, batch_bip32_path, batch_bip32_depth, publicKey, &privateKey);
+
+    uint8_t signature[SECP256K1_MAX_SIGNATURE_SIZE];
+    unsigned int position = 1;
+    uint8_t count = 0;
+    for (uint8_t index = first; index < batch_get_count(); index++) {
+        if (position + 1 + sizeof(signature) > IO_APDU_BUFFER_SIZE - 2) {
+            break;
+        }
+
+        uint32_t transaction_length = 0;
+        const uint8_t* transaction = batch_get_transaction(index, &transaction_length);
+        unsigned int length = 0;
+        int result = sign_secp256k1(
+                transaction,
+                transaction_length,
+                signature,
+                sizeof(signature),
+                &length,
+                &privateKey,
+                publicKey);
+        if (result == 1) {
+            length = format_secp256k1_signature(signature, length);
+        }
+        if (result != 1 || length == 0) {
+            os_memset(&privateKey, 0, sizeof(privateKey));
+            THROW(APDU_CODE_SIGN_VERIFY_ERROR);
+        }
+
+        G_io_apdu_buffer[position] = length;
+        os_memmove(G_io_apdu_buffer + position + 1, signature, length);
+        position += 1 + length;
+        count++;
+    }
+    os_memset(&privateKey, 0, sizeof(privateKey));
+
+    G_io_apdu_buffer[0] = count;
+    return position;
+}
+
+// First pass of a restream transaction, packets are hashed and dropped
+bool process_restream_chunk(volatile uint32_t* tx, uint32_t rx)
+{
+    int packageIndex = G_io_apdu_buffer[OFFSET_PCK_INDEX];
+    int packageCount = G_io_apdu_buffer[OFFSET_PCK_COUNT];
+
+    if (rx<OFFSET_DATA) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    if (packageIndex==1) {
+        batch_stop();
+        policy_store_cancel();
+        // Chunks re-sent during review are loaded into the transaction buffer
+        transaction_initialize();
+        upload_reset();
+        restream_start();
+        if (!extractBip32(&restream_bip32_depth, restream_bip32_path, rx, OFFSET_DATA)) {
+            THROW(APDU_CODE_DATA_INVALID);
+        }
+        return packageIndex==packageCount;
+    }
+
+    // Packets have to arrive in order, their index is used to re-request them
+    if (packageIndex > restream_get_page_count() + 2) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+    if (packageIndex < restream_get_page_count() + 2) {
+        // Packet was already hashed, the host did not get our reply
+        return packageIndex==packageCount;
+    }
+    restream_add_chunk(&(G_io_apdu_buffer[OFFSET_DATA]), rx-OFFSET_DATA);
+
+    return packageIndex==packageCount;
+}
+
+// Writes the index of the chunk the displayed page needs (or RESTREAM_NO_CHUNK)
+uint32_t restream_write_request()
+{
+    int missing = restream_get_missing_chunk();
+    G_io_apdu_buffer[0] = RESTREAM_NO_CHUNK;
+    if (missing >= 0) {
+        restream_set_requested(missing);
+        G_io_apdu_buffer[0] = missing;
+    }
+    return 1;
+}
+
+// Signs the digest of the restream transaction, returns the signature length
+uint32_t restream_write_signature()
+{
+    cx_ecfp_private_key_t privateKey;
+    // The public key is only needed to verify the signature
+    cx_ecfp_public_key_t* publicKey = NULL;
+#ifdef SIGN_SELF_VERIFY
+    cx_ecfp_public_key_t verifyKey;
+    publicKey = &verifyKey;
+#endif
+
+    unsigned int length = 0;
+    keys_derive(CX_CURVE_256K1, restream_bip32_path, restream_bip32_depth, publicKey, &privateKey);
+    int result = sign_secp256k1_digest(
+            restream_get_digest(),
+            G_io_apdu_buffer,
+            IO_APDU_BUFFER_SIZE,
+            &length,
+            &privateKey,
+            publicKey);
+    os_memset(&privateKey, 0, sizeof(privateKey));
+
+    if (result == 1) {
+        length = format_secp256k1_signature(G_io_apdu_buffer, length);
+    }
+    if (result != 1 || length == 0) {
+        view_display_signing_error();
+        THROW(APDU_CODE_SIGN_VERIFY_ERROR);
+    }
+    view_display_signing_success();
+    return length;
+}
+
 bool extractBip32(uint8_t* depth, uint32_t path[10], uint32_t rx, uint32_t offset)
 {
     if (rx<offset+1) {
@@ -194,12 +744,7 @@ bool extractBip32(uint8_t* depth, uint32_t path[10], uint32_t rx, uint32_t offse
 
 void extractPubKey(unsigned char* outputBuffer, cx_ecfp_public_key_t* pubKey)
 {
-    for (int i = 0; i < 32; i++) {
-        outputBuffer[i] = pubKey->W[64 - i];
-    }
-    if ((pubKey->W[32] & 1) != 0) {
-        outputBuffer[31] |= 0x80;
-    }
+    keys_compress_ed25519(pubKey, outputBuffer);
 }
 
 void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
@@ -214,8 +759,17 @@ void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
                 THROW(APDU_CODE_CLA_NOT_SUPPORTED);
             }
 
+            // Until the user decides, the host only serves the chunks of the restream
+            // review. Other commands would change the state the review relies on.
+            if (restream_is_active() && restream_get_decision() == RESTREAM_UNDECIDED
+                && G_io_apdu_buffer[OFFSET_INS] != INS_RESTREAM_CHUNK
+                && G_io_apdu_buffer[OFFSET_INS] != INS_GET_VERSION) {
+                THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+            }
+
             switch (G_io_apdu_buffer[OFFSET_INS]) {
             case INS_GET_VERSION: {
+                const bool capabilities = G_io_apdu_buffer[2] == VERSION_CAPABILITIES;
 #ifdef TESTING_ENABLED
                 G_io_apdu_buffer[0] = 0xFF;
 #else
@@ -224,90 +778,344 @@ void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
                 G_io_apdu_buffer[1] = LEDGER_MAJOR_VERSION;
                 G_io_apdu_buffer[2] = LEDGER_MINOR_VERSION;
                 G_io_apdu_buffer[3] = LEDGER_PATCH_VERSION;
-                *tx += 4;
+                if (!capabilities) {
+                    *tx += 4;
+                    THROW(APDU_CODE_OK);
+                }
+                // Capabilities, so hosts can size packages and refuse oversize transactions
+                write_uint32_be(&G_io_apdu_buffer[4], transaction_get_capacity());
+                G_io_apdu_buffer[8] = transaction_get_token_capacity() >> 8;
+                G_io_apdu_buffer[9] = transaction_get_token_capacity();
+                G_io_apdu_buffer[10] = UPLOAD_WINDOW;
+                G_io_apdu_buffer[11] = (IO_APDU_BUFFER_SIZE - OFFSET_V2_DATA) >> 8;
+                G_io_apdu_buffer[12] = (IO_APDU_BUFFER_SIZE - OFFSET_V2_DATA) & 0xFF;
+                *tx += 13;
                 THROW(APDU_CODE_OK);
                 break;
             }
 
+            case INS_UPLOAD_STATUS: {
+                G_io_apdu_buffer[0] = upload_package_count;
+                G_io_apdu_buffer[1] = upload_package_count ? upload_next_index - 1 : 0;
+                uint32_t length = upload_package_count ? transaction_get_buffer_length() : 0;
+                write_uint32_be(&G_io_apdu_buffer[2], length);
+                G_io_apdu_buffer[6] = upload_v2_next_index >> 8;
+                G_io_apdu_buffer[7] = upload_v2_next_index;
+                write_uint32_be(&G_io_apdu_buffer[8], upload_v2_received);
+                write_uint32_be(&G_io_apdu_buffer[12], upload_v2_total_length);
+                *tx += 16;
+                THROW(APDU_CODE_OK);
+            }
+
             case INS_PUBLIC_KEY_SECP256K1: {
                 if (!extractBip32(&bip32_depth, bip32_path, rx, 2)) {
                     THROW(APDU_CODE_DATA_INVALID);
                 }
 
-                cx_ecfp_public_key_t publicKey;
-                cx_ecfp_private_key_t privateKey;
-                uint8_t privateKeyData[32];
+                uint8_t publicKey[PUBKEY_CACHE_KEY_SIZE];
+                pubkey_cache_get(CX_CURVE_256K1, bip32_path, bip32_depth, publicKey);
+
+                *tx += format_secp256k1_public_key(publicKey);
 
-                // Generate keys
-                os_perso_derive_node_bip32(
-                        CX_CURVE_256K1,
-                        bip32_path, bip32_depth,
-                        privateKeyData, NULL);
-                keys_secp256k1(&publicKey, &privateKey, privateKeyData);
-                memset(privateKeyData, 0, 32);
+                THROW(APDU_CODE_OK);
+            }
 
-                os_memmove(G_io_apdu_buffer, publicKey.W, 65);
-                *tx += 65;
+            case INS_SET_FORMAT: {
+                response_format = G_io_apdu_buffer[2] & (FORMAT_COMPACT_SIGNATURE | FORMAT_COMPRESSED_PUBLIC_KEY);
+                G_io_apdu_buffer[0] = response_format;
+                *tx += 1;
+                THROW(APDU_CODE_OK);
+            }
+
+            case INS_GET_XPUB_SECP256K1: {
+                if (!extractBip32(&bip32_depth, bip32_path, rx, 2)) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+                if (!bip32_cache_get_xpub(bip32_path, bip32_depth, G_io_apdu_buffer, G_io_apdu_buffer + 33)) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+                *tx += 33 + 32;
+
+                THROW(APDU_CODE_OK);
+            }
+
+            case INS_GET_ADDRESSES_SECP256K1: {
+                if (!extractBip32(&bip32_depth, bip32_path, rx, 2)) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+                uint16_t offset = 2 + 1 + 4 * bip32_depth;
+                if (rx < offset + 6 || bip32_depth >= 10) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+                uint32_t index = read_uint32_be(&G_io_apdu_buffer[offset]);
+                uint8_t count = G_io_apdu_buffer[offset + 4];
+                uint8_t format = G_io_apdu_buffer[offset + 5];
+                if (format != ADDRESS_FORMAT_PUBLIC_KEY && format != ADDRESS_FORMAT_BECH32) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+
+                // Addresses have a fixed length (hrp, separator, 32 data and 6 checksum characters)
+                uint16_t entry_size = format == ADDRESS_FORMAT_PUBLIC_KEY
+                                      ? 33
+                                      : 1 + sizeof(ADDRESS_BECH32_HRP) + 32 + 6;
+
+                // Reply overwrites the request
+                uint16_t length = 1;
+                uint8_t returned = 0;
+                while (returned < count
+                       && (index & 0x80000000) == 0
+                       && length + entry_size <= IO_APDU_BUFFER_SIZE - 2) {
+                    cx_ecfp_public_key_t publicKey;
+                    cx_ecfp_private_key_t privateKey;
+                    uint8_t compressed[33];
+
+                    bip32_path[bip32_depth] = index;
+                    keys_derive(CX_CURVE_256K1, bip32_path, bip32_depth + 1, &publicKey, &privateKey);
+                    os_memset(&privateKey, 0, sizeof(privateKey));
+                    keys_compress_secp256k1(&publicKey, compressed);
+
+                    if (format == ADDRESS_FORMAT_PUBLIC_KEY) {
+                        os_memmove(&G_io_apdu_buffer[length], compressed, sizeof(compressed));
+                    }
+                    else {
+                        char* address = (char*) &G_io_apdu_buffer[length + 1];
+                        int address_length = keys_address_secp256k1(compressed, ADDRESS_BECH32_HRP, address, entry_size);
+                        if (address_length != entry_size - 1) {
+                            THROW(APDU_CODE_EXECUTION_ERROR);
+                        }
+                        G_io_apdu_buffer[length] = address_length;
+                    }
+                    length += entry_size;
+                    returned++;
+                    index++;
+                }
+                G_io_apdu_buffer[0] = returned;
+                *tx += length;
 
                 THROW(APDU_CODE_OK);
             }
 
             case INS_SIGN_SECP256K1: {
                 current_sigtype = SECP256K1;
-                if (!process_chunk(tx, rx, true))
+                if (!process_chunk(tx, rx, true, true))
+                    THROW(APDU_CODE_OK);
+
+                transaction_parse_start();
+                review_transaction(flags);
+                break;
+            }
+
+            case INS_SIGN_SECP256K1_MULTI_PATH: {
+                current_sigtype = SECP256K1;
+                bool complete = process_chunk(tx, rx, true, true);
+                if (G_io_apdu_buffer[OFFSET_PCK_INDEX] == 1) {
+                    extract_sign_paths(rx);
+                }
+                if (!complete)
+                    THROW(APDU_CODE_OK);
+
+                transaction_parse_start();
+                review_transaction(flags);
+                break;
+            }
+
+            case INS_SIGN_SECP256K1_V2: {
+                current_sigtype = SECP256K1;
+                if (!process_chunk_v2(tx, rx))
+                    THROW(APDU_CODE_OK);
+
+                transaction_parse_start();
+                review_transaction(flags);
+                break;
+            }
+
+            case INS_PARSE_POLL: {
+                if (batch_review_is_running()) {
+                    review_batch(flags);
+                    break;
+                }
+                if (!review_pending) {
+                    THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                }
+                review_transaction(flags);
+                break;
+            }
+
+            case INS_SET_POLICY: {
+                if (!process_chunk(tx, rx, false, false))
                     THROW(APDU_CODE_OK);
 
-                transaction_parse();
-                view_add_update_transaction_info_event_handler(&transaction_get_display_key_value);
-                view_display_transaction_menu(transaction_get_display_pages());
+                if (!policy_store_review()) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+                view_add_update_transaction_info_event_handler(&policy_store_get_page);
+                view_display_transaction_menu(policy_store_get_page_count());
+                reply_after_review(flags);
+                break;
+            }
+
+            case INS_BATCH_START: {
+                if (!extractBip32(&batch_bip32_depth, batch_bip32_path, rx, 2)) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+
+                restream_stop();
+                policy_store_cancel();
+                transaction_initialize();
+                transaction_reset();
+                batch_start();
+                upload_reset();
+                THROW(APDU_CODE_OK);
+            }
+
+            case INS_BATCH_ADD: {
+                if (!batch_is_active()) {
+                    THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                }
+                process_batch_chunk(tx, rx);
+                THROW(APDU_CODE_OK);
+            }
 
-                *flags |= IO_ASYNCH_REPLY;
+            case INS_BATCH_SIGN: {
+                if (!batch_is_active()) {
+                    THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                }
+                current_sigtype = SECP256K1;
+                batch_review_start();
+                review_batch(flags);
                 break;
             }
 
+            case INS_BATCH_GET_SIGNATURES: {
+                if (!batch_is_approved()) {
+                    THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                }
+                *tx += batch_write_signatures(G_io_apdu_buffer[2]);
+                THROW(APDU_CODE_OK);
+            }
+
+            case INS_SIGN_SECP256K1_RESTREAM: {
+                current_sigtype = SECP256K1;
+                if (!process_restream_chunk(tx, rx))
+                    THROW(APDU_CODE_OK);
+
+                restream_finish();
+                view_add_update_transaction_info_event_handler(&restream_get_page);
+                view_display_transaction_menu(restream_get_page_count());
+
+                *tx += restream_write_request();
+                THROW(APDU_CODE_OK);
+            }
+
+            case INS_RESTREAM_CHUNK: {
+                if (!restream_is_active()) {
+                    THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                }
+                // Without data the command only polls for a request or the decision
+                if (rx > OFFSET_DATA) {
+                    if (!restream_load_chunk(
+                            G_io_apdu_buffer[OFFSET_DATA],
+                            &(G_io_apdu_buffer[OFFSET_DATA + 1]),
+                            rx - OFFSET_DATA - 1)) {
+                        THROW(APDU_CODE_DATA_INVALID);
+                    }
+                    if (restream_get_decision() == RESTREAM_UNDECIDED) {
+                        view_redisplay_transaction_info();
+                    }
+                }
+
+                switch (restream_get_decision()) {
+                    case RESTREAM_APPROVED: {
+                        restream_stop();
+                        *tx += restream_write_signature();
+                        THROW(APDU_CODE_OK);
+                    }
+                    case RESTREAM_REJECTED: {
+                        restream_stop();
+                        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                    }
+                    default:
+                        break;
+                }
+                *tx += restream_write_request();
+                THROW(APDU_CODE_OK);
+            }
+
 #ifdef FEATURE_ED25519
             case INS_PUBLIC_KEY_ED25519: {
                 if (!extractBip32(&bip32_depth, bip32_path, rx, 2)) {
                     THROW(APDU_CODE_DATA_INVALID);
                 }
 
-                cx_ecfp_public_key_t publicKey;
-                cx_ecfp_private_key_t privateKey;
-                uint8_t privateKeyData[32];
+                uint8_t publicKey[PUBKEY_CACHE_KEY_SIZE];
+                pubkey_cache_get(CX_CURVE_Ed25519, bip32_path, bip32_depth, publicKey);
 
-                // Generate keys
-                os_perso_derive_node_bip32(
-                        CX_CURVE_Ed25519,
-                        bip32_path, bip32_depth,
-                        privateKeyData, NULL);
-                keys_ed25519(&publicKey, &privateKey, privateKeyData);
-                memset(privateKeyData, 0, 32);
-
-                unsigned char output[32];
-                extractPubKey(output, &publicKey);
-                os_memmove(G_io_apdu_buffer, output, sizeof(output));
-                *tx += sizeof(output);
+                os_memmove(G_io_apdu_buffer, publicKey, 32);
+                *tx += 32;
 
                 THROW(APDU_CODE_OK);
             }
 
             case INS_SIGN_ED25519: {
                 current_sigtype = ED25519;
-                if (!process_chunk(tx, rx, true))
+                if (!process_chunk(tx, rx, true, true))
                     THROW(APDU_CODE_OK);
 
-                transaction_parse();
-                view_add_update_transaction_info_event_handler(&transaction_get_display_key_value);
-                view_display_transaction_menu(transaction_get_display_pages());
+                transaction_parse_start();
+                review_transaction(flags);
+            }
+                break;
+
+            case INS_SIGN_ED25519_V2: {
+                current_sigtype = ED25519;
+                if (!process_chunk_v2(tx, rx))
+                    THROW(APDU_CODE_OK);
 
-                *flags |= IO_ASYNCH_REPLY;
+                transaction_parse_start();
+                review_transaction(flags);
+                break;
             }
+
+            case INS_VALIDATOR_START: {
+                if (!extractBip32(&bip32_depth, bip32_path, rx, 2)) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+
+                current_sigtype = ED25519;
+                validator_start(bip32_path, bip32_depth);
+                view_add_update_transaction_info_event_handler(&validator_get_page);
+                view_display_transaction_menu(validator_get_page_count());
+                reply_after_review(flags);
                 break;
+            }
+
+            case INS_VALIDATOR_SIGN: {
+                // The votes share the token array with the transaction on screen
+                if (!validator_is_active() || view_uiState != UI_IDLE
+                    || review_pending || transaction_parse_is_running()) {
+                    THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                }
+                // Votes fit into one packet and are signed straight from it,
+                // the transaction buffer is left alone
+                if (rx < OFFSET_DATA
+                    || G_io_apdu_buffer[OFFSET_PCK_INDEX] != 1
+                    || G_io_apdu_buffer[OFFSET_PCK_COUNT] != 1) {
+                    THROW(APDU_CODE_DATA_INVALID);
+                }
+
+                // The sign bytes are hashed before the signature is written over them
+                *tx = validator_sign(
+                        G_io_apdu_buffer + OFFSET_DATA,
+                        rx - OFFSET_DATA,
+                        G_io_apdu_buffer,
+                        IO_APDU_BUFFER_SIZE - 2);
+                THROW(APDU_CODE_OK);
+            }
 #endif
 
 #ifdef TESTING_ENABLED
                 case INS_HASH_TEST: {
-                    if (process_chunk(tx, rx, false)) {
+                    if (process_chunk(tx, rx, false, false)) {
                         uint8_t message_digest[CX_SHA256_SIZE];
 
                         cx_hash_sha256(transaction_get_buffer(),
@@ -328,15 +1136,16 @@ void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
                     cx_ecfp_private_key_t privateKey;
                     keys_secp256k1(&publicKey, &privateKey, privateKeyDataTest );
 
-                    os_memmove(G_io_apdu_buffer, publicKey.W, 65);
-                    *tx += 65;
+                    uint8_t compressed[33];
+                    keys_compress_secp256k1(&publicKey, compressed);
+                    *tx += format_secp256k1_public_key(compressed);
 
                     THROW(APDU_CODE_OK);
                 }
                 break;
 
                 case INS_SIGN_SECP256K1_TEST: {
-                    if (process_chunk(tx, rx, false)) {
+                    if (process_chunk(tx, rx, false, false)) {
 
                         unsigned int length = 0;
 
@@ -352,9 +1161,10 @@ void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
                                 G_io_apdu_buffer,
                                 IO_APDU_BUFFER_SIZE,
                                 &length,
-                                &privateKey);
+                                &privateKey,
+                                &publicKey);
 
-                        *tx += length;
+                        *tx += format_secp256k1_signature(G_io_apdu_buffer, length);
                     }
                     THROW(APDU_CODE_OK);
                 }
@@ -377,7 +1187,7 @@ void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
                 break;
 
                 case INS_SIGN_ED25519_TEST: {
-                    if (process_chunk(tx, rx, false)) {
+                    if (process_chunk(tx, rx, false, false)) {
 
                         // Generate keys
                         cx_ecfp_public_key_t publicKey;
@@ -393,7 +1203,8 @@ void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
                                 G_io_apdu_buffer,
                                 IO_APDU_BUFFER_SIZE,
                                 &length,
-                                &privateKey);
+                                &privateKey,
+                                &publicKey);
 
                         *tx += length;
                     }
@@ -432,77 +1243,150 @@ void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx)
 
 void reject_transaction()
 {
+    batch_stop();
+    policy_store_cancel();
+#ifdef FEATURE_ED25519
+    if (validator_is_pending()) {
+        validator_stop();
+    }
+#endif
+    if (restream_is_active()) {
+        // Sent in the reply to the next command of the host
+        restream_decide(false);
+        view_idle(0);
+        return;
+    }
     set_code(G_io_apdu_buffer, 0, APDU_CODE_COMMAND_NOT_ALLOWED);
-    io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
+    send_pending_reply(2);
     view_idle(0);
 }
 
-void sign_transaction()
+// Signs the uploaded transaction, or the restream transaction, and sends the reply
+void sign_uploaded_transaction()
 {
-    // Generate keys
-    cx_ecfp_public_key_t publicKey;
     cx_ecfp_private_key_t privateKey;
-    uint8_t privateKeyData[32];
+    // The public key is only needed to verify the signature
+    cx_ecfp_public_key_t* publicKey = NULL;
+#ifdef SIGN_SELF_VERIFY
+    cx_ecfp_public_key_t verifyKey;
+    publicKey = &verifyKey;
+#endif
 
     unsigned int length = 0;
     int result = 0;
-    switch(current_sigtype)
-    {
-    case SECP256K1:
-        os_perso_derive_node_bip32(
-                CX_CURVE_256K1,
-                bip32_path, bip32_depth,
-                privateKeyData, NULL);
 
-        keys_secp256k1(&publicKey, &privateKey, privateKeyData);
-        memset(privateKeyData, 0, 32);
+    if (restream_is_active()) {
+        // Signed when the host sends its next command
+        restream_decide(true);
+        view_idle(0);
+        return;
+    }
+
+    if (!reply_pending) {
+        // Nobody waits for this signature
+        view_idle(0);
+        return;
+    }
 
+    if (sign_path_count > 0) {
+        length = write_multi_path_signatures();
+        result = length > 0;
+    }
+    else switch(current_sigtype)
+    {
+    case SECP256K1:
+        keys_derive(CX_CURVE_256K1, bip32_path, bip32_depth, publicKey, &privateKey);
         result = sign_secp256k1(
                 transaction_get_buffer(),
                 transaction_get_buffer_length(),
                 G_io_apdu_buffer,
                 IO_APDU_BUFFER_SIZE,
                 &length,
-                &privateKey);
+                &privateKey,
+                publicKey);
+        if (result == 1) {
+            length = format_secp256k1_signature(G_io_apdu_buffer, length);
+            result = length > 0;
+        }
         break;
 #ifdef FEATURE_ED25519
     case ED25519:
-        os_perso_derive_node_bip32(
-                CX_CURVE_Ed25519,
-                bip32_path, bip32_depth,
-                privateKeyData, NULL);
-
-        keys_ed25519(&publicKey, &privateKey, privateKeyData);
-        memset(privateKeyData, 0, 32);
-
+        keys_derive(CX_CURVE_Ed25519, bip32_path, bip32_depth, publicKey, &privateKey);
         result = sign_ed25519(
                 transaction_get_buffer(),
                 transaction_get_buffer_length(),
                 G_io_apdu_buffer,
                 IO_APDU_BUFFER_SIZE,
                 &length,
-                &privateKey);
+                &privateKey,
+                publicKey);
         break;
 #endif
     }
+    os_memset(&privateKey, 0, sizeof(privateKey));
+
     if (result == 1) {
         set_code(G_io_apdu_buffer, length, APDU_CODE_OK);
-        io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, length + 2);
+        send_pending_reply(length + 2);
         view_display_signing_success();
     }
     else {
         set_code(G_io_apdu_buffer, length, APDU_CODE_SIGN_VERIFY_ERROR);
-        io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, length + 2);
+        send_pending_reply(length + 2);
         view_display_signing_error();
     }
 }
 
+void sign_transaction()
+{
+#ifdef FEATURE_ED25519
+    if (validator_is_pending()) {
+        cx_ecfp_public_key_t validatorKey;
+        validator_approve(&validatorKey);
+        extractPubKey(G_io_apdu_buffer, &validatorKey);
+        set_code(G_io_apdu_buffer, 32, APDU_CODE_OK);
+        send_pending_reply(32 + 2);
+        view_idle(0);
+        return;
+    }
+#endif
+
+    if (policy_store_is_pending()) {
+        policy_store_approve();
+        set_code(G_io_apdu_buffer, 0, APDU_CODE_OK);
+        send_pending_reply(2);
+        view_idle(0);
+        return;
+    }
+
+    if (batch_is_ready()) {
+        batch_approve();
+        unsigned int length = batch_write_signatures(0);
+        set_code(G_io_apdu_buffer, length, APDU_CODE_OK);
+        send_pending_reply(length + 2);
+        view_display_signing_success();
+        return;
+    }
+
+    sign_uploaded_transaction();
+}
+
+void clear_key_caches()
+{
+    pubkey_cache_clear();
+    bip32_cache_clear();
+#ifdef FEATURE_ED25519
+    validator_stop();
+#endif
+}
+
 void app_main()
 {
     volatile uint32_t rx = 0, tx = 0, flags = 0;
 
     view_add_reject_transaction_event_handler(&reject_transaction);
     view_add_sign_transaction_event_handler(&sign_transaction);
+    view_add_exit_app_event_handler(&clear_key_caches);
 
     for (;;) {
         volatile uint16_t sw = 0;
@@ -513,8 +1397,16 @@ void app_main()
             {
                 rx = tx;
                 tx = 0;
+                if (transaction_has_pending_commit() && !(flags & IO_ASYNCH_REPLY)) {
+                    // Acknowledge the chunk first, the host sends the next one while we write to flash
+                    io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, rx);
+                    transaction_commit();
+                    rx = 0;
+                }
                 rx = io_exchange(CHANNEL_APDU | flags, rx);
                 flags = 0;
+                // A command that waited for the user has been answered before the next one arrives
+                reply_pending = false;
 
                 if (rx==0) THROW(APDU_CODE_EMPTY_BUFFER);
 
@@ -28,15 +28,127 @@
 #define OFFSET_PCK_COUNT            3  //< Package count offset
 #define OFFSET_DATA                 4  //< Data offset
 
+// v2 packets carry a 16 bit package index instead of index and count
+#define OFFSET_V2_INDEX             2  //< Package index offset (big endian)
+#define OFFSET_V2_DATA              4  //< Data offset
+
+// Packages sent before the device has to reply
+#define UPLOAD_WINDOW               1
+
+// Reply: test mode, major, minor and patch version.
+// With P1 = VERSION_CAPABILITIES the capabilities follow: transaction capacity
+// (4 bytes, big endian), token capacity (2 bytes), upload window and
+// v2 package data size (2 bytes).
 #define INS_GET_VERSION                 0
+#define VERSION_CAPABILITIES            0x01
 #define INS_PUBLIC_KEY_SECP256K1        1
 #define INS_SIGN_SECP256K1              3
 
+// Transactions larger than the transaction buffer (see restream.h)
+// INS_SIGN_SECP256K1_RESTREAM is sent like INS_SIGN_SECP256K1, the device only keeps
+// a digest per packet. The last packet starts the review and is answered with the
+// index (1 byte) of the packet the displayed page needs, 0xFF if none. The host then
+// keeps sending INS_RESTREAM_CHUNK, with the requested packet (packet index followed by
+// the packet data) or without data to poll. Each reply is the next packet index, the
+// signature once the user approved, or COMMAND_NOT_ALLOWED once the user rejected.
+// Packet index 0 is the first packet after the bip32 path. Until the user decides,
+// every other command except INS_GET_VERSION is refused with COMMAND_NOT_ALLOWED.
+#define INS_SIGN_SECP256K1_RESTREAM     5
+#define INS_RESTREAM_CHUNK              6
+
+// Progress of a chunked upload: package count, last received package index
+// and buffered length (4 bytes, big endian), followed by the v2 progress:
+// next package index (2 bytes), received and total length (4 bytes each, all
+// big endian). Only the upload in progress reports non zero values, starting
+// an upload abandons any other. Packets are accepted in order, a packet that
+// was already received is acknowledged again without being appended, so the
+// host can resume right after the last received index.
+#define INS_UPLOAD_STATUS               7
+
+// v2 sign: package 0 holds the total transaction length (4 bytes, big endian)
+// followed by the bip32 path and optionally the first transaction bytes.
+// Following packages hold transaction bytes and may use the whole APDU buffer.
+// The upload ends once the total length has been received. Every intermediate
+// reply carries the number of bytes received so far (4 bytes, big endian).
+// Transactions larger than the buffer are refused with APDU_CODE_WRONG_LENGTH.
+#define INS_SIGN_SECP256K1_V2           8
+#ifdef FEATURE_ED25519
+    #define INS_SIGN_ED25519_V2             9
+#endif
+
+// Transactions are parsed in steps, each command runs a fixed number of them so
+// common transactions are shown right away. While the last sign package or this
+// instruction is answered with APDU_CODE_BUSY the host polls again with it.
+#define INS_PARSE_POLL                  10
+
+// Extended public key of an account path purpose'/coin'/account' (same input as
+// INS_PUBLIC_KEY_SECP256K1), other paths are refused with APDU_CODE_DATA_INVALID.
+// Reply: compressed public key (33 bytes) followed by the chain code (32 bytes).
+#define INS_GET_XPUB_SECP256K1          11
+
+// Keys of consecutive addresses under a base path.
+// Data: depth and base path as for INS_PUBLIC_KEY_SECP256K1, then the first child index
+// (4 bytes, big endian), the number of keys wanted and the format (ADDRESS_FORMAT_*).
+// Reply: number of keys returned, then the keys. As many keys as fit into one reply are
+// returned, the host continues with the next index.
+#define INS_GET_ADDRESSES_SECP256K1     12
+
+#define ADDRESS_FORMAT_PUBLIC_KEY       0   //< 33 byte compressed public keys
+#define ADDRESS_FORMAT_BECH32           1   //< length prefixed bech32 addresses
+#define ADDRESS_BECH32_HRP              "cosmos"
+
+// Encoding of secp256k1 responses for the rest of the session.
+// P1: FORMAT_* flags. Reply: flags now in use.
+#define INS_SET_FORMAT                  13
+
+#define FORMAT_COMPACT_SIGNATURE        0x01    //< 64 byte r || s with low S instead of DER
+#define FORMAT_COMPRESSED_PUBLIC_KEY    0x02    //< 33 byte compressed instead of 65 byte public keys
+
+// Batch of secp256k1 transactions approved at once (see batch.h)
+// INS_BATCH_START      data: depth and path as for INS_PUBLIC_KEY_SECP256K1, empties the batch
+// INS_BATCH_ADD        packets like INS_SIGN_SECP256K1 without the bip32 path, one upload per
+//                      transaction. Reply: number of transactions added so far. A transaction
+//                      that was not completed can not be dropped, the batch is started again.
+// INS_BATCH_SIGN       reviews all transactions, polled like the sign commands while busy.
+//                      Reply on approval: number of signatures, then every signature prefixed
+//                      with its length, as many as fit.
+// INS_BATCH_GET_SIGNATURES     P1: index of the first signature, reply as INS_BATCH_SIGN
+#define INS_BATCH_START                 16
+#define INS_BATCH_ADD                   17
+#define INS_BATCH_SIGN                  18
+#define INS_BATCH_GET_SIGNATURES        19
+
+#define SECP256K1_MAX_SIGNATURE_SIZE    72      //< DER encoded secp256k1 signature
+
+// Auto-sign policy (see policy.h), sent like INS_HASH_TEST. The reply is sent once the
+// user approved the key and rules. Transactions for that key that satisfy the stored
+// policy are signed by the sign commands without review, the others are reviewed as usual.
+#define INS_SET_POLICY                  20
+
+// Same transaction signed with several keys, sent like INS_SIGN_SECP256K1. The first
+// packet holds up to SIGN_MAX_PATHS bip32 paths, each one as depth followed by the path.
+// Reply: number of signatures, then one signature per path prefixed with its length.
+#define INS_SIGN_SECP256K1_MULTI_PATH   21
+
+#define SIGN_MAX_PATHS                  3       //< all signatures fit into one reply
+
 #ifdef FEATURE_ED25519
     #define INS_PUBLIC_KEY_ED25519          2
     #define INS_SIGN_ED25519                4
 #endif
 
+#ifdef FEATURE_ED25519
+    // Validator mode (see validator.h)
+    // Data: depth and path as for INS_PUBLIC_KEY_ED25519. Answered with the
+    // public key (32 bytes) once the user approves.
+    #define INS_VALIDATOR_START             14
+    // A single packet (index 1 of 1) whose data are the sign bytes of a vote or proposal.
+    // Reply: the signature, or APDU_CODE_CONDITIONS_NOT_SATISFIED if height, round and
+    // step do not exceed the last signed ones or the chain differs from the session's.
+    // APDU_CODE_COMMAND_NOT_ALLOWED while a transaction is reviewed.
+    #define INS_VALIDATOR_SIGN              15
+#endif
+
 #define INS_HASH_TEST                   100
 #define INS_PUBLIC_KEY_SECP256K1_TEST   101
 #define INS_SIGN_SECP256K1_TEST         103
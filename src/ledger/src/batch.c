@@ -0,0 +1,319 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "batch.h"
+#include "transaction.h"
+#include "scheduler.h"
+#include "view.h"
+#include "apdu_codes.h"
+#include "json_stream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum {
+    BATCH_IDLE,
+    BATCH_COLLECTING,
+    BATCH_REVIEWING,
+    BATCH_APPROVED
+};
+
+uint8_t batch_state = BATCH_IDLE;
+
+// Transaction i spans batch_offsets[i] to batch_offsets[i + 1] - 1, the last byte is the zero
+uint16_t batch_offsets[BATCH_MAX_TRANSACTIONS + 1];
+uint8_t batch_count = 0;
+bool batch_open = false;            // a transaction has been begun and not ended
+uint32_t batch_length = 0;          // bytes appended so far
+
+// Review
+uint16_t batch_pages[BATCH_MAX_TRANSACTIONS];
+uint8_t batch_parsed = 0;           // transactions with a page count
+int batch_selected = -1;            // transaction that is parsed for display
+
+// Header text of one transaction, built when its header is first shown
+#define BATCH_SUMMARY_SIZE  128
+char batch_summary[BATCH_SUMMARY_SIZE];
+int batch_summary_index = -1;
+
+bool batch_display_job();
+
+void batch_start()
+{
+    batch_state = BATCH_COLLECTING;
+    batch_count = 0;
+    batch_open = false;
+    batch_length = 0;
+    batch_offsets[0] = 0;
+    batch_parsed = 0;
+    batch_selected = -1;
+    batch_summary_index = -1;
+}
+
+bool batch_is_active()
+{
+    return batch_state != BATCH_IDLE;
+}
+
+void batch_stop()
+{
+    batch_state = BATCH_IDLE;
+    batch_count = 0;
+    scheduler_remove(&batch_display_job);
+}
+
+void batch_begin_transaction()
+{
+    // The bytes of an unfinished transaction are already buffered
+    if (batch_state != BATCH_COLLECTING || batch_open || batch_count >= BATCH_MAX_TRANSACTIONS) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+    batch_open = true;
+}
+
+void batch_append(
+        uint8_t* data,
+        uint16_t length)
+{
+    if (!batch_open) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+    int compacted = transaction_compact_json(data, length);
+    if (compacted < 0) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+    // Room for the terminating zero
+    if (batch_length + compacted + 1 > transaction_get_capacity()) {
+        THROW(APDU_CODE_WRONG_LENGTH);
+    }
+    transaction_append(data, compacted);
+    batch_length += compacted;
+}
+
+void batch_end_transaction()
+{
+    // batch_append left room for it
+    uint8_t terminator = 0;
+    transaction_append(&terminator, 1);
+    batch_length++;
+    batch_open = false;
+    batch_count++;
+    batch_offsets[batch_count] = batch_length;
+}
+
+uint8_t batch_get_count()
+{
+    return batch_count;
+}
+
+void batch_select(int index)
+{
+    if (batch_selected == index) {
+        return;
+    }
+    transaction_select(batch_offsets[index], batch_offsets[index + 1] - batch_offsets[index] - 1);
+    batch_selected = index;
+}
+
+void batch_review_start()
+{
+    if (batch_state != BATCH_COLLECTING || batch_open || batch_count == 0) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+    batch_state = BATCH_REVIEWING;
+    batch_parsed = 0;
+    batch_selected = -1;
+    batch_summary_index = -1;
+    batch_select(0);
+    transaction_parse_start();
+}
+
+int batch_review_step()
+{
+    if (batch_parsed == batch_count) {
+        return TRANSACTION_PARSE_DONE;
+    }
+
+    int status = transaction_parse_step();
+    if (status != TRANSACTION_PARSE_DONE) {
+        return status;
+    }
+
+    batch_pages[batch_parsed] = transaction_get_page_count();
+    batch_parsed++;
+    if (batch_parsed == batch_count) {
+        return TRANSACTION_PARSE_DONE;
+    }
+
+    batch_select(batch_parsed);
+    transaction_parse_start();
+    return TRANSACTION_PARSE_BUSY;
+}
+
+bool batch_review_is_running()
+{
+    return batch_state == BATCH_REVIEWING && batch_parsed < batch_count;
+}
+
+bool batch_is_ready()
+{
+    return batch_state == BATCH_REVIEWING && batch_parsed == batch_count;
+}
+
+int batch_get_page_count()
+{
+    int count = 0;
+    for (int i = 0; i < batch_count; i++) {
+        count += 1 + batch_pages[i];
+    }
+    return count;
+}
+
+// Shows the pages of the selected transaction once its parse job has finished
+bool batch_display_job()
+{
+    if (transaction_parse_is_running()) {
+        return true;
+    }
+    view_redisplay_transaction_info();
+    return false;
+}
+
+// Only one transaction is parsed at a time, moving to another one parses it again.
+// The parse runs as a job, its pages are shown once it is done. Transactions that
+// are selected are streamed rather than spilled (see transaction_select), so
+// this costs no flash writes.
+void batch_prepare(int index)
+{
+    if (batch_selected == index) {
+        return;
+    }
+    batch_select(index);
+    transaction_parse_start();
+}
+
+// Appends prefix and length bytes of text, as much as fits
+unsigned int batch_summary_append(
+        unsigned int position,
+        const char* prefix,
+        const char* text,
+        int length)
+{
+    int written = snprintf(batch_summary + position, BATCH_SUMMARY_SIZE - position,
+                           "%s%.*s", prefix, length, text);
+    if (written < 0 || position + written >= BATCH_SUMMARY_SIZE) {
+        return BATCH_SUMMARY_SIZE - 1;
+    }
+    return position + written;
+}
+
+// Appends prefix and the value at path of the transaction, nothing if the path is missing
+unsigned int batch_summary_add(
+        unsigned int position,
+        const char* json,
+        uint16_t length,
+        const char* prefix,
+        const char* path)
+{
+    jsmntok_t token;
+    if (json_stream_find_path(json, length, path, &token) != 1 ||
+        token.type == JSMN_OBJECT || token.type == JSMN_ARRAY) {
+        return position;
+    }
+    return batch_summary_append(position, prefix, json + token.start, token.end - token.start);
+}
+
+// Chain, first message and fee of a transaction,
+// e.g. "test-chain-1 Send 1atom to cosmos1... fee 5photon"
+const char* batch_get_summary(int index)
+{
+    if (batch_summary_index == index) {
+        return batch_summary;
+    }
+    uint32_t length;
+    const char* json = (const char*) batch_get_transaction(index, &length);
+
+    unsigned int position = 0;
+    batch_summary[0] = 0;
+    position = batch_summary_add(position, json, length, "", "chain_id");
+    jsmntok_t token;
+    if (json_stream_find_path(json, length, "msg_bytes/type", &token) == 1) {
+        position = batch_summary_add(position, json, length, " ", "msg_bytes/type");
+    } else if (json_stream_find_path(json, length, "msg_bytes/outputs", &token) == 1) {
+        position = batch_summary_append(position, " Send", "", 0);
+    }
+    position = batch_summary_add(position, json, length, " ", "msg_bytes/outputs/coins/amount");
+    position = batch_summary_add(position, json, length, "", "msg_bytes/outputs/coins/denom");
+    position = batch_summary_add(position, json, length, " to ", "msg_bytes/outputs/address");
+    position = batch_summary_add(position, json, length, " fee ", "fee_bytes/amount/amount");
+    batch_summary_add(position, json, length, "", "fee_bytes/amount/denom");
+
+    batch_summary_index = index;
+    return batch_summary;
+}
+
+int batch_get_page(
+        char* key,
+        char* value,
+        int page)
+{
+    int index = 0;
+    while (index < batch_count - 1 && page > batch_pages[index]) {
+        page -= 1 + batch_pages[index];
+        index++;
+    }
+
+    if (page == 0) {
+        key_scrolling_total_size = 0;
+        snprintf(key, 32, "Transaction %d/%d", index + 1, batch_count);
+        const char* summary = batch_get_summary(index);
+        unsigned int length = strlen(summary);
+        view_scrolling_total_size = length;
+        unsigned int start = view_scrolling_step < length ? view_scrolling_step : 0;
+        snprintf(value, MAX_CHARS_PER_LINE + 1, "%s", summary + start);
+        // Parsing starts while the header is read
+        batch_prepare(index);
+        return 0;
+    }
+
+    batch_prepare(index);
+    if (transaction_parse_is_running()) {
+        view_scrolling_total_size = 0;
+        key_scrolling_total_size = 0;
+        snprintf(key, 32, "Transaction %d/%d", index + 1, batch_count);
+        snprintf(value, 32, "Parsing...");
+        scheduler_add(&batch_display_job);
+        return 0;
+    }
+    return transaction_get_page(key, value, page - 1);
+}
+
+void batch_approve()
+{
+    batch_state = BATCH_APPROVED;
+}
+
+bool batch_is_approved()
+{
+    return batch_state == BATCH_APPROVED;
+}
+
+const uint8_t* batch_get_transaction(
+        uint8_t index,
+        uint32_t* length)
+{
+    *length = batch_offsets[index + 1] - batch_offsets[index] - 1;
+    return transaction_get_buffer() + batch_offsets[index];
+}
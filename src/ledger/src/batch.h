@@ -0,0 +1,85 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+#include "os.h"
+#include <stdbool.h>
+
+// Several transactions reviewed and approved together.
+// The transactions are stored back to back in the transaction buffer, each one
+// followed by a zero byte. They are parsed one after the other for review, the
+// review shows a header page per transaction followed by its pages. The header
+// summarizes the chain, the first message and the fee.
+// After approval the signatures are created as the host fetches them.
+
+#define BATCH_MAX_TRANSACTIONS  16
+
+// Starts an empty batch in a freshly initialized transaction buffer
+void batch_start();
+
+// Returns true from batch_start until batch_stop
+bool batch_is_active();
+
+// Ends the batch and forgets the approval
+void batch_stop();
+
+// Starts the next transaction. Throws if the batch is full or already reviewed,
+// or if the previous transaction was not ended.
+void batch_begin_transaction();
+
+// Appends data to the transaction that has been begun, compacted in place
+// (see transaction_compact_json). Throws APDU_CODE_WRONG_LENGTH if the
+// transaction buffer is full and APDU_CODE_DATA_INVALID on malformed json.
+void batch_append(
+        uint8_t* data,
+        uint16_t length);
+
+// Completes the transaction that has been begun
+void batch_end_transaction();
+
+// Number of completed transactions
+uint8_t batch_get_count();
+
+// Starts parsing the transactions for review
+void batch_review_start();
+
+// Does the next step of parsing (see transaction_parse_step).
+// Returns TRANSACTION_PARSE_BUSY until every transaction has been parsed.
+int batch_review_step();
+
+// Returns true while batch_review_step has work left
+bool batch_review_is_running();
+
+// Returns true once every transaction has been parsed and the batch waits for approval
+bool batch_is_ready();
+
+// Review pages of all transactions. A transaction is parsed again by a job when
+// its pages are reached, "Parsing..." is shown until the job is done.
+int batch_get_page_count();
+
+int batch_get_page(
+        char* key,
+        char* value,
+        int page);
+
+// The user approved the batch
+void batch_approve();
+
+bool batch_is_approved();
+
+// Sign bytes of a completed transaction
+const uint8_t* batch_get_transaction(
+        uint8_t index,
+        uint32_t* length);
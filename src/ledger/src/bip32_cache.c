@@ -0,0 +1,250 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "bip32_cache.h"
+#include "signature.h"
+
+#include <string.h>
+
+#define BIP32_HARDENED          0x80000000
+
+typedef struct {
+    uint8_t valid;
+    uint8_t depth;
+    uint32_t path[BIP32_CACHE_MAX_DEPTH];
+    uint8_t key[32];
+    uint8_t chain[32];
+    uint8_t publicKey[33];          // compressed, needed for the next CKD step
+} bip32_node_t;
+
+// Parent of the last derived key, or the last hardened node
+bip32_node_t bip32_node;
+
+static const uint8_t SECP256K1_N[] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+        0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b,
+        0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41
+};
+
+void bip32_node_public_key(bip32_node_t* node)
+{
+    cx_ecfp_private_key_t privateKey;
+    cx_ecfp_public_key_t publicKey;
+    cx_ecfp_init_private_key(CX_CURVE_256K1, node->key, 32, &privateKey);
+    cx_ecfp_init_public_key(CX_CURVE_256K1, NULL, 0, &publicKey);
+    cx_ecfp_generate_pair(CX_CURVE_256K1, &publicKey, &privateKey, 1);
+    os_memset(&privateKey, 0, sizeof(privateKey));
+
+    keys_compress_secp256k1(&publicKey, node->publicKey);
+}
+
+// Private parent to private child for a non-hardened index.
+// Returns false for the (negligible) case of an invalid child.
+bool bip32_ckd(
+        const bip32_node_t* parent,
+        uint32_t index,
+        uint8_t key[32],
+        uint8_t chain[32])
+{
+    uint8_t data[33 + 4];
+    os_memmove(data, parent->publicKey, 33);
+    data[33] = index >> 24;
+    data[34] = index >> 16;
+    data[35] = index >> 8;
+    data[36] = index;
+
+    uint8_t I[64];
+    cx_hmac_sha512(parent->chain, 32, data, sizeof(data), I, sizeof(I));
+
+    bool valid = cx_math_cmp(I, (const uint8_t*) PIC(SECP256K1_N), 32) < 0;
+    if (valid) {
+        cx_math_addm(key, I, parent->key, (const uint8_t*) PIC(SECP256K1_N), 32);
+        os_memmove(chain, I + 32, 32);
+        valid = !cx_math_is_zero(key, 32);
+    }
+    os_memset(I, 0, sizeof(I));
+    return valid;
+}
+
+// Moves the node one non-hardened level down the path.
+// The public key of the new node is not computed.
+bool bip32_node_step(
+        bip32_node_t* node,
+        const uint32_t* bip32_path)
+{
+    uint8_t key[32];
+    uint8_t chain[32];
+    if (!bip32_ckd(node, bip32_path[node->depth], key, chain)) {
+        os_memset(key, 0, sizeof(key));
+        return false;
+    }
+    os_memmove(node->key, key, 32);
+    os_memmove(node->chain, chain, 32);
+    node->path[node->depth] = bip32_path[node->depth];
+    node->depth++;
+    os_memset(key, 0, sizeof(key));
+    return true;
+}
+
+bool bip32_node_matches(
+        const bip32_node_t* node,
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth)
+{
+    return node->valid
+           && node->depth <= bip32_depth
+           && memcmp(node->path, bip32_path, node->depth * sizeof(uint32_t)) == 0;
+}
+
+// Derives the first hardened_depth levels of the path through the OS
+void bip32_load_hardened(
+        bip32_node_t* node,
+        const uint32_t* bip32_path,
+        uint8_t hardened_depth)
+{
+    os_perso_derive_node_bip32(CX_CURVE_256K1, bip32_path, hardened_depth, node->key, node->chain);
+    os_memmove(node->path, bip32_path, hardened_depth * sizeof(uint32_t));
+    node->depth = hardened_depth;
+    bip32_node_public_key(node);
+    node->valid = 1;
+}
+
+uint8_t bip32_hardened_depth(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth)
+{
+    uint8_t hardened_depth = 0;
+    for (uint8_t i = 0; i < bip32_depth; i++) {
+        if (bip32_path[i] & BIP32_HARDENED) {
+            hardened_depth = i + 1;
+        }
+    }
+    return hardened_depth;
+}
+
+// The cached node can be continued to the path
+bool bip32_node_usable(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t hardened_depth)
+{
+    return bip32_node_matches(&bip32_node, bip32_path, bip32_depth)
+           && bip32_node.depth >= hardened_depth && bip32_node.depth < bip32_depth;
+}
+
+void bip32_cache_derive_node(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t privateKeyData[32],
+        uint8_t chainCode[32])
+{
+    uint8_t hardened_depth = bip32_hardened_depth(bip32_path, bip32_depth);
+
+    // Nothing to gain without a hardened prefix and a non-hardened suffix
+    if (hardened_depth == 0 || hardened_depth == bip32_depth || bip32_depth > BIP32_CACHE_MAX_DEPTH) {
+        os_perso_derive_node_bip32(CX_CURVE_256K1, bip32_path, bip32_depth, privateKeyData, chainCode);
+        return;
+    }
+
+    bip32_node_t node;
+    if (bip32_node_usable(bip32_path, bip32_depth, hardened_depth)) {
+        os_memmove(&node, &bip32_node, sizeof(node));
+    }
+    else {
+        bip32_load_hardened(&node, bip32_path, hardened_depth);
+    }
+
+    while (node.depth < bip32_depth) {
+        if (node.depth == bip32_depth - 1) {
+            os_memmove(&bip32_node, &node, sizeof(node));
+        }
+        if (!bip32_node_step(&node, bip32_path)) {
+            os_memset(&node, 0, sizeof(node));
+            os_perso_derive_node_bip32(CX_CURVE_256K1, bip32_path, bip32_depth, privateKeyData, chainCode);
+            return;
+        }
+        if (node.depth < bip32_depth) {
+            bip32_node_public_key(&node);
+        }
+    }
+
+    os_memmove(privateKeyData, node.key, 32);
+    if (chainCode != NULL) {
+        os_memmove(chainCode, node.chain, 32);
+    }
+    os_memset(&node, 0, sizeof(node));
+}
+
+void bip32_cache_derive(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t privateKeyData[32])
+{
+    bip32_cache_derive_node(bip32_path, bip32_depth, privateKeyData, NULL);
+}
+
+bool bip32_cache_prepare_step(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth)
+{
+    uint8_t hardened_depth = bip32_hardened_depth(bip32_path, bip32_depth);
+    if (hardened_depth == 0 || hardened_depth == bip32_depth || bip32_depth > BIP32_CACHE_MAX_DEPTH) {
+        return false;
+    }
+
+    if (!bip32_node_usable(bip32_path, bip32_depth, hardened_depth)) {
+        bip32_load_hardened(&bip32_node, bip32_path, hardened_depth);
+        return true;
+    }
+    if (bip32_node.depth == bip32_depth - 1) {
+        return false;
+    }
+    if (!bip32_node_step(&bip32_node, bip32_path)) {
+        os_memset(&bip32_node, 0, sizeof(bip32_node));
+        return false;
+    }
+    bip32_node_public_key(&bip32_node);
+    return true;
+}
+
+bool bip32_cache_get_xpub(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t publicKey[33],
+        uint8_t chainCode[32])
+{
+    // A shallower node would give away the keys of every account
+    if (bip32_depth != BIP32_XPUB_DEPTH) {
+        return false;
+    }
+    for (uint8_t i = 0; i < bip32_depth; i++) {
+        if (!(bip32_path[i] & BIP32_HARDENED)) {
+            return false;
+        }
+    }
+
+    if (!bip32_node_matches(&bip32_node, bip32_path, bip32_depth) || bip32_node.depth != bip32_depth) {
+        bip32_load_hardened(&bip32_node, bip32_path, bip32_depth);
+    }
+    os_memmove(publicKey, bip32_node.publicKey, 33);
+    os_memmove(chainCode, bip32_node.chain, 32);
+    return true;
+}
+
+void bip32_cache_clear()
+{
+    os_memset(&bip32_node, 0, sizeof(bip32_node));
+}
@@ -0,0 +1,61 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+#include "os.h"
+#include "cx.h"
+#include <stdbool.h>
+
+// secp256k1 bip32 derivation that keeps one intermediate node in RAM.
+// The node at the deepest hardened level of a path (m/44'/118'/account')
+// is derived by the OS, non-hardened levels below it are derived in the app
+// (CKD). The parent of the last derived key is kept, so keys that only
+// differ in the last index cost a single CKD step.
+
+#define BIP32_CACHE_MAX_DEPTH   10
+// Only account nodes (purpose'/coin'/account') are exported
+#define BIP32_XPUB_DEPTH        3
+
+// Derives the private key of the bip32 path
+void bip32_cache_derive(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t privateKeyData[32]);
+
+// Derives the private key and chain code of a node through the cache
+void bip32_cache_derive_node(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t privateKeyData[32],
+        uint8_t chainCode[32]);
+
+// Derives one level of the parent node of the path into the cache, so the
+// work can be spread over several ticker slices.
+// Returns true if a level was derived, false once the parent node is ready.
+bool bip32_cache_prepare_step(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth);
+
+// Gets the compressed public key and chain code of an account path
+// (e.g. m/44'/118'/account'). The host derives non-hardened children from them.
+// Returns false unless the path has BIP32_XPUB_DEPTH levels, all hardened.
+bool bip32_cache_get_xpub(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t publicKey[33],
+        uint8_t chainCode[32]);
+
+// Forgets all cached nodes
+void bip32_cache_clear();
@@ -0,0 +1,134 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "policy_store.h"
+#include "policy.h"
+#include "transaction.h"
+#include "view.h"
+#include "apdu_codes.h"
+
+#include <stdio.h>
+
+typedef struct {
+    uint16_t length;            // 0 when no policy is stored
+    uint8_t code[POLICY_MAX_SIZE];
+} policy_storage_t;
+
+policy_storage_t N_policy_impl __attribute__ ((aligned(64)));
+#define N_policy (*(policy_storage_t *)PIC(&N_policy_impl))
+
+bool policy_pending = false;
+int policy_pending_rules = 0;
+
+bool policy_store_review()
+{
+    uint32_t length = transaction_get_buffer_length();
+    if (length > POLICY_MAX_SIZE) {
+        return false;
+    }
+    policy_pending_rules = policy_get_rule_count(transaction_get_buffer(), length);
+    policy_pending = policy_pending_rules >= 0;
+    return policy_pending;
+}
+
+bool policy_store_is_pending()
+{
+    return policy_pending;
+}
+
+void policy_store_approve()
+{
+    policy_storage_t policy;
+    policy.length = 0;
+    os_memset(policy.code, 0, sizeof(policy.code));
+    if (policy_pending_rules > 0) {
+        policy.length = transaction_get_buffer_length();
+        os_memmove(policy.code, transaction_get_buffer(), policy.length);
+    }
+    nvm_write((void*) &N_policy, &policy, sizeof(policy));
+    policy_pending = false;
+}
+
+void policy_store_cancel()
+{
+    policy_pending = false;
+}
+
+int policy_store_get_page_count()
+{
+    // The key, then one page per rule
+    return policy_pending_rules > 0 ? policy_pending_rules + 1 : 1;
+}
+
+int policy_store_get_page(
+        char* key,
+        char* value,
+        int page)
+{
+    key_scrolling_total_size = 0;
+    view_scrolling_total_size = 0;
+    if (policy_pending_rules == 0) {
+        snprintf(key, 32, "Auto-sign policy");
+        snprintf(value, 32, "Turn off");
+        return 0;
+    }
+
+    // Values are rendered from the scrolling position on, as much as fits the line
+    int total;
+    if (page == 0) {
+        total = policy_get_key_text(
+                transaction_get_buffer(),
+                transaction_get_buffer_length(),
+                key, 32,
+                value, MAX_CHARS_PER_LINE + 1,
+                view_scrolling_step);
+    }
+    else {
+        total = policy_get_rule_text(
+                transaction_get_buffer(),
+                transaction_get_buffer_length(),
+                page - 1,
+                key, 32,
+                value, MAX_CHARS_PER_LINE + 1,
+                view_scrolling_step);
+    }
+    view_scrolling_total_size = total > 0 ? total : 0;
+    return 0;
+}
+
+bool policy_store_allows(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        uint8_t curve,
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth)
+{
+    if (N_policy.length == 0 || parsed_transaction == NULL) {
+        return false;
+    }
+    // The tokens are positions in the json they were parsed from
+    if (parsed_transaction != transaction_get_parsed() || transaction != transaction_get_selected()) {
+        THROW(APDU_CODE_EXECUTION_ERROR);
+    }
+
+    uint8_t policy_curve, policy_depth;
+    uint32_t policy_path[POLICY_MAX_DEPTH];
+    if (policy_get_key(N_policy.code, N_policy.length, &policy_curve, policy_path, &policy_depth) != 0
+        || policy_curve != curve || policy_depth != bip32_depth
+        || os_memcmp(policy_path, bip32_path, bip32_depth * sizeof(uint32_t)) != 0) {
+        return false;
+    }
+    return policy_evaluate(N_policy.code, N_policy.length, parsed_transaction, transaction) == POLICY_ALLOW;
+}
@@ -0,0 +1,55 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+#include "os.h"
+#include "json_parser.h"
+#include <stdbool.h>
+
+// Auto-sign policy (see policy.h) kept in flash.
+// A new policy is uploaded to the transaction buffer and stored once the user
+// approved its key and rules. A policy without rules turns auto-signing off.
+
+// Starts the review of the policy in the transaction buffer.
+// Returns false if the policy is malformed or too large.
+bool policy_store_review();
+
+// Returns true while the uploaded policy is shown
+bool policy_store_is_pending();
+
+// Stores the uploaded policy
+void policy_store_approve();
+
+// Drops the uploaded policy
+void policy_store_cancel();
+
+// Review pages of the uploaded policy
+int policy_store_get_page_count();
+
+int policy_store_get_page(
+        char* key,
+        char* value,
+        int page);
+
+// Returns true if a policy is stored for the key (curve is one of POLICY_CURVE_*)
+// and the transaction satisfies it.
+// parsed_transaction may be NULL (transactions displayed by re-scanning), those are not allowed.
+// Throws APDU_CODE_EXECUTION_ERROR unless transaction is the json the tokens were parsed from.
+bool policy_store_allows(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        uint8_t curve,
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth);
@@ -0,0 +1,105 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "pubkey_cache.h"
+#include "signature.h"
+#include "bip32_cache.h"
+
+#include <string.h>
+
+#define PUBKEY_CACHE_MAX_DEPTH  10
+
+typedef struct {
+    uint32_t last_use;              // 0 for a free entry
+    uint8_t curve;
+    uint8_t depth;
+    uint32_t path[PUBKEY_CACHE_MAX_DEPTH];
+    uint8_t publicKey[PUBKEY_CACHE_KEY_SIZE];
+} pubkey_cache_entry_t;
+
+pubkey_cache_entry_t pubkey_cache[PUBKEY_CACHE_SIZE];
+uint32_t pubkey_cache_clock = 0;
+
+void pubkey_cache_get(
+        cx_curve_t curve,
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t publicKey[PUBKEY_CACHE_KEY_SIZE])
+{
+    pubkey_cache_entry_t* oldest = &pubkey_cache[0];
+    for (int i = 0; i < PUBKEY_CACHE_SIZE; i++) {
+        pubkey_cache_entry_t* entry = &pubkey_cache[i];
+        if (entry->last_use
+            && entry->curve == curve
+            && entry->depth == bip32_depth
+            && memcmp(entry->path, bip32_path, bip32_depth * sizeof(uint32_t)) == 0) {
+
+            entry->last_use = ++pubkey_cache_clock;
+            os_memmove(publicKey, entry->publicKey, PUBKEY_CACHE_KEY_SIZE);
+            return;
+        }
+        if (entry->last_use < oldest->last_use) {
+            oldest = entry;
+        }
+    }
+
+    cx_ecfp_public_key_t fullKey;
+    cx_ecfp_private_key_t privateKey;
+    keys_derive(curve, bip32_path, bip32_depth, &fullKey, &privateKey);
+    os_memset(&privateKey, 0, sizeof(privateKey));
+
+    os_memset(publicKey, 0, PUBKEY_CACHE_KEY_SIZE);
+    if (curve == CX_CURVE_256K1) {
+        keys_compress_secp256k1(&fullKey, publicKey);
+    }
+    else {
+        keys_compress_ed25519(&fullKey, publicKey);
+    }
+
+    if (bip32_depth > PUBKEY_CACHE_MAX_DEPTH) {
+        return;
+    }
+    oldest->curve = curve;
+    oldest->depth = bip32_depth;
+    os_memmove(oldest->path, bip32_path, bip32_depth * sizeof(uint32_t));
+    os_memmove(oldest->publicKey, publicKey, PUBKEY_CACHE_KEY_SIZE);
+    oldest->last_use = ++pubkey_cache_clock;
+}
+
+bool pubkey_cache_warm()
+{
+    const uint32_t default_path[] = {
+            0x80000000 | 44,
+            0x80000000 | 118,
+            0x80000000 | 0,
+            0,
+            0
+    };
+    const uint8_t depth = sizeof(default_path) / sizeof(default_path[0]);
+
+    // The parent node is prepared one level per slice, the key gets a slice of its own
+    if (bip32_cache_prepare_step(default_path, depth)) {
+        return true;
+    }
+    uint8_t publicKey[PUBKEY_CACHE_KEY_SIZE];
+    pubkey_cache_get(CX_CURVE_256K1, default_path, depth, publicKey);
+    return false;
+}
+
+void pubkey_cache_clear()
+{
+    os_memset(pubkey_cache, 0, sizeof(pubkey_cache));
+    pubkey_cache_clock = 0;
+}
@@ -0,0 +1,40 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+#include "os.h"
+#include "cx.h"
+#include <stdbool.h>
+
+// Public keys of recently used bip32 paths, kept in RAM only in compressed form.
+// The least recently used entry is replaced when the cache is full.
+
+#define PUBKEY_CACHE_SIZE       4
+#define PUBKEY_CACHE_KEY_SIZE   33
+
+// Fills publicKey with the compressed key of the bip32 path: 33 bytes for
+// secp256k1, the 32 byte encoding for ed25519. Derives it on a miss.
+void pubkey_cache_get(
+        cx_curve_t curve,
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        uint8_t publicKey[PUBKEY_CACHE_KEY_SIZE]);
+
+// Derives the key of the default Cosmos path (m/44'/118'/0'/0/0).
+// Scheduler job, does one bip32 level per slice and returns true while levels are left.
+bool pubkey_cache_warm();
+
+// Forgets all keys
+void pubkey_cache_clear();
@@ -0,0 +1,183 @@
+/*******************************************************************************
+*   (c) 2016 Ledger
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "restream.h"
+#include "transaction.h"
+#include "apdu_codes.h"
+#include "view.h"
+#include "json_stream.h"
+
+#include <string.h>
+
+// Digest of every chunk of the first pass and the json lexer state at its start,
+// so a chunk can be displayed on its own
+typedef struct {
+    uint8_t digest[CX_SHA256_SIZE];
+    uint8_t lexer_state;
+} restream_chunk_t;
+
+typedef struct {
+    restream_chunk_t chunks[RESTREAM_MAX_CHUNKS];
+} restream_index_t;
+
+restream_index_t N_restream_index_impl __attribute__ ((aligned(64)));
+#define N_restream_index (*(restream_index_t *)PIC(&N_restream_index_impl))
+
+cx_sha256_t restream_hash;
+uint8_t restream_digest[CX_SHA256_SIZE];
+uint16_t restream_chunk_count = 0;
+uint8_t restream_lexer_state = 0;
+bool restream_active = false;
+uint8_t restream_decision = RESTREAM_UNDECIDED;
+
+// Review state. The loaded chunk is kept in the transaction buffer.
+int restream_wanted = -1;
+int restream_loaded = -1;
+int restream_requested = -1;
+
+void restream_start()
+{
+    cx_sha256_init(&restream_hash);
+    restream_chunk_count = 0;
+    restream_lexer_state = 0;
+    restream_active = false;
+    restream_decision = RESTREAM_UNDECIDED;
+    restream_wanted = -1;
+    restream_loaded = -1;
+    restream_requested = -1;
+}
+
+void restream_add_chunk(
+        const uint8_t* data,
+        uint16_t length)
+{
+    if (restream_chunk_count >= RESTREAM_MAX_CHUNKS) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    restream_chunk_t chunk;
+    cx_hash_sha256(data, length, chunk.digest, CX_SHA256_SIZE);
+    chunk.lexer_state = restream_lexer_state;
+    nvm_write((void*) &N_restream_index.chunks[restream_chunk_count], &chunk, sizeof(chunk));
+    restream_chunk_count++;
+    json_fragment_render((const char*) data, length, &restream_lexer_state, 0, NULL, 0);
+
+    cx_hash(&restream_hash.header, 0, data, length, NULL, 0);
+}
+
+void restream_finish()
+{
+    cx_hash(&restream_hash.header, CX_LAST, NULL, 0, restream_digest, CX_SHA256_SIZE);
+    restream_active = true;
+    restream_decision = RESTREAM_UNDECIDED;
+}
+
+bool restream_is_active()
+{
+    return restream_active;
+}
+
+void restream_stop()
+{
+    restream_active = false;
+    restream_decision = RESTREAM_UNDECIDED;
+    restream_loaded = -1;
+}
+
+void restream_decide(bool approved)
+{
+    if (restream_active) {
+        restream_decision = approved ? RESTREAM_APPROVED : RESTREAM_REJECTED;
+    }
+}
+
+uint8_t restream_get_decision()
+{
+    return restream_decision;
+}
+
+const uint8_t* restream_get_digest()
+{
+    return restream_digest;
+}
+
+int restream_get_page_count()
+{
+    return restream_chunk_count;
+}
+
+int restream_get_page(
+        char* key,
+        char* value,
+        int page)
+{
+    snprintf(key, MAX_CHARS_PER_LINE + 1, "Chunk %d/%d", page + 1, restream_chunk_count);
+    restream_wanted = page;
+
+    if (page != restream_loaded) {
+        view_scrolling_total_size = 0;
+        strcpy(value, "Loading...");
+        return 0;
+    }
+
+    uint8_t lexer_state = N_restream_index.chunks[page].lexer_state;
+    view_scrolling_total_size = json_fragment_render(
+            (const char*) transaction_get_buffer(),
+            transaction_get_buffer_length(),
+            &lexer_state,
+            view_scrolling_step,
+            value,
+            MAX_CHARS_PER_LINE + 1);
+    return 0;
+}
+
+int restream_get_missing_chunk()
+{
+    if (!restream_active || restream_decision != RESTREAM_UNDECIDED || restream_wanted < 0 ||
+        restream_wanted == restream_loaded || restream_wanted == restream_requested) {
+        return -1;
+    }
+    return restream_wanted;
+}
+
+void restream_set_requested(int chunk_index)
+{
+    restream_requested = chunk_index;
+}
+
+bool restream_load_chunk(
+        uint8_t chunk_index,
+        const uint8_t* data,
+        uint16_t length)
+{
+    if (!restream_active || chunk_index >= restream_chunk_count) {
+        return false;
+    }
+
+    uint8_t chunk_digest[CX_SHA256_SIZE];
+    cx_hash_sha256(data, length, chunk_digest, CX_SHA256_SIZE);
+    if (os_memcmp(chunk_digest, N_restream_index.chunks[chunk_index].digest, CX_SHA256_SIZE) != 0) {
+        return false;
+    }
+
+    transaction_reset();
+    transaction_append((unsigned char*) data, length);
+    restream_loaded = chunk_index;
+    if (restream_requested == chunk_index) {
+        restream_requested = -1;
+    }
+    return true;
+}
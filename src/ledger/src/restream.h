@@ -0,0 +1,83 @@
+/*******************************************************************************
+*   (c) 2016 Ledger
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+#include "os.h"
+#include "cx.h"
+#include <stdbool.h>
+
+// Review of transactions larger than the transaction buffer.
+// The first pass only hashes the chunks and keeps a digest per chunk.
+// During review the host re-sends the chunk of the displayed page and
+// the device checks it against the stored digest before showing it.
+
+#define RESTREAM_MAX_CHUNKS     255
+// Chunk index sent to the host when no chunk is needed
+#define RESTREAM_NO_CHUNK       0xFF
+
+#define RESTREAM_UNDECIDED      0
+#define RESTREAM_APPROVED       1
+#define RESTREAM_REJECTED       2
+
+// Starts a new transaction
+void restream_start();
+
+// Hashes the next chunk of the first pass. Throws if there are too many chunks.
+void restream_add_chunk(
+        const uint8_t* data,
+        uint16_t length);
+
+// Completes the first pass
+void restream_finish();
+
+// Returns true while a restream transaction is being reviewed
+bool restream_is_active();
+
+// Ends review (after signing or rejecting)
+void restream_stop();
+
+// Records the user's decision. It is sent in the reply to the next command of the host.
+void restream_decide(bool approved);
+
+// One of RESTREAM_UNDECIDED, RESTREAM_APPROVED or RESTREAM_REJECTED
+uint8_t restream_get_decision();
+
+// SHA-256 of the whole transaction
+const uint8_t* restream_get_digest();
+
+// Number of review pages (one per chunk)
+int restream_get_page_count();
+
+// Fills key and value of a review page. The chunk is shown as text without
+// json syntax. Shows a placeholder and marks the chunk as wanted if it is not loaded.
+int restream_get_page(
+        char* key,
+        char* value,
+        int page);
+
+// Chunk needed by the displayed page that is neither loaded nor requested yet,
+// -1 if none or the user has decided
+int restream_get_missing_chunk();
+
+// Remember that the host has been asked for the chunk
+void restream_set_requested(int chunk_index);
+
+// Checks the re-sent chunk against its digest and makes it available for display
+// Returns false if the data does not match.
+bool restream_load_chunk(
+        uint8_t chunk_index,
+        const uint8_t* data,
+        uint16_t length);
@@ -0,0 +1,76 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "scheduler.h"
+#include <stddef.h>
+#include <stdint.h>
+
+_Static_assert(SCHEDULER_MAX_JOBS >= SCHEDULER_APP_JOBS, "every job needs a slot");
+
+scheduler_job scheduler_jobs[SCHEDULER_MAX_JOBS];
+uint8_t scheduler_next = 0;     // slot that runs on the next tick
+scheduler_job scheduler_running = NULL;
+bool scheduler_running_added = false;   // the running job was added while it ran
+
+void scheduler_add(scheduler_job job)
+{
+    int free_slot = -1;
+    if (job == scheduler_running) {
+        scheduler_running_added = true;
+    }
+    for (int i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+        if (scheduler_jobs[i] == job) {
+            return;
+        }
+        if (scheduler_jobs[i] == NULL && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    // No slot is free only with more jobs than SCHEDULER_APP_JOBS
+    if (free_slot >= 0) {
+        scheduler_jobs[free_slot] = job;
+    }
+}
+
+void scheduler_remove(scheduler_job job)
+{
+    for (int i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+        if (scheduler_jobs[i] == job) {
+            scheduler_jobs[i] = NULL;
+        }
+    }
+}
+
+void scheduler_run()
+{
+    // Round robin, so a long job does not starve the others
+    for (int i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+        uint8_t slot = (scheduler_next + i) % SCHEDULER_MAX_JOBS;
+        scheduler_job job = scheduler_jobs[slot];
+        if (job == NULL) {
+            continue;
+        }
+        scheduler_next = (slot + 1) % SCHEDULER_MAX_JOBS;
+        scheduler_running = job;
+        scheduler_running_added = false;
+        bool more = job();
+        scheduler_running = NULL;
+        // A job that was added again while it ran stays, also in the same slot
+        if (!more && !scheduler_running_added && scheduler_jobs[slot] == job) {
+            scheduler_jobs[slot] = NULL;
+        }
+        return;
+    }
+}
@@ -0,0 +1,42 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+#include <stdbool.h>
+
+// Cooperative scheduler for deferred work. Jobs run one bounded slice
+// per ticker event, so they progress while the user reads the screen.
+
+#define SCHEDULER_MAX_JOBS  4
+
+// Jobs of the app: pubkey_cache_warm, transaction_prepare_next_slot,
+// transaction_parse_job and batch_display_job. A new job is counted here.
+#define SCHEDULER_APP_JOBS  4
+
+// Runs one slice of work. Returns true while the job has work left.
+typedef bool(*scheduler_job)();
+
+// Adds a job. Adding a job that is already scheduled does nothing.
+// There is a slot for every job of the app, adding always succeeds.
+void scheduler_add(scheduler_job job);
+
+// Removes a job before it has finished
+void scheduler_remove(scheduler_job job);
+
+// Runs one slice of the next job. Finished jobs are removed unless they
+// were added again while they ran.
+// Called on ticker events.
+void scheduler_run();
+
@@ -18,15 +18,29 @@
 
 #include "cx.h"
 #include "apdu_codes.h"
+#include "bip32_cache.h"
+#include "bech32.h"
+
+void keys_init(
+        cx_curve_t curve,
+        cx_ecfp_public_key_t* publicKey,
+        cx_ecfp_private_key_t* privateKey,
+        const uint8_t privateKeyData[32])
+{
+    cx_ecfp_init_private_key(curve, privateKeyData, 32, privateKey);
+    if (publicKey == NULL) {
+        return;
+    }
+    cx_ecfp_init_public_key(curve, NULL, 0, publicKey);
+    cx_ecfp_generate_pair(curve, publicKey, privateKey, 1);
+}
 
 void keys_secp256k1(
         cx_ecfp_public_key_t* publicKey,
         cx_ecfp_private_key_t* privateKey,
         const uint8_t privateKeyData[32])
 {
-    cx_ecfp_init_private_key(CX_CURVE_256K1, privateKeyData, 32, privateKey);
-    cx_ecfp_init_public_key(CX_CURVE_256K1, NULL, 0, publicKey);
-    cx_ecfp_generate_pair(CX_CURVE_256K1, publicKey, privateKey, 1);
+    keys_init(CX_CURVE_256K1, publicKey, privateKey, privateKeyData);
 }
 
 void keys_ed25519(
@@ -34,9 +48,105 @@ void keys_ed25519(
         cx_ecfp_private_key_t* privateKey,
         const uint8_t privateKeyData[32])
 {
-    cx_ecfp_init_private_key(CX_CURVE_Ed25519, privateKeyData, 32, privateKey);
-    cx_ecfp_init_public_key(CX_CURVE_Ed25519, NULL, 0, publicKey);
-    cx_ecfp_generate_pair(CX_CURVE_Ed25519, publicKey, privateKey, 1);
+    keys_init(CX_CURVE_Ed25519, publicKey, privateKey, privateKeyData);
+}
+
+void keys_derive(
+        cx_curve_t curve,
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        cx_ecfp_public_key_t* publicKey,
+        cx_ecfp_private_key_t* privateKey)
+{
+    uint8_t privateKeyData[32];
+    if (curve == CX_CURVE_256K1) {
+        bip32_cache_derive(bip32_path, bip32_depth, privateKeyData);
+    }
+    else {
+        os_perso_derive_node_bip32(
+                curve,
+                bip32_path, bip32_depth,
+                privateKeyData, NULL);
+    }
+    keys_init(curve, publicKey, privateKey, privateKeyData);
+    os_memset(privateKeyData, 0, sizeof(privateKeyData));
+}
+
+void keys_compress_secp256k1(
+        const cx_ecfp_public_key_t* publicKey,
+        uint8_t compressed[33])
+{
+    compressed[0] = (publicKey->W[64] & 1) ? 0x03 : 0x02;
+    os_memmove(compressed + 1, publicKey->W + 1, 32);
+}
+
+static const uint8_t SECP256K1_P[] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xfc, 0x2f
+};
+
+// (p + 1) / 4, square roots modulo p are a single exponentiation
+static const uint8_t SECP256K1_SQRT_EXPONENT[] = {
+        0x3f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xbf, 0xff, 0xff, 0x0c
+};
+
+void keys_decompress_secp256k1(
+        const uint8_t compressed[33],
+        uint8_t uncompressed[65])
+{
+    const uint8_t* p = (const uint8_t*) PIC(SECP256K1_P);
+    const uint8_t* x = compressed + 1;
+    uint8_t* y = uncompressed + 33;
+
+    // y^2 = x^3 + 7
+    uint8_t t[32];
+    uint8_t seven[32];
+    os_memset(seven, 0, sizeof(seven));
+    seven[31] = 7;
+    cx_math_multm(t, x, x, p, 32);
+    cx_math_multm(t, t, x, p, 32);
+    cx_math_addm(t, t, seven, p, 32);
+    cx_math_powm(y, t, (const uint8_t*) PIC(SECP256K1_SQRT_EXPONENT), 32, p, 32);
+    if ((y[31] & 1) != (compressed[0] & 1)) {
+        cx_math_sub(y, p, y, 32);
+    }
+
+    uncompressed[0] = 0x04;
+    os_memmove(uncompressed + 1, x, 32);
+}
+
+void keys_compress_ed25519(
+        const cx_ecfp_public_key_t* publicKey,
+        uint8_t compressed[32])
+{
+    for (int i = 0; i < 32; i++) {
+        compressed[i] = publicKey->W[64 - i];
+    }
+    if ((publicKey->W[32] & 1) != 0) {
+        compressed[31] |= 0x80;
+    }
+}
+
+int keys_address_secp256k1(
+        const uint8_t compressed[33],
+        const char* hrp,
+        char* address,
+        unsigned int address_size)
+{
+    uint8_t hash_sha256[CX_SHA256_SIZE];
+    cx_hash_sha256(compressed, 33, hash_sha256, CX_SHA256_SIZE);
+
+    uint8_t hash_ripemd160[20];
+    cx_ripemd160_t ripemd160;
+    cx_ripemd160_init(&ripemd160);
+    cx_hash(&ripemd160.header, CX_LAST, hash_sha256, CX_SHA256_SIZE, hash_ripemd160, sizeof(hash_ripemd160));
+
+    return bech32_encode(address, address_size, hrp, hash_ripemd160, sizeof(hash_ripemd160));
 }
 
 int sign_secp256k1(
@@ -45,15 +155,29 @@ int sign_secp256k1(
         uint8_t* signature,
         unsigned int signature_capacity,
         unsigned int* signature_length,
-        cx_ecfp_private_key_t* privateKey)
+        const cx_ecfp_private_key_t* privateKey,
+        const cx_ecfp_public_key_t* publicKey)
 {
     uint8_t message_digest[CX_SHA256_SIZE];
     cx_hash_sha256(message, message_length, message_digest, CX_SHA256_SIZE);
 
-    cx_ecfp_public_key_t publicKey;
-    cx_ecdsa_init_public_key(CX_CURVE_256K1, NULL, 0, &publicKey);
-    cx_ecfp_generate_pair(CX_CURVE_256K1, &publicKey, privateKey, 1);
+    return sign_secp256k1_digest(
+            message_digest,
+            signature,
+            signature_capacity,
+            signature_length,
+            privateKey,
+            publicKey);
+}
 
+int sign_secp256k1_digest(
+        const uint8_t message_digest[CX_SHA256_SIZE],
+        uint8_t* signature,
+        unsigned int signature_capacity,
+        unsigned int* signature_length,
+        const cx_ecfp_private_key_t* privateKey,
+        const cx_ecfp_public_key_t* publicKey)
+{
     unsigned int info = 0;
     *signature_length = cx_ecdsa_sign(
             privateKey,
@@ -65,19 +189,19 @@ int sign_secp256k1(
             signature_capacity,
             &info);
 
-    os_memset(&privateKey, 0, sizeof(privateKey));
-#ifdef TESTING_ENABLED
-    return cx_ecdsa_verify(
-            &publicKey,
-            CX_LAST,
-            CX_SHA256,
-            message_digest,
-            CX_SHA256_SIZE,
-            signature,
-            *signature_length);
-#else
-    return 1;
+#ifdef SIGN_SELF_VERIFY
+    if (publicKey != NULL) {
+        return cx_ecdsa_verify(
+                publicKey,
+                CX_LAST,
+                CX_SHA256,
+                message_digest,
+                CX_SHA256_SIZE,
+                signature,
+                *signature_length);
+    }
 #endif
+    return 1;
 }
 
 int sign_ed25519(
@@ -86,15 +210,12 @@ int sign_ed25519(
         uint8_t* signature,
         unsigned int signature_capacity,
         unsigned int* signature_length,
-        cx_ecfp_private_key_t* privateKey)
+        const cx_ecfp_private_key_t* privateKey,
+        const cx_ecfp_public_key_t* publicKey)
 {
     uint8_t message_digest[CX_SHA512_SIZE];
     cx_hash_sha512(message, message_length, message_digest, CX_SHA512_SIZE);
 
-    cx_ecfp_public_key_t publicKey;
-    cx_ecfp_init_public_key(CX_CURVE_Ed25519, NULL, 0, &publicKey);
-    cx_ecfp_generate_pair(CX_CURVE_Ed25519, &publicKey, privateKey, 1);
-
     unsigned int info = 0;
 
     *signature_length = cx_eddsa_sign(
@@ -109,20 +230,19 @@ int sign_ed25519(
             signature_capacity,
             &info);
 
-    os_memset(privateKey, 0, sizeof(privateKey));
-
-#ifdef TESTING_ENABLED
-    return cx_eddsa_verify(
-            &publicKey,
-            0,
-            CX_SHA512,
-            message_digest,
-            CX_SHA512_SIZE,
-            NULL,
-            0,
-            signature,
-            *signature_length);
-#else
-    return 1;
+#ifdef SIGN_SELF_VERIFY
+    if (publicKey != NULL) {
+        return cx_eddsa_verify(
+                publicKey,
+                0,
+                CX_SHA512,
+                message_digest,
+                CX_SHA512_SIZE,
+                NULL,
+                0,
+                signature,
+                *signature_length);
+    }
 #endif
+    return 1;
 }
@@ -17,6 +17,11 @@
 #pragma once
 #include "os.h"
 
+// Signatures are verified after signing when SIGN_SELF_VERIFY is defined.
+// This needs the public key and costs one scalar multiplication more.
+
+// Initializes the key pair from the private key data.
+// publicKey may be NULL when only the private key is needed, that skips the scalar multiplication.
 void keys_secp256k1(
         cx_ecfp_public_key_t* publicKey,
         cx_ecfp_private_key_t* privateKey,
@@ -27,13 +32,58 @@ void keys_ed25519(
         cx_ecfp_private_key_t* privateKey,
         const uint8_t privateKeyData[32]);
 
+// Derives the key pair of the bip32 path in a single pass.
+// secp256k1 keys go through the bip32 node cache (bip32_cache.h).
+// publicKey may be NULL, see keys_secp256k1.
+void keys_derive(
+        cx_curve_t curve,
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth,
+        cx_ecfp_public_key_t* publicKey,
+        cx_ecfp_private_key_t* privateKey);
+
+// Writes the 33 byte compressed form of a secp256k1 public key
+void keys_compress_secp256k1(
+        const cx_ecfp_public_key_t* publicKey,
+        uint8_t compressed[33]);
+
+// Writes the 65 byte uncompressed form (0x04, x, y) of a compressed secp256k1 public key
+void keys_decompress_secp256k1(
+        const uint8_t compressed[33],
+        uint8_t uncompressed[65]);
+
+// Writes the 32 byte encoding of an ed25519 public key (y with the sign of x)
+void keys_compress_ed25519(
+        const cx_ecfp_public_key_t* publicKey,
+        uint8_t compressed[32]);
+
+// Bech32 address (RIPEMD160(SHA256(compressed key))) with the given prefix.
+// Returns the address length or -1 if it does not fit into address_size.
+int keys_address_secp256k1(
+        const uint8_t compressed[33],
+        const char* hrp,
+        char* address,
+        unsigned int address_size);
+
+// The signing functions leave the private key untouched, the caller clears it.
+// publicKey is only used to verify the signature and may be NULL.
 int sign_secp256k1(
         const uint8_t* message,
         unsigned int message_length,
         uint8_t* signature,
         unsigned int signature_capacity,
         unsigned int* signature_length,
-        cx_ecfp_private_key_t* privateKey);
+        const cx_ecfp_private_key_t* privateKey,
+        const cx_ecfp_public_key_t* publicKey);
+
+// Same as sign_secp256k1 for a message that has already been hashed with SHA-256
+int sign_secp256k1_digest(
+        const uint8_t message_digest[32],
+        uint8_t* signature,
+        unsigned int signature_capacity,
+        unsigned int* signature_length,
+        const cx_ecfp_private_key_t* privateKey,
+        const cx_ecfp_public_key_t* publicKey);
 
 int sign_ed25519(
         const uint8_t* message,
@@ -41,4 +91,5 @@ int sign_ed25519(
         uint8_t* signature,
         unsigned int signature_capacity,
         unsigned int* signature_length,
-        cx_ecfp_private_key_t* privateKey);
+        const cx_ecfp_private_key_t* privateKey,
+        const cx_ecfp_public_key_t* publicKey);
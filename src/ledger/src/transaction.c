@@ -19,7 +19,9 @@
 #include "view.h"
 #include "apdu_codes.h"
 #include "json_parser.h"
+#include "json_stream.h"
 #include "buffering.h"
+#include "scheduler.h"
 
 // Ram
 #define RAM_BUFFER_SIZE 512
@@ -32,19 +34,159 @@ typedef struct {
     uint8_t buffer[FLASH_BUFFER_SIZE];
 } storage_t;
 
-storage_t N_appdata_impl __attribute__ ((aligned(64)));
-#define N_appdata (*(storage_t *)PIC(&N_appdata_impl))
+// Every transaction that reached flash moves the buffer to the next slot of the
+// ring, so writes are spread over the whole region. Transactions that fit into
+// RAM keep the current slot. Only the part of a slot that was written is
+// cleared again, in small steps while the device is idle.
+// Written slots are also marked in flash, the marks survive a restart. The written
+// size does not, a slot marked in a previous session is cleared as a whole.
+#define FLASH_BUFFER_SLOTS 2
+#define FLASH_PREPARE_STEP 1024
 
-parsed_json_t parsed_transaction;
+storage_t N_appdata_impl[FLASH_BUFFER_SLOTS] __attribute__ ((aligned(64)));
+#define N_appdata(slot) (*(storage_t *)PIC(&N_appdata_impl[slot]))
+
+typedef struct {
+    uint8_t dirty[FLASH_BUFFER_SLOTS];
+} slot_marks_t;
+
+slot_marks_t N_slot_marks_impl __attribute__ ((aligned(64)));
+#define N_slot_marks (*(slot_marks_t *)PIC(&N_slot_marks_impl))
+
+uint8_t flash_slot = 0;                         // slot of the current transaction
+uint16_t flash_used[FLASH_BUFFER_SLOTS];        // bytes of each slot written since it was cleared
+uint16_t flash_prepared = 0;                    // bytes of the next slot already cleared
+
+uint32_t transaction_length = 0;                // bytes appended since the buffer was cleared
+uint8_t transaction_json_state = 0;             // lexer state of transaction_compact_json
+
+// Tokens that do not fit into parsed_json_t are spilled next to the transaction buffer
+#define FLASH_TOKENS_SIZE 1024
+typedef struct {
+    jsmntok_t tokens[FLASH_TOKENS_SIZE];
+} token_storage_t;
+
+token_storage_t N_tokens_impl __attribute__ ((aligned(64)));
+#define N_tokens (*(token_storage_t *)PIC(&N_tokens_impl))
+
+// Transactions with more tokens than parsed_json_t and the spill region can hold
+// are displayed by re-scanning the buffer. Both representations share the same memory.
+typedef union {
+    parsed_json_t tokens;
+    stream_display_t stream;
+} parsed_storage_t;
+
+parsed_storage_t parsed_transaction;
+bool parsed_transaction_streaming = false;
+
+// Parsing runs as a job, every step does a bounded amount of work
+// so the device can answer the host in between.
+#define PARSE_STEP_SIZE     2048    // bytes of the count pass
+#define PARSE_STEP_TOKENS   64      // tokens read (and spilled) or visited while counting pages
+#define PARSE_STEP_ITEMS    32      // display items walked by the streaming display
+
+enum {
+    PARSE_IDLE,
+    PARSE_COUNT,
+    PARSE_TOKENS,
+    PARSE_STREAM,
+    PARSE_PAGES_MSG,
+    PARSE_PAGES_ALT,
+    PARSE_DONE,
+    PARSE_FAILED
+};
+
+uint8_t parse_phase = PARSE_IDLE;
+
+// Only one phase runs at a time, their jobs share the same memory
+typedef union {
+    json_count_job_t count;
+    json_parse_job_t tokens;
+    display_count_job_t pages;
+} parse_job_t;
+
+parse_job_t parse_job;
+int parse_msg_bytes_items = 0;
+
+// Part of the buffer that is parsed and displayed (see transaction_select)
+bool selection_active = false;
+uint32_t selection_offset = 0;
+uint32_t selection_length = 0;
+int parse_page_count = 0;
 
 void update_ram(buffer_state_t* buffer, uint8_t* data, int size)
 {
     os_memmove(buffer->data+buffer->pos, data, size);
 }
 
+void set_slot_mark(uint8_t slot, uint8_t dirty)
+{
+    if (N_slot_marks.dirty[slot] != dirty) {
+        nvm_write((void*) &N_slot_marks.dirty[slot], &dirty, sizeof(dirty));
+    }
+}
+
 void update_flash(buffer_state_t* buffer, uint8_t* data, int size)
 {
+    // Marked before the data lands, a reset in between leaves a slot that is cleared for nothing
+    set_slot_mark(flash_slot, 1);
     nvm_write((void*) buffer->data+buffer->pos, data, size);
+    if (buffer->pos + size > flash_used[flash_slot]) {
+        flash_used[flash_slot] = buffer->pos + size;
+    }
+}
+
+void update_tokens(unsigned int spill_index, const jsmntok_t* tokens, unsigned int count)
+{
+    nvm_write((void*) &N_tokens.tokens[spill_index], (void*) tokens, count * sizeof(jsmntok_t));
+}
+
+bool transaction_prepare_next_slot()
+{
+    uint8_t next_slot = (flash_slot + 1) % FLASH_BUFFER_SLOTS;
+    if (flash_prepared >= flash_used[next_slot]) {
+        flash_used[next_slot] = 0;
+        set_slot_mark(next_slot, 0);
+        return false;
+    }
+    uint16_t step = flash_used[next_slot] - flash_prepared;
+    if (step > FLASH_PREPARE_STEP) {
+        step = FLASH_PREPARE_STEP;
+    }
+    nvm_write((void*) &N_appdata(next_slot).buffer[flash_prepared], NULL, step);
+    flash_prepared += step;
+    if (flash_prepared < flash_used[next_slot]) {
+        return true;
+    }
+    flash_used[next_slot] = 0;
+    set_slot_mark(next_slot, 0);
+    return false;
+}
+
+void transaction_init_slots()
+{
+    for (uint8_t slot = 0; slot < FLASH_BUFFER_SLOTS; slot++) {
+        flash_used[slot] = N_slot_marks.dirty[slot] ? FLASH_BUFFER_SIZE : 0;
+    }
+    // The first transaction that reaches flash moves on to the next slot, clear it ahead
+    uint8_t next_slot = (flash_slot + 1) % FLASH_BUFFER_SLOTS;
+    if (flash_used[flash_slot] > 0 && flash_used[next_slot] > 0) {
+        flash_prepared = 0;
+        scheduler_add(&transaction_prepare_next_slot);
+    }
+}
+
+// Lets the parse job progress while the host waits before polling
+bool transaction_parse_job()
+{
+    return transaction_parse_is_running() && transaction_parse_step() == TRANSACTION_PARSE_BUSY;
+}
+
+// The buffer is about to change, a running parse job would read stale data
+void transaction_parse_stop()
+{
+    parse_phase = PARSE_IDLE;
+    scheduler_remove(&transaction_parse_job);
 }
 
 void transaction_initialize()
@@ -52,24 +194,72 @@ void transaction_initialize()
     append_buffer_delegate update_ram_delegate = &update_ram;
     append_buffer_delegate update_flash_delegate = &update_flash;
 
+    transaction_parse_stop();
+    selection_active = false;
+    transaction_length = 0;
+    transaction_json_state = 0;
+
+    if (flash_used[flash_slot] > 0) {
+        flash_slot = (flash_slot + 1) % FLASH_BUFFER_SLOTS;
+        flash_prepared = 0;
+        scheduler_add(&transaction_prepare_next_slot);
+    }
+
     buffering_init(
             ram_buffer,
             sizeof(ram_buffer),
             update_ram_delegate,
-            N_appdata.buffer,
-            sizeof(N_appdata.buffer),
+            N_appdata(flash_slot).buffer,
+            sizeof(N_appdata(flash_slot).buffer),
             update_flash_delegate
     );
+    buffering_enable_staging();
 }
 
 void transaction_reset()
 {
+    transaction_parse_stop();
+    selection_active = false;
+    transaction_length = 0;
+    transaction_json_state = 0;
     buffering_reset();
 }
 
 void transaction_append(unsigned char *buffer, uint32_t length)
 {
     buffering_append(buffer, length);
+    transaction_length += length;
+}
+
+int transaction_compact_json(unsigned char* buffer, uint32_t length)
+{
+    return json_fragment_compact((char*) buffer, length, &transaction_json_state);
+}
+
+uint32_t transaction_get_length()
+{
+    return transaction_length;
+}
+
+uint32_t transaction_get_capacity()
+{
+    // The parser needs a terminating zero after the transaction
+    return FLASH_BUFFER_SIZE - 1;
+}
+
+uint16_t transaction_get_token_capacity()
+{
+    return MAX_NUMBER_OF_TOKENS + FLASH_TOKENS_SIZE;
+}
+
+bool transaction_has_pending_commit()
+{
+    return buffering_has_pending();
+}
+
+void transaction_commit()
+{
+    buffering_flush();
 }
 
 uint32_t transaction_get_buffer_length()
@@ -82,20 +272,56 @@ uint8_t* transaction_get_buffer()
     return buffering_get_buffer()->data;
 }
 
-void transaction_parse()
+void transaction_select(
+        uint32_t offset,
+        uint32_t length)
 {
-    const char* transaction_buffer = (const char*)transaction_get_buffer();
-    json_parse(&parsed_transaction, transaction_buffer);
-    // FIXME: Verify is valid. Sorted / whitespaces, etc.
+    transaction_parse_stop();
+    selection_active = true;
+    selection_offset = offset;
+    selection_length = length;
+}
+
+const char* transaction_get_selected()
+{
+    uint8_t* buffer = transaction_get_buffer();
+    if (selection_active) {
+        buffer += selection_offset;
+    }
+    return (const char*) buffer;
+}
+
+uint32_t transaction_get_selected_length()
+{
+    if (selection_active) {
+        return selection_length;
+    }
+    return transaction_get_buffer_length();
+}
+
+void transaction_parse_start()
+{
+    json_count_job_init(&parse_job.count, transaction_get_selected_length());
+    parse_page_count = 0;
+    parse_phase = PARSE_COUNT;
+    scheduler_add(&transaction_parse_job);
+}
+
+bool transaction_parse_is_running()
+{
+    return parse_phase != PARSE_IDLE && parse_phase != PARSE_DONE && parse_phase != PARSE_FAILED;
+}
 
+void transaction_set_parsing_context()
+{
     parsing_context_t context;
-    context.transaction = transaction_buffer;
+    context.transaction = transaction_get_selected();
     context.view_scrolling_total_size = &view_scrolling_total_size;
     context.view_scrolling_step = &view_scrolling_step;
     context.key_scrolling_step = &key_scrolling_step;
     context.key_scrolling_total_size = &key_scrolling_total_size;
     context.max_chars_per_line = MAX_CHARS_PER_LINE;
-    context.parsed_transaction = &parsed_transaction;
+    context.parsed_transaction = transaction_get_parsed();
     view_scrolling_total_size = 10;
     view_scrolling_step = 0;
     key_scrolling_total_size = 10;
@@ -104,7 +330,159 @@ void transaction_parse()
     set_copy_delegate(&os_memmove);
 }
 
+// Starts counting the display items of a top level value
+void transaction_count_pages_start(const char* key)
+{
+    int token_index = object_get_value(
+            0,
+            key,
+            &parsed_transaction.tokens,
+            transaction_get_selected());
+    display_count_job_init(&parse_job.pages, &parsed_transaction.tokens, token_index);
+}
+
+int transaction_parse_step()
+{
+    const char* transaction_buffer = transaction_get_selected();
+    uint32_t length = transaction_get_selected_length();
+
+    switch (parse_phase) {
+        case PARSE_COUNT: {
+            int result = json_count_job_step(&parse_job.count, transaction_buffer, PARSE_STEP_SIZE);
+            if (result < 0 || (result == 0 && parse_job.count.count == 0)) {
+                parse_phase = PARSE_FAILED;
+                break;
+            }
+            if (result > 0) {
+                break;
+            }
+            // The count sizes the spill and decides how the transaction is displayed.
+            // A selection is parsed again whenever the review moves to it, it does
+            // not use the spill so moving around does not rewrite flash.
+            int token_count = parse_job.count.count;
+            uint16_t spill_capacity = selection_active ? 0 : FLASH_TOKENS_SIZE;
+            parsed_transaction_streaming = token_count > MAX_NUMBER_OF_TOKENS + spill_capacity;
+            if (parsed_transaction_streaming) {
+                stream_display_begin(&parsed_transaction.stream, transaction_buffer, length);
+                parse_phase = PARSE_STREAM;
+                break;
+            }
+            if (json_parse_job_init(
+                    &parse_job.tokens,
+                    &parsed_transaction.tokens,
+                    length,
+                    token_count,
+                    spill_capacity) < 0) {
+                parse_phase = PARSE_FAILED;
+                break;
+            }
+            parse_phase = PARSE_TOKENS;
+            break;
+        }
+        case PARSE_TOKENS: {
+            int result = json_parse_job_step(
+                    &parse_job.tokens,
+                    &parsed_transaction.tokens,
+                    transaction_buffer,
+                    PARSE_STEP_TOKENS,
+                    N_tokens.tokens,
+                    &update_tokens);
+            // FIXME: Verify is valid. Sorted / whitespaces, etc.
+            if (result < 0) {
+                parse_phase = PARSE_FAILED;
+                break;
+            }
+            if (result == 0) {
+                transaction_set_parsing_context();
+                transaction_count_pages_start("msg_bytes");
+                parse_phase = PARSE_PAGES_MSG;
+            }
+            break;
+        }
+        case PARSE_STREAM: {
+            int result = stream_display_init_step(&parsed_transaction.stream, PARSE_STEP_ITEMS);
+            if (result < 0) {
+                parse_phase = PARSE_FAILED;
+                break;
+            }
+            if (result == 0) {
+                transaction_set_parsing_context();
+                parse_page_count = stream_display_get_pages(&parsed_transaction.stream);
+                parse_phase = PARSE_DONE;
+            }
+            break;
+        }
+        case PARSE_PAGES_MSG:
+        case PARSE_PAGES_ALT: {
+            int result = display_count_job_step(&parse_job.pages, &parsed_transaction.tokens, PARSE_STEP_TOKENS);
+            if (result < 0) {
+                parse_phase = PARSE_FAILED;
+                break;
+            }
+            if (result > 0) {
+                break;
+            }
+            if (parse_phase == PARSE_PAGES_MSG) {
+                parse_msg_bytes_items = parse_job.pages.count;
+                transaction_count_pages_start("alt_bytes");
+                parse_phase = PARSE_PAGES_ALT;
+                break;
+            }
+            parse_page_count = transaction_set_display_pages(parse_msg_bytes_items, parse_job.pages.count);
+            parse_phase = PARSE_DONE;
+            break;
+        }
+        default:
+            break;
+    }
+
+    switch (parse_phase) {
+        case PARSE_DONE:
+            return TRANSACTION_PARSE_DONE;
+        case PARSE_IDLE:
+            // Not started, or stopped because the buffer changed
+        case PARSE_FAILED:
+            return TRANSACTION_PARSE_FAILED;
+        default:
+            return TRANSACTION_PARSE_BUSY;
+    }
+}
+
+void transaction_parse()
+{
+    transaction_parse_start();
+    while (transaction_parse_step() == TRANSACTION_PARSE_BUSY) {
+    }
+}
+
 parsed_json_t *transaction_get_parsed()
 {
-    return &parsed_transaction;
+    if (parsed_transaction_streaming) {
+        return NULL;
+    }
+    return &parsed_transaction.tokens;
+}
+
+parsed_json_t* transaction_borrow_tokens()
+{
+    transaction_parse_stop();
+    parsed_transaction_streaming = false;
+    parse_page_count = 0;
+    return &parsed_transaction.tokens;
+}
+
+int transaction_get_page_count()
+{
+    return parse_page_count;
+}
+
+int transaction_get_page(
+        char* key,
+        char* value,
+        int page)
+{
+    if (parsed_transaction_streaming) {
+        return stream_display_get_key_value(&parsed_transaction.stream, key, value, page);
+    }
+    return transaction_get_display_key_value(key, value, page);
 }
\ No newline at end of file
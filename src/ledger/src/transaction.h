@@ -18,8 +18,18 @@
 #include "json_parser.h"
 #include "os.h"
 
+// Selects the next flash slot for the transaction buffer if the previous
+// transaction was written to flash
 void transaction_initialize();
 
+// Clears one step of the written part of the flash slot that the next
+// transaction will use. Scheduler job, returns true while the slot is not ready.
+bool transaction_prepare_next_slot();
+
+// Restores which slots were written before the app started, called once at startup.
+// Schedules clearing the next slot if both are written.
+void transaction_init_slots();
+
 // Clears the transaction buffer
 void transaction_reset();
 
@@ -29,15 +39,83 @@ void transaction_append(
         unsigned char* buffer,
         uint32_t length);
 
+// Removes whitespace outside strings from the next chunk of a json transaction,
+// in place, before it is appended. Sign bytes are compact json, so a compact
+// upload is stored unchanged and an indented one is stored (and signed) in the
+// form a verifier rebuilds. Returns the new length of the chunk or -1 if the
+// json is malformed (see json_fragment_compact).
+int transaction_compact_json(
+        unsigned char* buffer,
+        uint32_t length);
+
+// Number of bytes appended since the buffer was cleared, staged data included
+uint32_t transaction_get_length();
+
+// Largest transaction (in bytes) the buffer can hold
+uint32_t transaction_get_capacity();
+
+// Largest number of json tokens that can be displayed from the token array
+uint16_t transaction_get_token_capacity();
+
+// Returns true if appended data is staged in RAM and not yet written to flash
+bool transaction_has_pending_commit();
+
+// Writes staged data to flash. Called after a chunk has been acknowledged so the
+// flash write overlaps the transfer of the next chunk.
+void transaction_commit();
+
 // Returns size of the raw json transaction buffer
+// Staged data is committed first
 uint32_t transaction_get_buffer_length();
 
 // Returns the raw json transaction buffer
+// Staged data is committed first
 uint8_t* transaction_get_buffer();
 
+// Restricts parsing and display to length bytes at offset, used for the
+// transactions of a batch. The byte after the range has to be zero.
+// Selections with more tokens than parsed_json_t holds are streamed, not spilled.
+// Cleared when the buffer is initialized or reset.
+void transaction_select(
+        uint32_t offset,
+        uint32_t length);
+
+// Json that is parsed and displayed: the selection or the whole buffer
+const char* transaction_get_selected();
+
+#define TRANSACTION_PARSE_DONE      0
+#define TRANSACTION_PARSE_BUSY      1
+#define TRANSACTION_PARSE_FAILED    -1
+
 // Parse json message stored in transaction buffer
 // This function should be called as soon as full buffer data is loaded.
 void transaction_parse();
 
+// Starts parsing as a job, see transaction_parse_step
+void transaction_parse_start();
+
+// Does the next bounded piece of parsing, validation and page counting.
+// Returns TRANSACTION_PARSE_BUSY until the transaction is ready to be displayed.
+// Once the job has finished (also when the ticker ran its last step) the final
+// status is returned again. A job that was never started or was stopped fails.
+int transaction_parse_step();
+
+// Returns true while the parse job has steps left
+bool transaction_parse_is_running();
+
 // Returns parsed representation of the transaction message
-parsed_json_t* transaction_get_parsed();
\ No newline at end of file
+// NULL if the transaction is too big for a token array and is displayed by re-scanning
+parsed_json_t* transaction_get_parsed();
+
+// Lends the token array to parsers outside the transaction flow (validator votes).
+// The parsed transaction is dropped, it has to be parsed again before it is shown.
+parsed_json_t* transaction_borrow_tokens();
+
+// Returns number of pages needed to display the parsed transaction
+int transaction_get_page_count();
+
+// Fills key and value of the given display page
+int transaction_get_page(
+        char* key,
+        char* value,
+        int page);
\ No newline at end of file
@@ -0,0 +1,256 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "validator.h"
+#include "signature.h"
+#include "apdu_codes.h"
+#include "tendermint_vote.h"
+#include "transaction.h"
+#include "view.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#ifdef FEATURE_ED25519
+
+// Last signed vote or proposal of a chain.
+// Written before its signature leaves the device.
+typedef struct {
+    char chain_id[TM_CHAIN_ID_SIZE];
+    tm_hrs_t hrs;
+    uint32_t session;           // last session that signed for the chain, 0 for a free entry
+} validator_watermark_t;
+
+typedef struct {
+    validator_watermark_t chains[VALIDATOR_MAX_CHAINS];
+} validator_watermarks_t;
+
+validator_watermarks_t N_validator_watermarks_impl __attribute__ ((aligned(64)));
+#define N_validator_watermarks (*(validator_watermarks_t *)PIC(&N_validator_watermarks_impl))
+
+enum {
+    VALIDATOR_IDLE,
+    VALIDATOR_PENDING,
+    VALIDATOR_ACTIVE
+} validator_state = VALIDATOR_IDLE;
+
+uint32_t validator_path[10];
+uint8_t validator_depth = 0;
+
+cx_ecfp_private_key_t validator_private_key;
+cx_ecfp_public_key_t validator_public_key;
+
+// Entry of the chain picked by the first signature after the approval, -1 before.
+// Other chains are refused from then on.
+int8_t validator_chain = -1;
+// Number of this session, larger than that of every entry
+uint32_t validator_session = 0;
+
+// Returns the entry of the chain, -1 if it has none
+int validator_find_chain(const char* chain_id)
+{
+    for (int i = 0; i < VALIDATOR_MAX_CHAINS; i++) {
+        const validator_watermark_t* entry = &N_validator_watermarks.chains[i];
+        if (entry->session != 0 && os_memcmp(entry->chain_id, chain_id, TM_CHAIN_ID_SIZE) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Returns the entry signed by the oldest session (a free one first), or by the latest
+int validator_pick_chain(bool latest)
+{
+    int picked = 0;
+    for (int i = 1; i < VALIDATOR_MAX_CHAINS; i++) {
+        uint32_t session = N_validator_watermarks.chains[i].session;
+        uint32_t picked_session = N_validator_watermarks.chains[picked].session;
+        if (latest ? session > picked_session : session < picked_session) {
+            picked = i;
+        }
+    }
+    return picked;
+}
+
+void validator_start(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth)
+{
+    validator_stop();
+    os_memmove(validator_path, bip32_path, bip32_depth * sizeof(uint32_t));
+    validator_depth = bip32_depth;
+    validator_state = VALIDATOR_PENDING;
+}
+
+bool validator_is_pending()
+{
+    return validator_state == VALIDATOR_PENDING;
+}
+
+void validator_approve(cx_ecfp_public_key_t* publicKey)
+{
+    keys_derive(CX_CURVE_Ed25519, validator_path, validator_depth,
+                &validator_public_key, &validator_private_key);
+    os_memmove(publicKey, &validator_public_key, sizeof(validator_public_key));
+    validator_chain = -1;
+    validator_session = N_validator_watermarks.chains[validator_pick_chain(true)].session + 1;
+    validator_state = VALIDATOR_ACTIVE;
+}
+
+void validator_stop()
+{
+    os_memset(&validator_private_key, 0, sizeof(validator_private_key));
+    validator_state = VALIDATOR_IDLE;
+}
+
+bool validator_is_active()
+{
+    return validator_state == VALIDATOR_ACTIVE;
+}
+
+int validator_get_page_count()
+{
+    return 3;
+}
+
+// Shows the part of text that starts at the scrolling position
+void validator_show_value(
+        char* value,
+        const char* text)
+{
+    unsigned int length = strlen(text);
+    view_scrolling_total_size = length;
+    unsigned int start = view_scrolling_step < length ? view_scrolling_step : 0;
+    snprintf(value, MAX_CHARS_PER_LINE + 1, "%s", text + start);
+}
+
+// snprintf may not support 64 bit integers
+char* validator_format_uint64(
+        char* end,
+        uint64_t number)
+{
+    *end = 0;
+    do {
+        *--end = '0' + (number % 10);
+        number /= 10;
+    } while (number > 0);
+    return end;
+}
+
+int validator_get_page(
+        char* key,
+        char* value,
+        int page)
+{
+    key_scrolling_total_size = 0;
+    view_scrolling_total_size = 0;
+    // The chain signed last is shown
+    const validator_watermark_t* watermark = &N_validator_watermarks.chains[validator_pick_chain(true)];
+    switch (page) {
+        case 0:
+            snprintf(key, 32, "Validator mode");
+            snprintf(value, 32, "Auto-sign votes");
+            break;
+        case 1: {
+            char chain_id[TM_CHAIN_ID_SIZE];
+            os_memmove(chain_id, watermark->chain_id, sizeof(chain_id));
+            chain_id[TM_CHAIN_ID_SIZE - 1] = 0;
+            snprintf(key, 32, "Signed chain");
+            validator_show_value(value, watermark->session != 0 ? chain_id : "None");
+            break;
+        }
+        default: {
+            // height/round/step
+            char text[32];
+            char* position = validator_format_uint64(text + 20, watermark->hrs.height);
+            unsigned int length = text + 20 - position;
+            os_memmove(text, position, length);
+            snprintf(text + length, sizeof(text) - length, "/%u/%u",
+                     (unsigned int) watermark->hrs.round,
+                     (unsigned int) watermark->hrs.step);
+            snprintf(key, 32, "Signed H/R/S");
+            validator_show_value(value, text);
+            break;
+        }
+    }
+    return 0;
+}
+
+unsigned int validator_sign(
+        const uint8_t* sign_bytes,
+        uint16_t sign_bytes_length,
+        uint8_t* signature,
+        unsigned int signature_capacity)
+{
+    if (validator_state != VALIDATOR_ACTIVE) {
+        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    tm_hrs_t hrs;
+    char chain_id[TM_CHAIN_ID_SIZE];
+    if (tm_parse_sign_bytes(transaction_borrow_tokens(), (const char*) sign_bytes, sign_bytes_length,
+                            &hrs, chain_id) != 0) {
+        THROW(APDU_CODE_DATA_INVALID);
+    }
+
+    // The first signature after the approval picks the chain of the session,
+    // later ones have to stay on it
+    int entry = validator_chain;
+    if (entry < 0) {
+        entry = validator_find_chain(chain_id);
+    }
+    else if (os_memcmp(chain_id, N_validator_watermarks.chains[entry].chain_id, TM_CHAIN_ID_SIZE) != 0) {
+        THROW(APDU_CODE_CONDITIONS_NOT_SATISFIED);
+    }
+
+    validator_watermark_t* watermark;
+    if (entry >= 0) {
+        watermark = &N_validator_watermarks.chains[entry];
+        if (tm_hrs_compare(&hrs, &watermark->hrs) <= 0) {
+            THROW(APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        }
+    }
+    else {
+        // A new chain, only the chain of the oldest session loses its watermark.
+        // The session is written last, a reset in between leaves the entry free.
+        entry = validator_pick_chain(false);
+        watermark = &N_validator_watermarks.chains[entry];
+        uint32_t free_session = 0;
+        nvm_write((void*) &watermark->session, &free_session, sizeof(free_session));
+        nvm_write((void*) watermark->chain_id, chain_id, TM_CHAIN_ID_SIZE);
+    }
+
+    // Every signature costs a flash write: a signature that leaves the device
+    // before its watermark is stored could be signed again after a restart.
+    // Only the height, round and step of a single entry are written.
+    nvm_write((void*) &watermark->hrs, &hrs, sizeof(hrs));
+    if (validator_chain < 0) {
+        nvm_write((void*) &watermark->session, &validator_session, sizeof(validator_session));
+        validator_chain = entry;
+    }
+
+    cx_ecfp_public_key_t* publicKey = NULL;
+#ifdef SIGN_SELF_VERIFY
+    publicKey = &validator_public_key;
+#endif
+    unsigned int length = 0;
+    if (sign_ed25519(sign_bytes, sign_bytes_length, signature, signature_capacity,
+                     &length, &validator_private_key, publicKey) != 1) {
+        THROW(APDU_CODE_SIGN_VERIFY_ERROR);
+    }
+    return length;
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+#include "os.h"
+#include "cx.h"
+#include <stdbool.h>
+
+// Validator mode. The user approves the validator key once, afterwards votes and
+// proposals are signed with Ed25519 without review as long as their height, round
+// and step are above the high-watermark of the last signature on their chain.
+// Every chain has its own watermark (height, round and step), written to flash
+// before each signature is released, so signing resumes exactly where it stopped
+// after a restart. A session signs for a single chain, the first vote after the
+// approval picks it. Up to VALIDATOR_MAX_CHAINS chains keep their watermark, a
+// further chain takes the place of the one whose session is the oldest.
+
+#define VALIDATOR_MAX_CHAINS    4
+
+// Starts the approval of the validator key
+void validator_start(
+        const uint32_t* bip32_path,
+        uint8_t bip32_depth);
+
+// Returns true while the approval is shown
+bool validator_is_pending();
+
+// Enables auto-signing. Derives the key pair once for the whole session.
+void validator_approve(cx_ecfp_public_key_t* publicKey);
+
+// Leaves validator mode and clears the key
+void validator_stop();
+
+// Returns true once the validator key has been approved
+bool validator_is_active();
+
+// Approval pages
+int validator_get_page_count();
+
+int validator_get_page(
+        char* key,
+        char* value,
+        int page);
+
+// Signs the sign bytes of a vote or a proposal and moves the watermark.
+// The sign bytes are tokenized into the transaction token array (see
+// transaction_borrow_tokens) and may share memory with signature.
+// Throws APDU_CODE_DATA_INVALID if they are neither and
+// APDU_CODE_CONDITIONS_NOT_SATISFIED if they do not exceed the watermark
+// or belong to another chain than the session.
+// Returns the signature length.
+unsigned int validator_sign(
+        const uint8_t* sign_bytes,
+        uint16_t sign_bytes_length,
+        uint8_t* signature,
+        unsigned int signature_capacity);
@@ -55,10 +55,12 @@ volatile char pageInfo[20];
 
 int transactionDetailsCurrentPage;
 int transactionDetailsPageCount;
+unsigned char transactionDetailsVisible = 0;
 
 void start_transaction_info_display(unsigned int unused);
 void view_sign_transaction(unsigned int unused);
 void reject(unsigned int unused);
+void exit_app(unsigned int unused);
 
 //------ View elements
 const ux_menu_entry_t menu_main[];
@@ -78,7 +80,7 @@ const ux_menu_entry_t menu_main[] = {
     {NULL, NULL, 0, &C_icon_app, "Tendermint", "Cosmos", 33, 12},
 #endif
     {menu_about, NULL, 0, NULL, "About", NULL, 0, 0},
-    {NULL, os_sched_exit, 0, &C_icon_dashboard, "Quit app", NULL, 50, 29},
+    {NULL, exit_app, 0, &C_icon_dashboard, "Quit app", NULL, 50, 29},
     UX_MENU_END
 };
 
@@ -109,6 +111,7 @@ static const bagl_element_t bagl_ui_transaction_info[] = {
 delegate_update_transaction_info event_handler_update_transaction_info = NULL;
 delegate_reject_transaction event_handler_reject_transaction = NULL;
 delegate_sign_transaction event_handler_sign_transaction = NULL;
+delegate_exit_app event_handler_exit_app = NULL;
 
 void view_add_update_transaction_info_event_handler(delegate_update_transaction_info delegate)
 {
@@ -124,6 +127,11 @@ void view_add_sign_transaction_event_handler(delegate_sign_transaction delegate)
 {
     event_handler_sign_transaction = delegate;
 }
+
+void view_add_exit_app_event_handler(delegate_exit_app delegate)
+{
+    event_handler_exit_app = delegate;
+}
 // ------ Event handlers
 
 
@@ -207,6 +215,7 @@ static unsigned int bagl_ui_transaction_info_button(unsigned int button_mask,
 void start_transaction_info_display(unsigned int unused)
 {
     UNUSED(unused);
+    transactionDetailsVisible = 1;
     transactionDetailsCurrentPage = 0;
     reset_scrolling();
     UX_DISPLAY(bagl_ui_transaction_info, ui_transaction_info_prepro);
@@ -265,6 +274,14 @@ void reject(unsigned int unused)
     }
 }
 
+void exit_app(unsigned int unused)
+{
+    if (event_handler_exit_app != NULL) {
+        event_handler_exit_app();
+    }
+    os_sched_exit(0);
+}
+
 void io_seproxyhal_display(const bagl_element_t *element)
 {
     io_seproxyhal_display_default((bagl_element_t *) element);
@@ -279,6 +296,7 @@ void view_init(void)
 void view_idle(unsigned int ignored)
 {
     view_uiState = UI_IDLE;
+    transactionDetailsVisible = 0;
     UX_MENU_DISPLAY(0, menu_main, NULL);
 }
 
@@ -288,9 +306,17 @@ void view_display_transaction_menu(unsigned int numberOfTransactionPages)
         transactionDetailsPageCount = numberOfTransactionPages;
     }
     view_uiState = UI_TRANSACTION;
+    transactionDetailsVisible = 0;
     UX_MENU_DISPLAY(0, menu_transaction_info, NULL);
 }
 
+void view_redisplay_transaction_info()
+{
+    if (transactionDetailsVisible) {
+        UX_DISPLAY(bagl_ui_transaction_info, ui_transaction_info_prepro);
+    }
+}
+
 void view_display_signing_success()
 {
     // TODO Add view
@@ -46,16 +46,20 @@ extern enum UI_STATE view_uiState;
 typedef int (*delegate_update_transaction_info)(char*,char*,int);
 typedef void (*delegate_reject_transaction)();
 typedef void (*delegate_sign_transaction)();
+typedef void (*delegate_exit_app)();
 
 //------ Event handlers
 void view_add_update_transaction_info_event_handler(delegate_update_transaction_info delegate);
 void view_add_reject_transaction_event_handler(delegate_reject_transaction delegate);
 void view_add_sign_transaction_event_handler(delegate_sign_transaction delegate);
+void view_add_exit_app_event_handler(delegate_exit_app delegate);
 
 //------ Common functions (TODO review)
 void view_init(void);
 void view_idle(unsigned int ignored);
 void view_display_transaction_menu(unsigned int ignored);
+// Shows the current transaction page again if it is on screen
+void view_redisplay_transaction_info();
 void view_display_signing_success();
 void view_display_signing_error();
 
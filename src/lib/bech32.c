@@ -0,0 +1,93 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "bech32.h"
+#include <string.h>
+
+#define BECH32_CHECKSUM_LENGTH  6
+
+static const char bech32_charset[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+uint32_t bech32_polymod_step(uint32_t checksum, uint8_t value)
+{
+    uint8_t top = checksum >> 25;
+    checksum = ((checksum & 0x1FFFFFF) << 5) ^ value;
+    if (top & 1) checksum ^= 0x3b6a57b2;
+    if (top & 2) checksum ^= 0x26508e6d;
+    if (top & 4) checksum ^= 0x1ea119fa;
+    if (top & 8) checksum ^= 0x3d4233dd;
+    if (top & 16) checksum ^= 0x2a1462b3;
+    return checksum;
+}
+
+int bech32_encode(
+        char* output,
+        unsigned int output_size,
+        const char* hrp,
+        const uint8_t* data,
+        unsigned int data_length)
+{
+    unsigned int hrp_length = strlen(hrp);
+    unsigned int data5_length = (data_length * 8 + 4) / 5;
+    unsigned int length = hrp_length + 1 + data5_length + BECH32_CHECKSUM_LENGTH;
+    if (length + 1 > output_size) {
+        return -1;
+    }
+
+    // The checksum covers the expanded hrp: high bits, a zero, then low bits
+    uint32_t checksum = 1;
+    for (unsigned int i = 0; i < hrp_length; i++) {
+        checksum = bech32_polymod_step(checksum, hrp[i] >> 5);
+    }
+    checksum = bech32_polymod_step(checksum, 0);
+    for (unsigned int i = 0; i < hrp_length; i++) {
+        checksum = bech32_polymod_step(checksum, hrp[i] & 0x1F);
+        output[i] = hrp[i];
+    }
+
+    char* out = output + hrp_length;
+    *out++ = '1';
+
+    // Regroup 8 bit bytes to 5 bit values, the last one is padded with zeros
+    uint32_t accumulator = 0;
+    unsigned int bits = 0;
+    for (unsigned int i = 0; i < data_length; i++) {
+        accumulator = (accumulator << 8) | data[i];
+        bits += 8;
+        while (bits >= 5) {
+            bits -= 5;
+            uint8_t value = (accumulator >> bits) & 0x1F;
+            checksum = bech32_polymod_step(checksum, value);
+            *out++ = bech32_charset[value];
+        }
+    }
+    if (bits > 0) {
+        uint8_t value = (accumulator << (5 - bits)) & 0x1F;
+        checksum = bech32_polymod_step(checksum, value);
+        *out++ = bech32_charset[value];
+    }
+
+    for (int i = 0; i < BECH32_CHECKSUM_LENGTH; i++) {
+        checksum = bech32_polymod_step(checksum, 0);
+    }
+    checksum ^= 1;
+    for (int i = 0; i < BECH32_CHECKSUM_LENGTH; i++) {
+        *out++ = bech32_charset[(checksum >> (5 * (BECH32_CHECKSUM_LENGTH - 1 - i))) & 0x1F];
+    }
+    *out = '\0';
+
+    return length;
+}
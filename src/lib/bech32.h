@@ -0,0 +1,42 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_BECH32_H
+#define CI_TEST_BECH32_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bech32 (BIP-173) encoding as used for Cosmos addresses:
+// hrp + "1" + data regrouped to 5 bits + 6 checksum characters.
+
+// Encode data (8 bit bytes) with the given human readable part.
+// output receives a zero terminated string.
+// Returns the length of the string or -1 if output_size is too small.
+int bech32_encode(
+        char* output,
+        unsigned int output_size,
+        const char* hrp,
+        const uint8_t* data,
+        unsigned int data_length);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //CI_TEST_BECH32_H
@@ -17,15 +17,18 @@
 
 #include "buffering.h"
 
-// Ram
-append_buffer_delegate append_ram_buffer = NULL;
-buffer_state_t ram;
+buffering_t default_buffering;
 
-// Flash
-append_buffer_delegate append_flash_buffer = NULL;
-buffer_state_t flash;
+buffering_t* buffering_default()
+{
+    return &default_buffering;
+}
 
-void buffering_init(
+//---------------------------------------------
+// INSTANCE API
+
+void buffering_instance_init(
+        buffering_t* buffering,
         uint8_t* ram_buffer,
         int ram_buffer_size,
         append_buffer_delegate ram_delegate,
@@ -33,68 +36,193 @@ void buffering_init(
         int flash_buffer_size,
         append_buffer_delegate flash_delegate)
 {
-    append_ram_buffer = ram_delegate;
-    append_flash_buffer = flash_delegate;
+    buffering->append_ram_buffer = ram_delegate;
+    buffering->append_flash_buffer = flash_delegate;
+
+    buffering->ram.data = ram_buffer;
+    buffering->ram.size = ram_buffer_size;
+    buffering->ram.pos = 0;
+    buffering->ram.in_use = 1;
+    buffering->ram.initialized = 1;
 
-    ram.data = ram_buffer;
-    ram.size = ram_buffer_size;
-    ram.pos = 0;
-    ram.in_use = 1;
-    ram.initialized = 1;
+    buffering->flash.data = flash_buffer;
+    buffering->flash.size = flash_buffer_size;
+    buffering->flash.pos = 0;
+    buffering->flash.in_use = 0;
+    buffering->flash.initialized = 1;
 
-    flash.data = flash_buffer;
-    flash.size = flash_buffer_size;
-    flash.pos = 0;
-    flash.in_use = 0;
-    flash.initialized = 1;
+    buffering->staging_enabled = 0;
+    buffering->staging_active = 0;
+    buffering->staging_half_size = ram_buffer_size / 2;
+    buffering->staging_length[0] = 0;
+    buffering->staging_length[1] = 0;
 }
 
-void buffering_reset()
+void buffering_instance_enable_staging(buffering_t* buffering)
 {
-    ram.pos = 0;
-    ram.in_use = 1;
-    flash.pos = 0;
-    flash.in_use = 0;
+    buffering->staging_enabled = 1;
 }
 
-void buffering_append(uint8_t* data, int length)
+void buffering_instance_reset(buffering_t* buffering)
+{
+    buffering->ram.pos = 0;
+    buffering->ram.in_use = 1;
+    buffering->flash.pos = 0;
+    buffering->flash.in_use = 0;
+    buffering->staging_active = 0;
+    buffering->staging_length[0] = 0;
+    buffering->staging_length[1] = 0;
+}
+
+static void buffering_write_flash(buffering_t* buffering, uint8_t* data, int length)
+{
+    buffering->append_flash_buffer(&buffering->flash, data, length);
+    buffering->flash.pos += length;
+}
+
+static void buffering_flush_half(buffering_t* buffering, uint8_t half)
+{
+    if (buffering->staging_length[half] > 0) {
+        buffering_write_flash(
+                buffering,
+                buffering->ram.data + half * buffering->staging_half_size,
+                buffering->staging_length[half]);
+        buffering->staging_length[half] = 0;
+    }
+}
+
+uint8_t buffering_instance_has_pending(const buffering_t* buffering)
 {
-    if (ram.in_use) {
-        if (ram.size - ram.pos >= length) {
-            append_ram_buffer(&ram, data, length);
-            ram.pos += length;
+    return buffering->staging_length[0] > 0 || buffering->staging_length[1] > 0;
+}
+
+void buffering_instance_flush(buffering_t* buffering)
+{
+    // The half that is about to be reused holds the older chunk
+    buffering_flush_half(buffering, buffering->staging_active);
+    buffering_flush_half(buffering, !buffering->staging_active);
+}
+
+static void buffering_stage(buffering_t* buffering, uint8_t* data, int length)
+{
+    if (length > buffering->staging_half_size) {
+        buffering_instance_flush(buffering);
+        buffering_write_flash(buffering, data, length);
+        return;
+    }
+    // Previous chunk in this half was never flushed
+    buffering_flush_half(buffering, buffering->staging_active);
+
+    buffer_state_t half = buffering->ram;
+    half.pos = buffering->staging_active * buffering->staging_half_size;
+    buffering->append_ram_buffer(&half, data, length);
+    buffering->staging_length[buffering->staging_active] = length;
+    buffering->staging_active = !buffering->staging_active;
+}
+
+void buffering_instance_append(buffering_t* buffering, uint8_t* data, int length)
+{
+    buffer_state_t* ram = &buffering->ram;
+    if (ram->in_use) {
+        if (ram->size - ram->pos >= length) {
+            buffering->append_ram_buffer(ram, data, length);
+            ram->pos += length;
         }
         else {
-            ram.in_use = 0;
-            flash.in_use = 1;
-            if (ram.pos > 0) {
-                buffering_append(ram.data, ram.pos);
+            ram->in_use = 0;
+            buffering->flash.in_use = 1;
+            if (ram->pos > 0) {
+                // RAM content is moved directly, its halves are about to be used for staging
+                buffering_write_flash(buffering, ram->data, ram->pos);
             }
-            buffering_append(data,length);
-            ram.pos = 0;
+            ram->pos = 0;
+            buffering_instance_append(buffering, data, length);
         }
     }
+    else if (buffering->staging_enabled) {
+        buffering_stage(buffering, data, length);
+    }
     else {
-        append_flash_buffer(&flash, data, length);
-        flash.pos += length;
+        buffering_write_flash(buffering, data, length);
+    }
+}
+
+buffer_state_t* buffering_instance_get_ram_buffer(buffering_t* buffering)
+{
+    return &buffering->ram;
+}
+
+buffer_state_t* buffering_instance_get_flash_buffer(buffering_t* buffering)
+{
+    return &buffering->flash;
+}
+
+buffer_state_t* buffering_instance_get_buffer(buffering_t* buffering)
+{
+    buffering_instance_flush(buffering);
+    if (buffering->ram.in_use) {
+        return &buffering->ram;
     }
+    return &buffering->flash;
+}
+
+//---------------------------------------------
+// DEFAULT INSTANCE
+
+void buffering_init(
+        uint8_t* ram_buffer,
+        int ram_buffer_size,
+        append_buffer_delegate ram_delegate,
+        uint8_t* flash_buffer,
+        int flash_buffer_size,
+        append_buffer_delegate flash_delegate)
+{
+    buffering_instance_init(
+            &default_buffering,
+            ram_buffer,
+            ram_buffer_size,
+            ram_delegate,
+            flash_buffer,
+            flash_buffer_size,
+            flash_delegate);
+}
+
+void buffering_enable_staging()
+{
+    buffering_instance_enable_staging(&default_buffering);
 }
 
+void buffering_reset()
+{
+    buffering_instance_reset(&default_buffering);
+}
+
+uint8_t buffering_has_pending()
+{
+    return buffering_instance_has_pending(&default_buffering);
+}
+
+void buffering_flush()
+{
+    buffering_instance_flush(&default_buffering);
+}
+
+void buffering_append(uint8_t* data, int length)
+{
+    buffering_instance_append(&default_buffering, data, length);
+}
 
 buffer_state_t* buffering_get_ram_buffer()
 {
-    return &ram;
+    return buffering_instance_get_ram_buffer(&default_buffering);
 }
 
 buffer_state_t* buffering_get_flash_buffer()
 {
-    return &flash;
+    return buffering_instance_get_flash_buffer(&default_buffering);
 }
 
 buffer_state_t* buffering_get_buffer()
 {
-    if (ram.in_use) {
-        return &ram;
-    }
-    return &flash;
-}
\ No newline at end of file
+    return buffering_instance_get_buffer(&default_buffering);
+}
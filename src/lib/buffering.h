@@ -35,6 +35,59 @@ typedef struct {
 
 typedef void (*append_buffer_delegate)(buffer_state_t* buffer, uint8_t* data, int size);
 
+// Transaction buffer that starts in RAM and moves to flash when RAM is full
+typedef struct {
+    buffer_state_t ram;
+    buffer_state_t flash;
+    append_buffer_delegate append_ram_buffer;
+    append_buffer_delegate append_flash_buffer;
+
+    // Staging (two halves of the idle RAM buffer)
+    uint8_t staging_enabled;
+    uint8_t staging_active;                 // half that receives the next chunk
+    uint16_t staging_half_size;
+    uint16_t staging_length[2];
+} buffering_t;
+
+//---------------------------------------------
+// INSTANCE API
+
+void buffering_instance_init(
+        buffering_t* buffering,
+        uint8_t* ram_buffer,
+        int ram_buffer_size,
+        append_buffer_delegate ram,
+        uint8_t* flash_buffer,
+        int flash_buffer_size,
+        append_buffer_delegate flash);
+
+void buffering_instance_reset(buffering_t* buffering);
+
+// Once the transaction has moved to flash the RAM buffer is idle. With staging
+// enabled its two halves take turns receiving chunks, so appending only copies
+// to RAM and the flash write happens later in buffering_instance_flush().
+// Staging is disabled by buffering_instance_init.
+void buffering_instance_enable_staging(buffering_t* buffering);
+
+// Returns 1 if staged data is waiting to be written to flash
+uint8_t buffering_instance_has_pending(const buffering_t* buffering);
+
+// Write all staged data to flash (oldest first)
+void buffering_instance_flush(buffering_t* buffering);
+
+void buffering_instance_append(buffering_t* buffering, uint8_t* data, int length);
+
+buffer_state_t* buffering_instance_get_ram_buffer(buffering_t* buffering);
+buffer_state_t* buffering_instance_get_flash_buffer(buffering_t* buffering);
+// Flushes staged data before returning the active buffer
+buffer_state_t* buffering_instance_get_buffer(buffering_t* buffering);
+
+//---------------------------------------------
+// DEFAULT INSTANCE
+// Same functions as above working on a single global instance
+
+buffering_t* buffering_default();
+
 void buffering_init(
         uint8_t* ram_buffer,
         int ram_buffer_size,
@@ -45,6 +98,12 @@ void buffering_init(
 
 void buffering_reset();
 
+void buffering_enable_staging();
+
+uint8_t buffering_has_pending();
+
+void buffering_flush();
+
 void buffering_append(uint8_t* data, int length);
 
 buffer_state_t* buffering_get_ram_buffer();
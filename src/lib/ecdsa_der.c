@@ -0,0 +1,96 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "ecdsa_der.h"
+#include <string.h>
+
+// secp256k1 curve order and half of it
+static const uint8_t secp256k1_n[32] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+        0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b,
+        0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41
+};
+
+static const uint8_t secp256k1_half_n[32] = {
+        0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0x5d, 0x57, 0x6e, 0x73, 0x57, 0xa4, 0x50, 0x1d,
+        0xdf, 0xe9, 0x2f, 0x46, 0x68, 0x1b, 0x20, 0xa0
+};
+
+// Read one DER integer into a 32 byte big endian number.
+// Returns the position after the integer or -1.
+int ecdsa_der_read_integer(
+        const uint8_t* der,
+        unsigned int der_length,
+        unsigned int pos,
+        uint8_t value[32])
+{
+    if (pos + 2 > der_length || der[pos] != 0x02) {
+        return -1;
+    }
+    unsigned int length = der[pos + 1];
+    pos += 2;
+    if (length == 0 || pos + length > der_length) {
+        return -1;
+    }
+
+    const uint8_t* digits = der + pos;
+    unsigned int digits_length = length;
+    // A leading zero keeps the number positive
+    while (digits_length > 0 && digits[0] == 0) {
+        digits++;
+        digits_length--;
+    }
+    if (digits_length > 32) {
+        return -1;
+    }
+    memset(value, 0, 32 - digits_length);
+    memcpy(value + 32 - digits_length, digits, digits_length);
+    return pos + length;
+}
+
+int ecdsa_der_to_compact(
+        const uint8_t* der,
+        unsigned int der_length,
+        uint8_t compact[ECDSA_COMPACT_SIZE])
+{
+    if (der_length < 2 || der[0] != 0x30 || der[1] + 2u != der_length) {
+        return -1;
+    }
+
+    int pos = ecdsa_der_read_integer(der, der_length, 2, compact);
+    if (pos < 0) {
+        return -1;
+    }
+    pos = ecdsa_der_read_integer(der, der_length, pos, compact + 32);
+    if (pos < 0 || (unsigned int) pos != der_length) {
+        return -1;
+    }
+
+    // s = n - s when s > n / 2
+    uint8_t* s = compact + 32;
+    if (memcmp(s, secp256k1_half_n, 32) > 0) {
+        int borrow = 0;
+        for (int i = 31; i >= 0; i--) {
+            int digit = secp256k1_n[i] - s[i] - borrow;
+            borrow = digit < 0;
+            s[i] = (uint8_t) (digit + (borrow ? 256 : 0));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_ECDSA_DER_H
+#define CI_TEST_ECDSA_DER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ECDSA_COMPACT_SIZE  64
+
+// Convert a DER encoded secp256k1 signature (30 L 02 Lr r 02 Ls s) to the
+// 64 byte r || s form used by Cosmos. s is normalized to the lower half of
+// the curve order (low-S), as both s and n - s are valid signatures.
+// Returns 0 on success and -1 on a malformed signature.
+int ecdsa_der_to_compact(
+        const uint8_t* der,
+        unsigned int der_length,
+        uint8_t compact[ECDSA_COMPACT_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //CI_TEST_ECDSA_DER_H
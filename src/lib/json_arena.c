@@ -0,0 +1,87 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "json_arena.h"
+
+#ifdef HOST_BUILD
+
+#include <stdlib.h>
+
+void json_arena_init(json_arena_t* arena)
+{
+    arena->tokens = NULL;
+    arena->capacity = 0;
+    arena->allocations = 0;
+}
+
+void json_arena_free(json_arena_t* arena)
+{
+    free(arena->tokens);
+    json_arena_init(arena);
+}
+
+static int json_arena_grow(json_arena_t* arena)
+{
+    unsigned int capacity = arena->capacity == 0 ? JSON_ARENA_INITIAL_CAPACITY : arena->capacity * 2;
+    jsmntok_t* tokens = (jsmntok_t*) realloc(arena->tokens, capacity * sizeof(jsmntok_t));
+    if (tokens == NULL) {
+        return 0;
+    }
+    arena->tokens = tokens;
+    arena->capacity = capacity;
+    arena->allocations++;
+    return 1;
+}
+
+int json_parse_arena(
+        parsed_json_t* parsed_json,
+        json_arena_t* arena,
+        const char* transaction)
+{
+    parsed_json->CorrectFormat = false;
+    parsed_json->NumberOfTokens = 0;
+    parsed_json->SpillTokens = NULL;
+    parsed_json->NumberOfSpillTokens = 0;
+
+    if (arena->capacity == 0 && !json_arena_grow(arena)) {
+        return JSMN_ERROR_NOMEM;
+    }
+
+    jsmn_parser parser;
+    jsmn_init(&parser);
+
+    // jsmn keeps its state when it runs out of tokens, so parsing
+    // simply continues once the arena has been enlarged
+    size_t length = strlen(transaction);
+    int result;
+    while ((result = jsmn_parse(&parser, transaction, length, arena->tokens, arena->capacity)) == JSMN_ERROR_NOMEM) {
+        if (!json_arena_grow(arena)) {
+            return JSMN_ERROR_NOMEM;
+        }
+    }
+    if (result < 0) {
+        return result;
+    }
+
+    parsed_json->SpillTokens = arena->tokens;
+    parsed_json->NumberOfSpillTokens = result;
+    if (result >= 1 && arena->tokens[0].type != JSMN_OBJECT) {
+        parsed_json->CorrectFormat = true;
+    }
+    return result;
+}
+
+#endif //HOST_BUILD
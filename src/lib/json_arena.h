@@ -0,0 +1,58 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_JSONARENA_H
+#define CI_TEST_JSONARENA_H
+
+#include "json_parser.h"
+
+#ifdef HOST_BUILD
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_ARENA_INITIAL_CAPACITY     256
+
+// Reusable token storage for host side parsing. It grows geometrically
+// and is only reset between documents, so once it has reached the size of
+// the largest document no further allocations take place.
+typedef struct
+{
+    jsmntok_t*      tokens;
+    unsigned int    capacity;
+    unsigned int    allocations;    // number of times the arena had to grow
+} json_arena_t;
+
+void json_arena_init(json_arena_t* arena);
+
+void json_arena_free(json_arena_t* arena);
+
+// Parse json into the arena. There is no limit on the number of tokens.
+// parsed_json keeps no tokens of its own, all of them are reached through
+// json_get_token() and stay valid until the arena is used for the next document.
+// Returns number of tokens or a negative jsmn error.
+int json_parse_arena(
+        parsed_json_t* parsed_json,
+        json_arena_t* arena,
+        const char* transaction);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //HOST_BUILD
+#endif //CI_TEST_JSONARENA_H
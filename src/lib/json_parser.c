@@ -17,6 +17,7 @@
 
 #include <jsmn.h>
 #include "json_parser.h"
+#include "json_stream.h"
 
 int msg_bytes_pages = 0;
 int alt_bytes_pages = 0;
@@ -44,12 +45,20 @@ void json_parse(
     jsmn_parser parser;
     jsmn_init(&parser);
 
-    parsed_json->NumberOfTokens = jsmn_parse(
+    int result = jsmn_parse(
             &parser,
             transaction,
             strlen(transaction),
             parsed_json->Tokens,
             MAX_NUMBER_OF_TOKENS);
+    // jsmn errors are negative and would wrap around in the byte sized count,
+    // keep only the tokens jsmn actually filled
+    if (result < 0) {
+        result = parser.toknext < MAX_NUMBER_OF_TOKENS ? parser.toknext : MAX_NUMBER_OF_TOKENS;
+    }
+    parsed_json->NumberOfTokens = result;
+    parsed_json->SpillTokens = NULL;
+    parsed_json->NumberOfSpillTokens = 0;
 
     parsed_json->CorrectFormat = false;
     if (parsed_json->NumberOfTokens >= 1
@@ -60,6 +69,222 @@ void json_parse(
     }
 }
 
+int json_parse_spill(
+        parsed_json_t* parsed_json,
+        const char* transaction,
+        int token_count,
+        const jsmntok_t* spill_region,
+        unsigned int spill_capacity,
+        spill_delegate spill_write)
+{
+    json_parse_job_t job;
+    if (json_parse_job_init(&job, parsed_json, strlen(transaction), token_count, spill_capacity) < 0) {
+        return -1;
+    }
+    int result;
+    while ((result = json_parse_job_step(&job, parsed_json, transaction, 0xFFFF, spill_region, spill_write)) == 1) {
+    }
+    if (result < 0) {
+        return -1;
+    }
+    return json_get_token_count(parsed_json);
+}
+
+int json_parse_job_init(
+        json_parse_job_t* job,
+        parsed_json_t* parsed_json,
+        unsigned int length,
+        int token_count,
+        unsigned int spill_capacity)
+{
+    parsed_json->CorrectFormat = false;
+    parsed_json->NumberOfTokens = 0;
+    parsed_json->SpillTokens = NULL;
+    parsed_json->NumberOfSpillTokens = 0;
+
+    // The pull parser addresses the buffer with 16 bit positions, longer json would wrap around
+    if (length > UINT16_MAX) {
+        return -1;
+    }
+    job->pos = 0;
+    job->length = length;
+    job->token_count = token_count;
+    job->spill_count = 0;
+    // The count pass sizes the spilled part exactly
+    if (token_count < 0 || (token_count > MAX_NUMBER_OF_TOKENS &&
+                            (unsigned int) (token_count - MAX_NUMBER_OF_TOKENS) > spill_capacity)) {
+        return -1;
+    }
+    return 0;
+}
+
+int json_parse_job_step(
+        json_parse_job_t* job,
+        parsed_json_t* parsed_json,
+        const char* transaction,
+        unsigned int step,
+        const jsmntok_t* spill_region,
+        spill_delegate spill_write)
+{
+    // jsmn needs random access to all previous tokens to close containers.
+    // The pull parser knows where containers end when it emits them, so every
+    // token is final as soon as it is produced and the spill region is only appended to.
+    jsmntok_t block[SPILL_BLOCK_SIZE];
+    unsigned int block_size = 0;
+    jsmntok_t token;
+    int result = 1;
+    for (unsigned int i = 0; i < step; i++) {
+        result = json_stream_next_token(transaction, job->length, &job->pos, &token);
+        if (result != 1) {
+            break;
+        }
+        if (parsed_json->NumberOfTokens + job->spill_count + block_size >= (unsigned int) job->token_count) {
+            return -1;
+        }
+        if (parsed_json->NumberOfTokens < MAX_NUMBER_OF_TOKENS) {
+            parsed_json->Tokens[parsed_json->NumberOfTokens++] = token;
+            continue;
+        }
+        block[block_size++] = token;
+        if (block_size == SPILL_BLOCK_SIZE) {
+            spill_write(job->spill_count, block, block_size);
+            job->spill_count += block_size;
+            block_size = 0;
+        }
+    }
+    if (result < 0) {
+        return -1;
+    }
+    if (block_size > 0) {
+        spill_write(job->spill_count, block, block_size);
+        job->spill_count += block_size;
+    }
+    if (result == 1) {
+        return 1;
+    }
+
+    if (parsed_json->NumberOfTokens + job->spill_count != (unsigned int) job->token_count) {
+        return -1;
+    }
+    if (job->spill_count > 0) {
+        parsed_json->SpillTokens = spill_region;
+        parsed_json->NumberOfSpillTokens = job->spill_count;
+    }
+    parsed_json->CorrectFormat = parsed_json->NumberOfTokens >= 1 && parsed_json->Tokens[0].type != JSMN_OBJECT;
+    return 0;
+}
+
+int json_count_tokens(
+        const char* transaction)
+{
+    jsmn_parser parser;
+    jsmn_init(&parser);
+
+    return jsmn_parse(
+            &parser,
+            transaction,
+            strlen(transaction),
+            NULL,
+            0);
+}
+
+void json_count_job_init(
+        json_count_job_t* job,
+        unsigned int length)
+{
+    jsmn_init(&job->parser);
+    job->length = length;
+    job->count = 0;
+}
+
+// Characters that end a primitive for jsmn
+bool json_ends_primitive(char c)
+{
+    switch (c) {
+        case ':': case ',': case ']': case '}':
+        case '\t': case '\r': case '\n': case ' ':
+            return true;
+        default:
+            return false;
+    }
+}
+
+int json_count_job_step(
+        json_count_job_t* job,
+        const char* transaction,
+        unsigned int step)
+{
+    unsigned int start = job->parser.pos;
+    if (start >= job->length || transaction[start] == '\0') {
+        return 0;
+    }
+
+    // jsmn would count both halves of a cut primitive
+    unsigned int end = start + step;
+    while (end < job->length && !json_ends_primitive(transaction[end])) {
+        end++;
+    }
+    if (end > job->length) {
+        end = job->length;
+    }
+
+    int result = jsmn_parse(&job->parser, transaction, end, NULL, 0);
+    if (result == JSMN_ERROR_PART) {
+        // A string crosses the end of the slice. jsmn stopped at its opening quote
+        // and dropped the count of everything before it, so count that part again
+        // and extend the slice over the string when it is the first token.
+        unsigned int string_start = job->parser.pos;
+        if (string_start == start) {
+            end = start + 1;
+            while (end < job->length && transaction[end] != '"') {
+                end += transaction[end] == '\\' ? 2 : 1;
+            }
+            if (end >= job->length) {
+                return -1;
+            }
+            end++;
+        }
+        else {
+            job->parser.pos = start;
+            end = string_start;
+        }
+        result = jsmn_parse(&job->parser, transaction, end, NULL, 0);
+    }
+    if (result < 0) {
+        return -1;
+    }
+
+    job->count += result;
+    return job->parser.pos < job->length ? 1 : 0;
+}
+
+const jsmntok_t* json_get_token(
+        const parsed_json_t* parsed_json,
+        int token_index)
+{
+    static const jsmntok_t no_token = {JSMN_UNDEFINED, -1, -1, 0};
+    if (token_index < 0 || token_index >= json_get_token_count(parsed_json)) {
+        return &no_token;
+    }
+    if (token_index < parsed_json->NumberOfTokens) {
+        return &parsed_json->Tokens[token_index];
+    }
+    return &parsed_json->SpillTokens[token_index - parsed_json->NumberOfTokens];
+}
+
+int json_get_token_count(
+        const parsed_json_t* parsed_json)
+{
+    int count = parsed_json->NumberOfTokens;
+    if (count > MAX_NUMBER_OF_TOKENS) {
+        count = MAX_NUMBER_OF_TOKENS;
+    }
+    if (parsed_json->SpillTokens == NULL) {
+        return count;
+    }
+    return count + parsed_json->NumberOfSpillTokens;
+}
+
 int json_validate(
         const char* transaction,
         char* errorMsg,
@@ -74,16 +299,17 @@ int array_get_element_count(
         int array_token_index,
         const parsed_json_t* parsed_transaction)
 {
-    jsmntok_t array_token = parsed_transaction->Tokens[array_token_index];
+    jsmntok_t array_token = *json_get_token(parsed_transaction, array_token_index);
+    int token_count = json_get_token_count(parsed_transaction);
     int token_index = array_token_index;
     int element_count = 0;
     int prev_element_end = array_token.start;
     while (true) {
         token_index++;
-        if (token_index >= parsed_transaction->NumberOfTokens) {
+        if (token_index >= token_count) {
             break;
         }
-        jsmntok_t current_token = parsed_transaction->Tokens[token_index];
+        jsmntok_t current_token = *json_get_token(parsed_transaction, token_index);
         if (current_token.start > array_token.end) {
             break;
         }
@@ -102,16 +328,17 @@ int array_get_nth_element(
         int element_index,
         const parsed_json_t* parsed_transaction)
 {
-    jsmntok_t array_token = parsed_transaction->Tokens[array_token_index];
+    jsmntok_t array_token = *json_get_token(parsed_transaction, array_token_index);
+    int token_count = json_get_token_count(parsed_transaction);
     int token_index = array_token_index;
     int element_count = 0;
     int prev_element_end = array_token.start;
     while (true) {
         token_index++;
-        if (token_index >= parsed_transaction->NumberOfTokens) {
+        if (token_index >= token_count) {
             break;
         }
-        jsmntok_t current_token = parsed_transaction->Tokens[token_index];
+        jsmntok_t current_token = *json_get_token(parsed_transaction, token_index);
         if (current_token.start > array_token.end) {
             break;
         }
@@ -132,17 +359,21 @@ int object_get_element_count(
         int object_token_index,
         const parsed_json_t* parsed_transaction)
 {
-    jsmntok_t object_token = parsed_transaction->Tokens[object_token_index];
+    jsmntok_t object_token = *json_get_token(parsed_transaction, object_token_index);
+    int token_count = json_get_token_count(parsed_transaction);
     int token_index = object_token_index;
     int element_count = 0;
     int prev_element_end = object_token.start;
     token_index++;
     while (true) {
-        if (token_index >= parsed_transaction->NumberOfTokens) {
+        if (token_index >= token_count) {
+            break;
+        }
+        jsmntok_t key_token = *json_get_token(parsed_transaction, token_index++);
+        if (token_index >= token_count) {
             break;
         }
-        jsmntok_t key_token = parsed_transaction->Tokens[token_index++];
-        jsmntok_t value_token = parsed_transaction->Tokens[token_index];
+        jsmntok_t value_token = *json_get_token(parsed_transaction, token_index);
         if (key_token.start > object_token.end) {
             break;
         }
@@ -161,17 +392,21 @@ int object_get_nth_key(
         int object_element_index,
         const parsed_json_t* parsed_transaction)
 {
-    jsmntok_t object_token = parsed_transaction->Tokens[object_token_index];
+    jsmntok_t object_token = *json_get_token(parsed_transaction, object_token_index);
+    int token_count = json_get_token_count(parsed_transaction);
     int token_index = object_token_index;
     int element_count = 0;
     int prev_element_end = object_token.start;
     token_index++;
     while (true) {
-        if (token_index >= parsed_transaction->NumberOfTokens) {
+        if (token_index >= token_count) {
+            break;
+        }
+        jsmntok_t key_token = *json_get_token(parsed_transaction, token_index++);
+        if (token_index >= token_count) {
             break;
         }
-        jsmntok_t key_token = parsed_transaction->Tokens[token_index++];
-        jsmntok_t value_token = parsed_transaction->Tokens[token_index];
+        jsmntok_t value_token = *json_get_token(parsed_transaction, token_index);
         if (key_token.start > object_token.end) {
             break;
         }
@@ -207,16 +442,20 @@ int object_get_value(
         const char* transaction)
 {
     int length = strlen(key_name);
-    jsmntok_t object_token = parsed_transaction->Tokens[object_token_index];
+    jsmntok_t object_token = *json_get_token(parsed_transaction, object_token_index);
+    int token_count = json_get_token_count(parsed_transaction);
     int token_index = object_token_index;
     int prev_element_end = object_token.start;
     token_index++;
     while (true) {
-        if (token_index >= parsed_transaction->NumberOfTokens) {
+        if (token_index >= token_count) {
+            break;
+        }
+        jsmntok_t key_token = *json_get_token(parsed_transaction, token_index++);
+        if (token_index >= token_count) {
             break;
         }
-        jsmntok_t key_token = parsed_transaction->Tokens[token_index++];
-        jsmntok_t value_token = parsed_transaction->Tokens[token_index];
+        jsmntok_t value_token = *json_get_token(parsed_transaction, token_index);
         if (key_token.start > object_token.end) {
             break;
         }
@@ -244,11 +483,11 @@ int display_value(
         int item_index_to_display) {
 
     if (*current_item_index == item_index_to_display) {
+        const jsmntok_t* token = json_get_token(parsing_context.parsed_transaction, token_index);
 
-        *(parsing_context.view_scrolling_total_size) =
-                parsing_context.parsed_transaction->Tokens[token_index].end - parsing_context.parsed_transaction->Tokens[token_index].start;
+        *(parsing_context.view_scrolling_total_size) = token->end - token->start;
 
-        const char* address_ptr = parsing_context.transaction + parsing_context.parsed_transaction->Tokens[token_index].start;
+        const char* address_ptr = parsing_context.transaction + token->start;
         if (*(parsing_context.view_scrolling_step) < *(parsing_context.view_scrolling_total_size)) {
             int size =
                     *(parsing_context.view_scrolling_total_size) < parsing_context.max_chars_per_line ? *(parsing_context.view_scrolling_total_size): parsing_context.max_chars_per_line;
@@ -265,8 +504,9 @@ void display_key(
         char* key,
         int token_index)
 {
-    unsigned int key_size = parsing_context.parsed_transaction->Tokens[token_index].end - parsing_context.parsed_transaction->Tokens[token_index].start;
-    const char* address_ptr = parsing_context.transaction + parsing_context.parsed_transaction->Tokens[token_index].start;
+    const jsmntok_t* token = json_get_token(parsing_context.parsed_transaction, token_index);
+    unsigned int key_size = token->end - token->start;
+    const char* address_ptr = parsing_context.transaction + token->start;
     unsigned int size = key_size < parsing_context.max_chars_per_line ? key_size : parsing_context.max_chars_per_line;
     copy_fct(key, address_ptr, size);
     key[size] = '\0';
@@ -326,7 +566,7 @@ int display_arbitrary_item_inner(
                 item_index_to_display);
     }
     else {
-        switch (parsing_context.parsed_transaction->Tokens[token_index].type) {
+        switch (json_get_token(parsing_context.parsed_transaction, token_index)->type) {
             case JSMN_STRING:
                 return display_value(
                         value,
@@ -421,6 +661,81 @@ int display_get_arbitrary_items_count(
     return number_of_items;
 }
 
+void display_count_job_init(
+        display_count_job_t* job,
+        const parsed_json_t* parsed_transaction,
+        int token_index)
+{
+    job->root = token_index;
+    job->root_end = json_get_token(parsed_transaction, token_index)->end;
+    job->token_index = token_index;
+    job->skip_end = -1;
+    job->count = 0;
+    job->depth = 0;
+}
+
+int display_count_job_step(
+        display_count_job_t* job,
+        const parsed_json_t* parsed_transaction,
+        int step)
+{
+    // Follows the rules of display_arbitrary_item_inner, see stream_step in json_stream.c
+    int token_count = json_get_token_count(parsed_transaction);
+    for (int i = 0; i < step; i++) {
+        if (job->token_index < 0 || job->token_index >= token_count) {
+            return 0;
+        }
+        const jsmntok_t* token = json_get_token(parsed_transaction, job->token_index);
+        if (job->token_index > job->root && token->start >= job->root_end) {
+            return 0;
+        }
+        job->token_index++;
+        if (token->start < job->skip_end) {
+            continue;
+        }
+
+        // Leave containers that were closed before this token
+        while (job->depth > 0 && token->start >= job->frames[job->depth - 1].end) {
+            job->depth--;
+        }
+
+        int level = 0;
+        if (job->depth > 0) {
+            display_count_frame_t* parent = &job->frames[job->depth - 1];
+            if (parent->type == JSMN_OBJECT) {
+                if (parent->expect_key) {
+                    parent->expect_key = 0;
+                    continue;
+                }
+                parent->expect_key = 1;
+                level = parent->level + 1;
+            } else {
+                level = parent->level;
+            }
+        }
+
+        if (level == 2 || token->type == JSMN_STRING || token->type == JSMN_PRIMITIVE) {
+            // Nested tokens are part of this item
+            job->skip_end = token->end;
+            job->count++;
+            continue;
+        }
+        if (token->type != JSMN_OBJECT && token->type != JSMN_ARRAY) {
+            continue;
+        }
+
+        if (job->depth == MAX_JSON_DEPTH) {
+            return -1;
+        }
+        display_count_frame_t* frame = &job->frames[job->depth++];
+        frame->end = token->end;
+        frame->type = token->type;
+        frame->level = level;
+        frame->expect_key = token->type == JSMN_OBJECT;
+    }
+    return 1;
+}
+
 int display_arbitrary_item(
         int item_index_to_display, //input
         char* key, // output
@@ -441,11 +756,12 @@ void update(
         char* msg,// output
         int token_index) // input
 {
-    *(parsing_context.view_scrolling_total_size) = parsing_context.parsed_transaction->Tokens[token_index].end - parsing_context.parsed_transaction->Tokens[token_index].start;
+    const jsmntok_t* token = json_get_token(parsing_context.parsed_transaction, token_index);
+    *(parsing_context.view_scrolling_total_size) = token->end - token->start;
     int size = *(parsing_context.view_scrolling_total_size) < parsing_context.max_chars_per_line ? *(parsing_context.view_scrolling_total_size) : parsing_context.max_chars_per_line;
     copy_fct(
             msg,
-            parsing_context.transaction + parsing_context.parsed_transaction->Tokens[token_index].start + *(parsing_context.view_scrolling_step),
+            parsing_context.transaction + token->start + *(parsing_context.view_scrolling_step),
             size);
     msg[size] = '\0';
 }
@@ -515,6 +831,16 @@ int transaction_get_display_key_value(
     return 0;
 }
 
+int transaction_set_display_pages(
+        int msg_bytes_items,
+        int alt_bytes_items)
+{
+    msg_bytes_pages = msg_bytes_items;
+    alt_bytes_pages = alt_bytes_items;
+
+    return msg_bytes_pages + alt_bytes_pages + 3;
+}
+
 int transaction_get_display_pages()
 {
     int token_index_mb = object_get_value(0, "msg_bytes", parsing_context.parsed_transaction, parsing_context.transaction);
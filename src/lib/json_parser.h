@@ -20,6 +20,7 @@
 
 #include "jsmn.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
 #ifdef __cplusplus
@@ -32,6 +33,8 @@ typedef unsigned char byte;
 #define MAX_JSON_DEPTH          6
 #define MAX_INPUT_OUTPUT_COUNT  2
 #define MAX_COIN_COUNT          3
+// Number of spilled tokens that are buffered before they are written out
+#define SPILL_BLOCK_SIZE        8
 
 //---------------------------------------------
 
@@ -44,8 +47,15 @@ typedef struct
     bool        CorrectFormat;
     byte        NumberOfTokens;
     jsmntok_t   Tokens[MAX_NUMBER_OF_TOKENS];
+
+    // Tokens that did not fit into the RAM window (see json_parse_spill)
+    const jsmntok_t*    SpillTokens;
+    unsigned int        NumberOfSpillTokens;
 } parsed_json_t;
 
+// Writes count tokens to the spill region starting at spill_index
+typedef void(*spill_delegate)(unsigned int spill_index, const jsmntok_t* tokens, unsigned int count);
+
 
 typedef struct
 {
@@ -66,6 +76,86 @@ void json_parse(
         parsed_json_t* parsed_json,
         const char* transaction);
 
+// Parse json and keep tokens beyond MAX_NUMBER_OF_TOKENS in a spill region.
+// token_count comes from the count-only pass (json_count_tokens or json_count_job_t),
+// exactly token_count - MAX_NUMBER_OF_TOKENS tokens are spilled.
+// The region is read directly through spill_region and written through spill_write.
+// Returns total number of tokens or -1 if they do not fit into spill_capacity,
+// do not match token_count or the json is longer than UINT16_MAX.
+int json_parse_spill(
+        parsed_json_t* parsed_json,
+        const char* transaction,
+        int token_count,
+        const jsmntok_t* spill_region,
+        unsigned int spill_capacity,
+        spill_delegate spill_write);
+
+// Tokenizing and spilling that is split over several calls (see json_parse_job_step)
+typedef struct
+{
+    uint16_t pos;
+    uint16_t length;
+    int token_count;
+    unsigned int spill_count;
+} json_parse_job_t;
+
+// token_count comes from the count-only pass, as for json_parse_spill.
+// Returns -1 if the tokens beyond MAX_NUMBER_OF_TOKENS do not fit into spill_capacity
+// or length does not fit into the 16 bit positions of the pull parser.
+int json_parse_job_init(
+        json_parse_job_t* job,
+        parsed_json_t* parsed_json,
+        unsigned int length,
+        int token_count,
+        unsigned int spill_capacity);
+
+// Read the next step tokens with the pull parser. Spilled tokens are written
+// through spill_write, at most SPILL_BLOCK_SIZE at a time. The spill region is
+// attached to parsed_json when the last token has been read.
+// Returns 1 while tokens are left, 0 when done and -1 on malformed json or
+// when the tokens do not match token_count.
+int json_parse_job_step(
+        json_parse_job_t* job,
+        parsed_json_t* parsed_json,
+        const char* transaction,
+        unsigned int step,
+        const jsmntok_t* spill_region,
+        spill_delegate spill_write);
+
+// Count tokens without storing them (jsmn count-only pass)
+int json_count_tokens(
+        const char* transaction);
+
+// Token count that is split over several calls (see json_count_job_step)
+typedef struct
+{
+    jsmn_parser parser;
+    unsigned int length;
+    int count;
+} json_count_job_t;
+
+void json_count_job_init(
+        json_count_job_t* job,
+        unsigned int length);
+
+// Count the tokens of the next step bytes of transaction (slices are extended
+// so no token is cut in two). job->count holds the number of tokens so far.
+// Returns 1 while input is left, 0 when done and -1 on malformed json.
+int json_count_job_step(
+        json_count_job_t* job,
+        const char* transaction,
+        unsigned int step);
+
+// Get token by index, regardless of where it is stored. Out of range indexes
+// yield an undefined token with start and end set to -1
+const jsmntok_t* json_get_token(
+        const parsed_json_t* parsed_json,
+        int token_index);
+
+// Get total number of tokens, including spilled ones
+int json_get_token_count(
+        const parsed_json_t* parsed_json);
+
 // Get number of elements in array
 int array_get_element_count(
         int array_token_index,
@@ -125,12 +215,52 @@ int display_arbitrary_item(
 int display_get_arbitrary_items_count(
         int token_index);
 
+// Container that is walked while counting display items
+typedef struct
+{
+    int end;
+    byte type;
+    byte level;
+    byte expect_key;
+} display_count_frame_t;
+
+// Same count as display_get_arbitrary_items_count, split over several calls
+// (see display_count_job_step). Tokens are visited once, in order.
+typedef struct
+{
+    int root;
+    int root_end;
+    int token_index;    // next token
+    int skip_end;       // tokens before this position are inside a counted item
+    int count;
+    byte depth;
+    display_count_frame_t frames[MAX_JSON_DEPTH];
+} display_count_job_t;
+
+void display_count_job_init(
+        display_count_job_t* job,
+        const parsed_json_t* parsed_transaction,
+        int token_index);
+
+// Visit the next step tokens. job->count holds the number of items so far.
+// Returns 1 while tokens are left, 0 when done and -1 if nesting is too deep.
+int display_count_job_step(
+        display_count_job_t* job,
+        const parsed_json_t* parsed_transaction,
+        int step);
+
 int transaction_get_display_key_value(
         char* key, // output
         char* value, // output
         int index); // input
 
 int transaction_get_display_pages();
+
+// Same as transaction_get_display_pages with item counts of msg_bytes and
+// alt_bytes that were already counted (see display_count_job_t)
+int transaction_set_display_pages(
+        int msg_bytes_items,
+        int alt_bytes_items);
 //---------------------------------------------
 
 // Delegates
@@ -0,0 +1,461 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_JSONPARSER_HPP
+#define CI_TEST_JSONPARSER_HPP
+
+#include "json_parser.h"
+#include "json_arena.h"
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+// Header-only C++ view over tokens produced by the C parser.
+// Nothing is copied: values refer to tokens of a document and to the
+// json text given to it, both must outlive every value taken from it.
+// Strings are returned as they appear in the json text (escapes are kept).
+
+namespace json {
+
+#if __cplusplus >= 201703L
+using string_view = std::string_view;
+#else
+// Minimal stand-in for std::string_view until the project moves to C++17
+class string_view
+{
+public:
+    constexpr string_view() : data_(nullptr), size_(0) {}
+    constexpr string_view(const char* data, std::size_t size) : data_(data), size_(size) {}
+    string_view(const char* str) : data_(str), size_(std::strlen(str)) {}
+    string_view(const std::string& str) : data_(str.data()), size_(str.size()) {}
+
+    constexpr const char* data() const { return data_; }
+    constexpr std::size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr const char* begin() const { return data_; }
+    constexpr const char* end() const { return data_ + size_; }
+    constexpr char operator[](std::size_t i) const { return data_[i]; }
+
+    std::size_t find(char c, std::size_t pos = 0) const
+    {
+        for (; pos < size_; pos++) {
+            if (data_[pos] == c) {
+                return pos;
+            }
+        }
+        return npos;
+    }
+
+    string_view substr(std::size_t pos, std::size_t count = npos) const
+    {
+        pos = pos < size_ ? pos : size_;
+        return string_view(data_ + pos, count < size_ - pos ? count : size_ - pos);
+    }
+
+    explicit operator std::string() const { return std::string(data_, size_); }
+
+    friend bool operator==(string_view a, string_view b)
+    {
+        return a.size_ == b.size_ && (a.size_ == 0 || std::memcmp(a.data_, b.data_, a.size_) == 0);
+    }
+    friend bool operator!=(string_view a, string_view b) { return !(a == b); }
+
+    static constexpr std::size_t npos = std::size_t(-1);
+
+private:
+    const char* data_;
+    std::size_t size_;
+};
+#endif
+
+class value;
+
+namespace detail {
+    // Index of the first token after token_index that is not nested in it
+    inline int next_sibling(const parsed_json_t* parsed, int token_index)
+    {
+        int token_count = json_get_token_count(parsed);
+        int end = json_get_token(parsed, token_index)->end;
+        int i = token_index + 1;
+        while (i < token_count && json_get_token(parsed, i)->start < end) {
+            i++;
+        }
+        return i;
+    }
+}
+
+// Object member as seen while iterating
+struct member;
+
+// Forward iterator over direct children of a container.
+// Each step skips the nested tokens of the current child, so a full
+// iteration is linear in the number of tokens of the container.
+template<typename T, bool IsObject>
+class child_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = T;
+
+    child_iterator() : parsed_(nullptr), json_(nullptr), index_(-1), end_(0) {}
+    child_iterator(const parsed_json_t* parsed, const char* json, int index, int end)
+            : parsed_(parsed), json_(json), index_(index), end_(end) { settle(); }
+
+    T operator*() const;
+
+    child_iterator& operator++()
+    {
+        index_ = detail::next_sibling(parsed_, index_ + (IsObject ? 1 : 0));
+        settle();
+        return *this;
+    }
+
+    child_iterator operator++(int)
+    {
+        child_iterator previous = *this;
+        ++(*this);
+        return previous;
+    }
+
+    bool operator==(const child_iterator& other) const { return index_ == other.index_; }
+    bool operator!=(const child_iterator& other) const { return index_ != other.index_; }
+
+private:
+    // Turn into the end iterator once we left the container
+    void settle()
+    {
+        if (index_ < 0) {
+            return;
+        }
+        int token_count = json_get_token_count(parsed_);
+        if (index_ + (IsObject ? 1 : 0) >= token_count || json_get_token(parsed_, index_)->start > end_) {
+            index_ = -1;
+        }
+    }
+
+    const parsed_json_t* parsed_;
+    const char* json_;
+    int index_;
+    int end_;
+};
+
+template<typename Iterator>
+class range
+{
+public:
+    range(Iterator begin, Iterator end) : begin_(begin), end_(end) {}
+    Iterator begin() const { return begin_; }
+    Iterator end() const { return end_; }
+    bool empty() const { return begin_ == end_; }
+
+private:
+    Iterator begin_;
+    Iterator end_;
+};
+
+using element_iterator = child_iterator<value, false>;
+using member_iterator = child_iterator<member, true>;
+
+// Single json value. Invalid values (missing key, index out of range,
+// wrong type) can be queried further and simply stay invalid.
+class value
+{
+public:
+    value() : parsed_(nullptr), json_(nullptr), index_(-1) {}
+    value(const parsed_json_t* parsed, const char* json, int index)
+            : parsed_(parsed), json_(json), index_(index) {}
+
+    bool valid() const { return index_ >= 0; }
+    explicit operator bool() const { return valid(); }
+
+    // Token index in the underlying parsed_json_t, -1 if invalid
+    int index() const { return index_; }
+
+    jsmntype_t type() const { return valid() ? token()->type : JSMN_UNDEFINED; }
+    bool is_object() const { return type() == JSMN_OBJECT; }
+    bool is_array() const { return type() == JSMN_ARRAY; }
+    bool is_string() const { return type() == JSMN_STRING; }
+    bool is_primitive() const { return type() == JSMN_PRIMITIVE; }
+    bool is_null() const { return is_primitive() && text() == string_view("null", 4); }
+
+    // Raw text of the value. Strings come without quotes.
+    string_view text() const
+    {
+        if (!valid()) {
+            return string_view();
+        }
+        return string_view(json_ + token()->start, token()->end - token()->start);
+    }
+
+    // Number of direct children of an object or array
+    int size() const
+    {
+        if (is_array()) {
+            return array_get_element_count(index_, parsed_);
+        }
+        if (is_object()) {
+            return object_get_element_count(index_, parsed_);
+        }
+        return 0;
+    }
+
+    range<member_iterator> members() const
+    {
+        if (!is_object()) {
+            return range<member_iterator>(member_iterator(), member_iterator());
+        }
+        return range<member_iterator>(
+                member_iterator(parsed_, json_, index_ + 1, token()->end),
+                member_iterator());
+    }
+
+    range<element_iterator> elements() const
+    {
+        if (!is_array()) {
+            return range<element_iterator>(element_iterator(), element_iterator());
+        }
+        return range<element_iterator>(
+                element_iterator(parsed_, json_, index_ + 1, token()->end),
+                element_iterator());
+    }
+
+    // Value of a member of an object
+    value operator[](string_view key) const;
+
+    // Element of an array
+    value operator[](int element_index) const
+    {
+        if (!is_array()) {
+            return value();
+        }
+        return value(parsed_, json_, array_get_nth_element(index_, element_index, parsed_));
+    }
+
+    // Walk a '/' separated path of object keys and array indices, e.g. "fee_bytes/amount/0/denom"
+    value at_path(string_view path) const
+    {
+        value current = *this;
+        while (current.valid()) {
+            std::size_t separator = path.find('/');
+            string_view segment = path.substr(0, separator);
+            if (current.is_array()) {
+                int element_index = 0;
+                if (!parse_integer(segment, &element_index)) {
+                    return value();
+                }
+                current = current[element_index];
+            } else {
+                current = current[segment];
+            }
+            if (separator == string_view::npos) {
+                break;
+            }
+            path = path.substr(separator + 1);
+        }
+        return current;
+    }
+
+    // Typed conversion. Returns false if the value is missing or of a different type.
+    bool get(string_view* out) const
+    {
+        if (!is_string()) {
+            return false;
+        }
+        *out = text();
+        return true;
+    }
+
+    bool get(std::string* out) const
+    {
+        if (!is_string()) {
+            return false;
+        }
+        *out = std::string(text().data(), text().size());
+        return true;
+    }
+
+    bool get(bool* out) const
+    {
+        if (!is_primitive()) {
+            return false;
+        }
+        if (text() == string_view("true", 4)) {
+            *out = true;
+            return true;
+        }
+        if (text() == string_view("false", 5)) {
+            *out = false;
+            return true;
+        }
+        return false;
+    }
+
+    bool get(int64_t* out) const
+    {
+        string_view digits = text();
+        bool negative = !digits.empty() && digits[0] == '-';
+        uint64_t magnitude;
+        if (!is_primitive() || !parse_unsigned(negative ? digits.substr(1) : digits, &magnitude)) {
+            return false;
+        }
+        if (magnitude > (negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX))) {
+            return false;
+        }
+        *out = negative ? int64_t(0 - magnitude) : int64_t(magnitude);
+        return true;
+    }
+
+    bool get(uint64_t* out) const
+    {
+        return is_primitive() && parse_unsigned(text(), out);
+    }
+
+    // Typed path lookup, e.g. doc.root().get("fee_bytes/gas", &gas)
+    template<typename T>
+    bool get(string_view path, T* out) const
+    {
+        return at_path(path).get(out);
+    }
+
+private:
+    const jsmntok_t* token() const { return json_get_token(parsed_, index_); }
+
+    static bool parse_unsigned(string_view digits, uint64_t* out)
+    {
+        if (digits.empty()) {
+            return false;
+        }
+        uint64_t result = 0;
+        for (char c : digits) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            uint64_t digit = uint64_t(c - '0');
+            if (result > (UINT64_MAX - digit) / 10) {
+                return false;
+            }
+            result = result * 10 + digit;
+        }
+        *out = result;
+        return true;
+    }
+
+    static bool parse_integer(string_view digits, int* out)
+    {
+        uint64_t result;
+        if (!parse_unsigned(digits, &result) || result > uint64_t(INT32_MAX)) {
+            return false;
+        }
+        *out = int(result);
+        return true;
+    }
+
+    const parsed_json_t* parsed_;
+    const char* json_;
+    int index_;
+};
+
+struct member
+{
+    string_view key;
+    json::value value;
+};
+
+template<>
+inline value child_iterator<value, false>::operator*() const
+{
+    return value(parsed_, json_, index_);
+}
+
+template<>
+inline member child_iterator<member, true>::operator*() const
+{
+    const jsmntok_t* key = json_get_token(parsed_, index_);
+    return member{string_view(json_ + key->start, key->end - key->start), value(parsed_, json_, index_ + 1)};
+}
+
+inline value value::operator[](string_view key) const
+{
+    for (const member& m : members()) {
+        if (m.key == key) {
+            return m.value;
+        }
+    }
+    return value();
+}
+
+// RAII parse session. Tokens live in an arena owned by the document and
+// are reused when the document parses the next json text.
+class document
+{
+public:
+    document() : json_(nullptr), result_(JSMN_ERROR_INVAL)
+    {
+        json_arena_init(&arena_);
+    }
+
+    explicit document(const char* json) : document()
+    {
+        parse(json);
+    }
+
+    ~document()
+    {
+        json_arena_free(&arena_);
+    }
+
+    // Values refer back into the document
+    document(const document&) = delete;
+    document& operator=(const document&) = delete;
+
+    // Parse a new json text. Values taken from the previous text become invalid.
+    // Returns number of tokens or a negative jsmn error.
+    int parse(const char* json)
+    {
+        json_ = json;
+        result_ = json_parse_arena(&parsed_, &arena_, json);
+        return result_;
+    }
+
+    bool ok() const { return result_ > 0; }
+
+    int token_count() const { return ok() ? result_ : 0; }
+
+    // Root value, invalid if parsing failed
+    value root() const
+    {
+        return ok() ? value(&parsed_, json_, 0) : value();
+    }
+
+    const parsed_json_t* parsed() const { return &parsed_; }
+
+private:
+    json_arena_t arena_;
+    parsed_json_t parsed_;
+    const char* json_;
+    int result_;
+};
+
+}
+
+#endif //CI_TEST_JSONPARSER_HPP
@@ -0,0 +1,215 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "json_soa.h"
+
+#ifdef HOST_BUILD
+
+#include <stdlib.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define JSON_SOA_INITIAL_CAPACITY   256
+
+void json_soa_init(json_soa_t* soa)
+{
+    soa->type = NULL;
+    soa->start = NULL;
+    soa->end = NULL;
+    soa->size = NULL;
+    soa->count = 0;
+    soa->capacity = 0;
+}
+
+void json_soa_free(json_soa_t* soa)
+{
+    free(soa->type);
+    free(soa->start);
+    free(soa->end);
+    free(soa->size);
+    json_soa_init(soa);
+}
+
+static int json_soa_reserve(json_soa_t* soa, unsigned int count)
+{
+    if (count <= soa->capacity) {
+        return 1;
+    }
+    unsigned int capacity = soa->capacity == 0 ? JSON_SOA_INITIAL_CAPACITY : soa->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    uint8_t* type = (uint8_t*) realloc(soa->type, capacity * sizeof(uint8_t));
+    if (type != NULL) soa->type = type;
+    int32_t* start = (int32_t*) realloc(soa->start, capacity * sizeof(int32_t));
+    if (start != NULL) soa->start = start;
+    int32_t* end = (int32_t*) realloc(soa->end, capacity * sizeof(int32_t));
+    if (end != NULL) soa->end = end;
+    int32_t* size = (int32_t*) realloc(soa->size, capacity * sizeof(int32_t));
+    if (size != NULL) soa->size = size;
+
+    if (type == NULL || start == NULL || end == NULL || size == NULL) {
+        return 0;
+    }
+    soa->capacity = capacity;
+    return 1;
+}
+
+int json_soa_load(
+        json_soa_t* soa,
+        const parsed_json_t* parsed_json)
+{
+    unsigned int count = json_get_token_count(parsed_json);
+    soa->count = 0;
+    if (!json_soa_reserve(soa, count)) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        const jsmntok_t* token = json_get_token(parsed_json, i);
+        soa->type[i] = (uint8_t) token->type;
+        soa->start[i] = token->start;
+        soa->end[i] = token->end;
+        soa->size[i] = token->size;
+    }
+    soa->count = count;
+    return count;
+}
+
+unsigned int json_soa_find_next_start_after(
+        const json_soa_t* soa,
+        unsigned int from_index,
+        int32_t position)
+{
+    const int32_t* start = soa->start;
+    unsigned int i = from_index;
+
+#if defined(__AVX2__)
+    // 16 tokens per iteration
+    const __m256i limit = _mm256_set1_epi32(position);
+    for (; i + 16 <= soa->count; i += 16) {
+        __m256i a = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*) (start + i)), limit);
+        __m256i b = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*) (start + i + 8)), limit);
+        unsigned int mask = (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(a)) |
+                            ((unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(b)) << 8);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    // 8 tokens per iteration
+    const __m128i limit = _mm_set1_epi32(position);
+    for (; i + 8 <= soa->count; i += 8) {
+        __m128i a = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*) (start + i)), limit);
+        __m128i b = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*) (start + i + 4)), limit);
+        unsigned int mask = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(a)) |
+                            ((unsigned int) _mm_movemask_ps(_mm_castsi128_ps(b)) << 4);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < soa->count; i++) {
+        if (start[i] > position) {
+            return i;
+        }
+    }
+    return soa->count;
+}
+
+// Walk direct children of a container, stopping at child element_index.
+// Objects are walked as key/value pairs, only keys are reported.
+// Returns token index of the child or -1, *element_count receives number of children visited.
+static int json_soa_walk(
+        const json_soa_t* soa,
+        int container_token_index,
+        int element_index,
+        int is_object,
+        int* element_count)
+{
+    int32_t container_end = soa->end[container_token_index];
+    int32_t prev_element_end = soa->start[container_token_index];
+    unsigned int token_index = container_token_index + 1;
+    *element_count = 0;
+    while (true) {
+        token_index = json_soa_find_next_start_after(soa, token_index, prev_element_end);
+        if (token_index + is_object >= soa->count || soa->start[token_index] > container_end) {
+            break;
+        }
+        if (*element_count == element_index) {
+            return token_index;
+        }
+        prev_element_end = soa->end[token_index + is_object];
+        (*element_count)++;
+        token_index++;
+    }
+    return -1;
+}
+
+int json_soa_array_get_element_count(
+        int array_token_index,
+        const json_soa_t* soa)
+{
+    int element_count;
+    json_soa_walk(soa, array_token_index, -1, 0, &element_count);
+    return element_count;
+}
+
+int json_soa_array_get_nth_element(
+        int array_token_index,
+        int element_index,
+        const json_soa_t* soa)
+{
+    int element_count;
+    return json_soa_walk(soa, array_token_index, element_index, 0, &element_count);
+}
+
+int json_soa_object_get_element_count(
+        int object_token_index,
+        const json_soa_t* soa)
+{
+    int element_count;
+    json_soa_walk(soa, object_token_index, -1, 1, &element_count);
+    return element_count;
+}
+
+int json_soa_object_get_nth_key(
+        int object_token_index,
+        int object_element_index,
+        const json_soa_t* soa)
+{
+    int element_count;
+    return json_soa_walk(soa, object_token_index, object_element_index, 1, &element_count);
+}
+
+int json_soa_object_get_nth_value(
+        int object_token_index,
+        int object_element_index,
+        const json_soa_t* soa)
+{
+    int key_index = json_soa_object_get_nth_key(object_token_index, object_element_index, soa);
+    if (key_index >= 0) {
+        return key_index + 1;
+    }
+    return -1;
+}
+
+#endif //HOST_BUILD
@@ -0,0 +1,90 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_JSONSOA_H
+#define CI_TEST_JSONSOA_H
+
+#include "json_parser.h"
+#include <stdint.h>
+
+#ifdef HOST_BUILD
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Struct-of-arrays copy of a parsed document.
+// Child scans only need start/end, keeping them in separate arrays
+// lets a single vector compare test several tokens at once.
+typedef struct
+{
+    uint8_t*        type;
+    int32_t*        start;
+    int32_t*        end;
+    int32_t*        size;
+    unsigned int    count;
+    unsigned int    capacity;
+} json_soa_t;
+
+void json_soa_init(json_soa_t* soa);
+
+void json_soa_free(json_soa_t* soa);
+
+// Copy all tokens (including spilled ones) into the SoA store.
+// Storage grows geometrically and is reused between documents.
+// Returns number of tokens or -1 if memory could not be allocated.
+int json_soa_load(
+        json_soa_t* soa,
+        const parsed_json_t* parsed_json);
+
+// Get index of the first token at or after from_index that starts after position.
+// Returns soa->count if there is none.
+unsigned int json_soa_find_next_start_after(
+        const json_soa_t* soa,
+        unsigned int from_index,
+        int32_t position);
+
+// Same semantics as the parsed_json_t functions in json_parser.h
+
+int json_soa_array_get_element_count(
+        int array_token_index,
+        const json_soa_t* soa);
+
+int json_soa_array_get_nth_element(
+        int array_token_index,
+        int element_index,
+        const json_soa_t* soa);
+
+int json_soa_object_get_element_count(
+        int object_token_index,
+        const json_soa_t* soa);
+
+int json_soa_object_get_nth_key(
+        int object_token_index,
+        int object_element_index,
+        const json_soa_t* soa);
+
+int json_soa_object_get_nth_value(
+        int object_token_index,
+        int object_element_index,
+        const json_soa_t* soa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //HOST_BUILD
+#endif //CI_TEST_JSONSOA_H
@@ -0,0 +1,1031 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "json_stream.h"
+
+// Display settings are shared with the token based parser (see json_parser.c)
+extern parsing_context_t parsing_context;
+extern copy_delegate copy_fct;
+
+//---------------------------------------------
+
+static bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool is_delimiter(char c)
+{
+    return is_whitespace(c) || c == ':' || c == ',' || c == ']' || c == '}';
+}
+
+// Returns position of the closing quote or -1 if string is not terminated
+static int find_string_end(
+        const char* json,
+        uint16_t length,
+        uint16_t pos)
+{
+    for (pos++; pos < length && json[pos] != '\0'; pos++) {
+        if (json[pos] == '\\') {
+            pos++;
+            continue;
+        }
+        if (json[pos] == '"') {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+// Returns position right after the matching bracket or -1 if container is not closed.
+// children is set to the number of direct children (keys for objects).
+static int find_container_end(
+        const char* json,
+        uint16_t length,
+        uint16_t pos,
+        int* children)
+{
+    int depth = 0;
+    int commas = 0;
+    bool empty = true;
+    for (; pos < length && json[pos] != '\0'; pos++) {
+        char c = json[pos];
+        switch (c) {
+            case '"': {
+                int end = find_string_end(json, length, pos);
+                if (end < 0) {
+                    return -1;
+                }
+                if (depth == 1) {
+                    empty = false;
+                }
+                pos = end;
+                break;
+            }
+            case '{':
+            case '[':
+                depth++;
+                if (depth == 2) {
+                    empty = false;
+                }
+                break;
+            case '}':
+            case ']':
+                depth--;
+                if (depth == 0) {
+                    *children = empty ? 0 : commas + 1;
+                    return pos + 1;
+                }
+                break;
+            case ',':
+                if (depth == 1) {
+                    commas++;
+                }
+                break;
+            case ':':
+                break;
+            default:
+                if (depth == 1 && !is_whitespace(c)) {
+                    empty = false;
+                }
+                break;
+        }
+    }
+    return -1;
+}
+
+// jsmn assigns the following value as a child of a key
+static int is_key(
+        const char* json,
+        uint16_t length,
+        uint16_t pos)
+{
+    while (pos < length && is_whitespace(json[pos])) {
+        pos++;
+    }
+    return pos < length && json[pos] == ':' ? 1 : 0;
+}
+
+// Same as json_stream_next_token. A shallow read does not scan containers, their
+// end and size are left 0, and returns closing brackets as JSMN_UNDEFINED tokens.
+static int next_token(
+        const char* json,
+        uint16_t length,
+        uint16_t* pos,
+        jsmntok_t* token,
+        bool shallow)
+{
+    uint16_t p = *pos;
+    while (p < length && json[p] != '\0') {
+        char c = json[p];
+        switch (c) {
+            case '{':
+            case '[': {
+                int children = 0;
+                int end = 0;
+                if (!shallow) {
+                    end = find_container_end(json, length, p, &children);
+                    if (end < 0) {
+                        return -1;
+                    }
+                }
+                token->type = c == '{' ? JSMN_OBJECT : JSMN_ARRAY;
+                token->start = p;
+                token->end = end;
+                token->size = children;
+                *pos = p + 1;
+                return 1;
+            }
+            case '"': {
+                int end = find_string_end(json, length, p);
+                if (end < 0) {
+                    return -1;
+                }
+                token->type = JSMN_STRING;
+                token->start = p + 1;
+                token->end = end;
+                token->size = is_key(json, length, end + 1);
+                *pos = end + 1;
+                return 1;
+            }
+            case '}':
+            case ']':
+                if (shallow) {
+                    token->type = JSMN_UNDEFINED;
+                    token->start = p;
+                    token->end = p + 1;
+                    token->size = 0;
+                    *pos = p + 1;
+                    return 1;
+                }
+                p++;
+                break;
+            case ',':
+            case ':':
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                p++;
+                break;
+            default: {
+                uint16_t end = p;
+                while (end < length && json[end] != '\0' && !is_delimiter(json[end])) {
+                    if (json[end] < 32 || json[end] >= 127) {
+                        return -1;
+                    }
+                    end++;
+                }
+                token->type = JSMN_PRIMITIVE;
+                token->start = p;
+                token->end = end;
+                token->size = is_key(json, length, end);
+                *pos = end;
+                return 1;
+            }
+        }
+    }
+    *pos = p;
+    return 0;
+}
+
+int json_stream_next_token(
+        const char* json,
+        uint16_t length,
+        uint16_t* pos,
+        jsmntok_t* token)
+{
+    return next_token(json, length, pos, token, false);
+}
+
+// Find the value of a key of the object, key_length bytes of key_name are compared
+static int find_member(
+        const char* json,
+        const jsmntok_t* object,
+        const char* key_name,
+        unsigned int key_length,
+        jsmntok_t* value)
+{
+    uint16_t pos = object->start + 1;
+    jsmntok_t key;
+    int result;
+    while (true) {
+        result = json_stream_next_token(json, object->end, &pos, &key);
+        if (result <= 0) {
+            return result;
+        }
+        result = json_stream_next_token(json, object->end, &pos, value);
+        if (result <= 0) {
+            return -1;
+        }
+        if ((unsigned int) (key.end - key.start) == key_length &&
+            memcmp(key_name, json + key.start, key_length) == 0) {
+            return 1;
+        }
+        if (value->type == JSMN_OBJECT || value->type == JSMN_ARRAY) {
+            pos = value->end;
+        }
+    }
+}
+
+int json_stream_find_value(
+        const char* json,
+        uint16_t length,
+        const char* key_name,
+        jsmntok_t* value)
+{
+    uint16_t pos = 0;
+    jsmntok_t root;
+    int result = json_stream_next_token(json, length, &pos, &root);
+    if (result <= 0 || root.type != JSMN_OBJECT) {
+        return result;
+    }
+    return find_member(json, &root, key_name, strlen(key_name), value);
+}
+
+int json_stream_find_path(
+        const char* json,
+        uint16_t length,
+        const char* path,
+        jsmntok_t* value)
+{
+    uint16_t pos = 0;
+    int result = json_stream_next_token(json, length, &pos, value);
+    if (result <= 0) {
+        return result;
+    }
+
+    while (*path != '\0') {
+        // Arrays are entered at their first element
+        while (value->type == JSMN_ARRAY) {
+            pos = value->start + 1;
+            result = json_stream_next_token(json, value->end, &pos, value);
+            if (result <= 0) {
+                return result;
+            }
+        }
+        if (value->type != JSMN_OBJECT) {
+            return 0;
+        }
+
+        unsigned int key_length = 0;
+        while (path[key_length] != '\0' && path[key_length] != '/') {
+            key_length++;
+        }
+        jsmntok_t object = *value;
+        result = find_member(json, &object, path, key_length, value);
+        if (result <= 0) {
+            return result;
+        }
+        path += key_length;
+        if (*path == '/') {
+            path++;
+        }
+    }
+    return 1;
+}
+
+//---------------------------------------------
+
+// A container read by a shallow next_token that is not walked into is moved
+// over, its end and size are filled in. Returns -1 if it is not closed.
+static int stream_skip_container(
+        const json_stream_t* stream,
+        json_stream_state_t* state,
+        jsmntok_t* token)
+{
+    if (token->type != JSMN_OBJECT && token->type != JSMN_ARRAY) {
+        return 0;
+    }
+    int children = 0;
+    int end = find_container_end(stream->json, stream->root_end, token->start, &children);
+    if (end < 0) {
+        return -1;
+    }
+    token->end = end;
+    token->size = children;
+    state->pos = end;
+    return 0;
+}
+
+// Advance to the next display item following the same rules as
+// display_arbitrary_item_inner: object members go one level deeper,
+// array elements stay on the same level and anything on level 2 is
+// shown as json-encoded string.
+// Returns 1 when an item was found, 0 at the end and -1 on malformed json.
+static int stream_step(
+        const json_stream_t* stream,
+        json_stream_state_t* state,
+        jsmntok_t* item)
+{
+    jsmntok_t token;
+    while (true) {
+        int result = next_token(stream->json, stream->root_end, &state->pos, &token, true);
+        if (result < 0 || (result == 0 && state->depth > 0)) {
+            return -1;
+        }
+        if (result == 0) {
+            return 0;
+        }
+
+        if (token.type == JSMN_UNDEFINED) {
+            if (state->depth == 0) {
+                return -1;
+            }
+            state->depth--;
+            continue;
+        }
+
+        int level = 0;
+        if (state->depth > 0) {
+            json_stream_frame_t* parent = &state->frames[state->depth - 1];
+            if (parent->type == JSMN_OBJECT) {
+                if (parent->expect_key) {
+                    unsigned int key_length = token.end - token.start;
+                    parent->key_start = token.start;
+                    parent->key_length = key_length < 0xFF ? key_length : 0xFF;
+                    parent->expect_key = 0;
+                    if (stream_skip_container(stream, state, &token) < 0) {
+                        return -1;
+                    }
+                    continue;
+                }
+                parent->expect_key = 1;
+                level = parent->level + 1;
+            } else {
+                level = parent->level;
+            }
+        }
+
+        if (level == 2 || token.type == JSMN_STRING || token.type == JSMN_PRIMITIVE) {
+            if (stream_skip_container(stream, state, &token) < 0) {
+                return -1;
+            }
+            state->item_index++;
+            *item = token;
+            return 1;
+        }
+
+        if (state->depth == MAX_JSON_DEPTH) {
+            return -1;
+        }
+        json_stream_frame_t* frame = &state->frames[state->depth++];
+        frame->key_start = 0;
+        frame->key_length = 0;
+        frame->type = token.type;
+        frame->level = level;
+        frame->expect_key = token.type == JSMN_OBJECT;
+    }
+}
+
+static void stream_build_key(
+        const json_stream_t* stream,
+        const json_stream_state_t* state,
+        char* key,
+        uint16_t key_size)
+{
+    uint16_t length = 0;
+    for (int i = 0; i < state->depth; i++) {
+        const json_stream_frame_t* frame = &state->frames[i];
+        if (frame->type != JSMN_OBJECT) {
+            continue;
+        }
+        if (length > 0 && length + 1 < key_size) {
+            key[length++] = '/';
+        }
+        for (int j = 0; j < frame->key_length && length + 1 < key_size; j++) {
+            key[length++] = stream->json[frame->key_start + j];
+        }
+    }
+    key[length] = '\0';
+}
+
+enum {
+    STREAM_COUNT,
+    STREAM_CHECKPOINTS,
+    STREAM_READY
+};
+
+void json_stream_begin(
+        json_stream_t* stream,
+        const char* json,
+        const jsmntok_t* value)
+{
+    // String tokens do not include quotes, the walker needs to see them
+    bool quoted = value->type == JSMN_STRING;
+    stream->json = json;
+    stream->root = value->start - (quoted ? 1 : 0);
+    stream->root_end = value->end + (quoted ? 1 : 0);
+    stream->item_count = 0;
+    stream->checkpoint_interval = JSON_STREAM_CHECKPOINT_INTERVAL;
+    stream->checkpoint_count = 0;
+    stream->phase = STREAM_COUNT;
+
+    // The first checkpoint is the cursor of the count pass
+    stream->checkpoints[0].pos = stream->root;
+    stream->checkpoints[0].item_index = 0;
+    stream->checkpoints[0].depth = 0;
+}
+
+int json_stream_init_step(
+        json_stream_t* stream,
+        uint16_t step)
+{
+    jsmntok_t item;
+    switch (stream->phase) {
+        case STREAM_COUNT: {
+            json_stream_state_t* cursor = &stream->checkpoints[0];
+            for (uint16_t i = 0; i < step; i++) {
+                int result = stream_step(stream, cursor, &item);
+                if (result < 0) {
+                    return -1;
+                }
+                if (result > 0) {
+                    continue;
+                }
+
+                // The stride is fixed before any checkpoint is recorded
+                stream->item_count = cursor->item_index;
+                uint16_t interval = (stream->item_count + JSON_STREAM_MAX_CHECKPOINTS - 1) / JSON_STREAM_MAX_CHECKPOINTS;
+                if (interval > stream->checkpoint_interval) {
+                    stream->checkpoint_interval = interval;
+                }
+                cursor->pos = stream->root;
+                cursor->item_index = 0;
+                cursor->depth = 0;
+                stream->checkpoint_count = 1;
+                if (stream->checkpoint_interval >= stream->item_count) {
+                    stream->phase = STREAM_READY;
+                    return 0;
+                }
+                stream->checkpoints[1] = stream->checkpoints[0];
+                stream->phase = STREAM_CHECKPOINTS;
+                return 1;
+            }
+            return 1;
+        }
+        case STREAM_CHECKPOINTS: {
+            // The slot after the last checkpoint is the cursor of the checkpoint pass
+            json_stream_state_t* cursor = &stream->checkpoints[stream->checkpoint_count];
+            for (uint16_t i = 0; i < step; i++) {
+                if (stream_step(stream, cursor, &item) <= 0) {
+                    return -1;
+                }
+                if (cursor->item_index % stream->checkpoint_interval != 0) {
+                    continue;
+                }
+                stream->checkpoint_count++;
+                if (cursor->item_index + stream->checkpoint_interval >= stream->item_count) {
+                    stream->phase = STREAM_READY;
+                    return 0;
+                }
+                stream->checkpoints[stream->checkpoint_count] = *cursor;
+                cursor = &stream->checkpoints[stream->checkpoint_count];
+            }
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+int json_stream_init(
+        json_stream_t* stream,
+        const char* json,
+        const jsmntok_t* value)
+{
+    json_stream_begin(stream, json, value);
+    int result;
+    while ((result = json_stream_init_step(stream, 0xFFFF)) == 1) {
+    }
+    if (result < 0) {
+        return -1;
+    }
+    return stream->item_count;
+}
+
+int json_stream_get_item(
+        const json_stream_t* stream,
+        int item_index,
+        char* key,
+        uint16_t key_size,
+        jsmntok_t* value)
+{
+    if (stream->phase != STREAM_READY || item_index < 0 || item_index >= stream->item_count) {
+        return -1;
+    }
+
+    int checkpoint = item_index / stream->checkpoint_interval;
+    if (checkpoint >= stream->checkpoint_count) {
+        checkpoint = stream->checkpoint_count - 1;
+    }
+
+    json_stream_state_t state = stream->checkpoints[checkpoint];
+    while (state.item_index <= item_index) {
+        if (stream_step(stream, &state, value) <= 0) {
+            return -1;
+        }
+    }
+
+    stream_build_key(stream, &state, key, key_size);
+    return 1;
+}
+
+//---------------------------------------------
+
+static void fragment_emit(
+        char c,
+        uint16_t skip,
+        char* out,
+        uint16_t out_size,
+        int* total)
+{
+    if (out != NULL && *total >= skip && *total - skip < out_size - 1) {
+        out[*total - skip] = c;
+    }
+    (*total)++;
+}
+
+int json_fragment_render(
+        const char* fragment,
+        uint16_t length,
+        uint8_t* state,
+        uint16_t skip,
+        char* out,
+        uint16_t out_size)
+{
+    int total = 0;
+    for (uint16_t i = 0; i < length; i++) {
+        char c = fragment[i];
+        if (*state & JSON_FRAGMENT_IN_STRING) {
+            if (*state & JSON_FRAGMENT_ESCAPE) {
+                *state &= ~JSON_FRAGMENT_ESCAPE;
+            }
+            else if (c == '\\') {
+                *state |= JSON_FRAGMENT_ESCAPE;
+            }
+            else if (c == '"') {
+                *state &= ~JSON_FRAGMENT_IN_STRING;
+                continue;
+            }
+            // Raw bytes may cut through a multi byte character
+            fragment_emit((c >= 0x20 && c < 0x7F) ? c : '.', skip, out, out_size, &total);
+            continue;
+        }
+        switch (c) {
+            case '"':
+                *state |= JSON_FRAGMENT_IN_STRING;
+                break;
+            case ':':
+            case ',':
+                fragment_emit(c == ':' ? ':' : ';', skip, out, out_size, &total);
+                fragment_emit(' ', skip, out, out_size, &total);
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+                break;
+            default:
+                if (!is_whitespace(c)) {
+                    fragment_emit(c, skip, out, out_size, &total);
+                }
+                break;
+        }
+    }
+    if (out != NULL && out_size > 0) {
+        int end = total - skip;
+        if (end < 0) {
+            end = 0;
+        }
+        if (end > out_size - 1) {
+            end = out_size - 1;
+        }
+        out[end] = '\0';
+    }
+    return total;
+}
+
+int json_fragment_compact(
+        char* fragment,
+        uint16_t length,
+        uint8_t* state)
+{
+    int kept = 0;
+    for (uint16_t i = 0; i < length; i++) {
+        char c = fragment[i];
+        if (*state & JSON_FRAGMENT_IN_STRING) {
+            if (*state & JSON_FRAGMENT_ESCAPE) {
+                *state &= ~JSON_FRAGMENT_ESCAPE;
+            }
+            else if (c == '\\') {
+                *state |= JSON_FRAGMENT_ESCAPE;
+            }
+            else if (c == '"') {
+                *state &= ~JSON_FRAGMENT_IN_STRING;
+            }
+            fragment[kept++] = c;
+            continue;
+        }
+        if (is_whitespace(c)) {
+            if (*state & JSON_FRAGMENT_PRIMITIVE) {
+                *state |= JSON_FRAGMENT_SPACE;
+            }
+            continue;
+        }
+        switch (c) {
+            case '"':
+                *state = JSON_FRAGMENT_IN_STRING;
+                break;
+            case ':':
+            case ',':
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+                *state = 0;
+                break;
+            default:
+                if (*state & JSON_FRAGMENT_SPACE) {
+                    return -1;
+                }
+                *state = JSON_FRAGMENT_PRIMITIVE;
+                break;
+        }
+        fragment[kept++] = c;
+    }
+    return kept;
+}
+
+//---------------------------------------------
+
+static void stream_display_value(
+        const stream_display_t* display,
+        char* value,
+        const jsmntok_t* token)
+{
+    unsigned short total_size = token->end - token->start;
+    unsigned short step = *(parsing_context.view_scrolling_step);
+    *(parsing_context.view_scrolling_total_size) = total_size;
+
+    value[0] = '\0';
+    if (step < total_size) {
+        unsigned short size = total_size - step;
+        if (size > parsing_context.max_chars_per_line) {
+            size = parsing_context.max_chars_per_line;
+        }
+        copy_fct(value, display->transaction + token->start + step, size);
+        value[size] = '\0';
+    }
+}
+
+static void stream_display_key(
+        char* key,
+        const char* full_key)
+{
+    *(parsing_context.key_scrolling_total_size) = strlen(full_key);
+    int size = *(parsing_context.key_scrolling_total_size) < parsing_context.max_chars_per_line ?
+               *(parsing_context.key_scrolling_total_size) : parsing_context.max_chars_per_line;
+    copy_fct(key, full_key + *(parsing_context.key_scrolling_step), size);
+    key[size] = '\0';
+}
+
+int stream_display_init(
+        stream_display_t* display,
+        const char* transaction,
+        uint16_t length)
+{
+    stream_display_begin(display, transaction, length);
+    int result;
+    while ((result = stream_display_init_step(display, 0xFFFF)) == 1) {
+    }
+    if (result < 0) {
+        return -1;
+    }
+    return stream_display_get_pages(display);
+}
+
+enum {
+    DISPLAY_SCAN,
+    DISPLAY_WALK_MSG_BYTES,
+    DISPLAY_WALK_ALT_BYTES,
+    DISPLAY_READY
+};
+
+// Part of the top level member at the scan position
+enum {
+    SCAN_KEY,               // before or inside the key
+    SCAN_COLON,
+    SCAN_VALUE,             // before the value
+    SCAN_STRING,
+    SCAN_PRIMITIVE,
+    SCAN_CONTAINER,
+    SCAN_NEXT               // after the value
+};
+
+// Top level fields that are displayed, the bit of each is set once it is found
+static const char* const display_fields[] = {"chain_id", "sequences", "fee_bytes", "msg_bytes", "alt_bytes"};
+#define DISPLAY_FIELD_COUNT 5
+
+static void scan_member_end(
+        stream_display_t* display,
+        jsmntok_t* value)
+{
+    json_stream_scan_t* scan = &display->scan;
+    const char* key = display->transaction + scan->key_start;
+    unsigned int key_length = scan->key_end - scan->key_start;
+    scan->member = SCAN_NEXT;
+
+    for (int i = 0; i < DISPLAY_FIELD_COUNT; i++) {
+        // The first occurrence of a key is displayed
+        if (strlen(display_fields[i]) != key_length || memcmp(display_fields[i], key, key_length) != 0
+            || (scan->found & (1 << i))) {
+            continue;
+        }
+        scan->found |= 1 << i;
+        switch (i) {
+            case 0:
+                display->chain_id = *value;
+                break;
+            case 1:
+                display->sequences = *value;
+                break;
+            case 2:
+                display->fee_bytes = *value;
+                break;
+            case 3:
+                json_stream_begin(&display->msg_bytes, display->transaction, value);
+                break;
+            default:
+                json_stream_begin(&display->alt_bytes, display->transaction, value);
+                break;
+        }
+    }
+}
+
+static void scan_value_end(
+        stream_display_t* display,
+        jsmntype_t type,
+        uint16_t start,
+        uint16_t end)
+{
+    jsmntok_t value;
+    value.type = type;
+    value.start = start;
+    value.end = end;
+    value.size = 0;
+    scan_member_end(display, &value);
+}
+
+// Scans at most step bytes of the top level object.
+// Returns 1 while bytes are left, 0 once it was closed and -1 on malformed json.
+static int scan_step(
+        stream_display_t* display,
+        uint16_t step)
+{
+    json_stream_scan_t* scan = &display->scan;
+    const char* json = display->transaction;
+    uint16_t limit = display->length - scan->pos > step ? scan->pos + step : display->length;
+
+    for (; scan->pos < limit; scan->pos++) {
+        uint16_t pos = scan->pos;
+        char c = json[pos];
+        if (c == '\0') {
+            return -1;
+        }
+
+        if (scan->lexer & JSON_FRAGMENT_IN_STRING) {
+            if (scan->lexer & JSON_FRAGMENT_ESCAPE) {
+                scan->lexer &= ~JSON_FRAGMENT_ESCAPE;
+            }
+            else if (c == '\\') {
+                scan->lexer |= JSON_FRAGMENT_ESCAPE;
+            }
+            else if (c == '"') {
+                scan->lexer = 0;
+                if (scan->depth == 1 && scan->member == SCAN_KEY) {
+                    scan->key_end = pos;
+                    scan->member = SCAN_COLON;
+                }
+                else if (scan->depth == 1) {
+                    scan_value_end(display, JSMN_STRING, scan->value_start + 1, pos);
+                }
+            }
+            continue;
+        }
+        if (is_whitespace(c)) {
+            if (scan->depth == 1 && scan->member == SCAN_PRIMITIVE) {
+                scan_value_end(display, JSMN_PRIMITIVE, scan->value_start, pos);
+            }
+            continue;
+        }
+
+        if (scan->depth == 0) {
+            if (c != '{') {
+                return -1;
+            }
+            scan->depth = 1;
+            scan->member = SCAN_KEY;
+            continue;
+        }
+        if (scan->depth > 1) {
+            if (c == '"') {
+                scan->lexer = JSON_FRAGMENT_IN_STRING;
+            }
+            else if (c == '{' || c == '[') {
+                scan->depth++;
+            }
+            else if (c == '}' || c == ']') {
+                scan->depth--;
+                if (scan->depth == 1) {
+                    jsmntype_t type = json[scan->value_start] == '{' ? JSMN_OBJECT : JSMN_ARRAY;
+                    scan_value_end(display, type, scan->value_start, pos + 1);
+                }
+            }
+            continue;
+        }
+
+        // A member of the top level object
+        switch (c) {
+            case '"':
+                if (scan->member == SCAN_KEY) {
+                    scan->key_start = pos + 1;
+                }
+                else if (scan->member == SCAN_VALUE) {
+                    scan->value_start = pos;
+                    scan->member = SCAN_STRING;
+                }
+                else {
+                    return -1;
+                }
+                scan->lexer = JSON_FRAGMENT_IN_STRING;
+                break;
+            case ':':
+                if (scan->member != SCAN_COLON) {
+                    return -1;
+                }
+                scan->member = SCAN_VALUE;
+                break;
+            case '{':
+            case '[':
+                if (scan->member != SCAN_VALUE) {
+                    return -1;
+                }
+                scan->value_start = pos;
+                scan->member = SCAN_CONTAINER;
+                scan->depth++;
+                break;
+            case ',':
+            case '}':
+            case ']':
+                if (scan->member == SCAN_PRIMITIVE) {
+                    scan_value_end(display, JSMN_PRIMITIVE, scan->value_start, pos);
+                }
+                if (c == ',') {
+                    if (scan->member != SCAN_NEXT) {
+                        return -1;
+                    }
+                    scan->member = SCAN_KEY;
+                    break;
+                }
+                // An empty object has no member
+                if (scan->member != SCAN_NEXT && scan->member != SCAN_KEY) {
+                    return -1;
+                }
+                scan->pos++;
+                return 0;
+            default:
+                if (c < 32 || c >= 127) {
+                    return -1;
+                }
+                if (scan->member == SCAN_VALUE) {
+                    scan->value_start = pos;
+                    scan->member = SCAN_PRIMITIVE;
+                }
+                else if (scan->member != SCAN_PRIMITIVE) {
+                    return -1;
+                }
+                break;
+        }
+    }
+    // Not closed before the end of the transaction
+    return scan->pos < display->length ? 1 : -1;
+}
+
+void stream_display_begin(
+        stream_display_t* display,
+        const char* transaction,
+        uint16_t length)
+{
+    memset(display, 0, sizeof(stream_display_t));
+    display->transaction = transaction;
+    display->length = length;
+    display->phase = DISPLAY_SCAN;
+}
+
+int stream_display_init_step(
+        stream_display_t* display,
+        uint16_t step)
+{
+    int result;
+
+    // result is 0 when the phase is complete
+    switch (display->phase) {
+        case DISPLAY_SCAN:
+            result = scan_step(display, JSON_STREAM_SCAN_STEP);
+            if (result == 0 && display->scan.found != (1 << DISPLAY_FIELD_COUNT) - 1) {
+                result = -1;
+            }
+            break;
+        case DISPLAY_WALK_MSG_BYTES:
+            result = json_stream_init_step(&display->msg_bytes, step);
+            break;
+        case DISPLAY_WALK_ALT_BYTES:
+            result = json_stream_init_step(&display->alt_bytes, step);
+            break;
+        default:
+            return 0;
+    }
+
+    if (result < 0) {
+        return -1;
+    }
+    if (result == 0) {
+        display->phase++;
+    }
+    return display->phase == DISPLAY_READY ? 0 : 1;
+}
+
+int stream_display_get_key_value(
+        const stream_display_t* display,
+        char* key, // output
+        char* value, // output
+        int index) // input
+{
+    switch (index) {
+        case 0: {
+            copy_fct(key, "chain_id", sizeof("chain_id"));
+            stream_display_value(display, value, &display->chain_id);
+            break;
+        }
+        case 1: {
+            copy_fct(key, "sequences", sizeof("sequences"));
+            stream_display_value(display, value, &display->sequences);
+            break;
+        }
+        case 2: {
+            copy_fct(key, "fee_bytes", sizeof("fee_bytes"));
+            stream_display_value(display, value, &display->fee_bytes);
+            break;
+        }
+        default: {
+            const json_stream_t* stream = &display->msg_bytes;
+            const char* root_key = "msg_bytes";
+            int item_index = index - 3;
+            if (item_index >= display->msg_bytes.item_count) {
+                stream = &display->alt_bytes;
+                root_key = "alt_bytes";
+                item_index -= display->msg_bytes.item_count;
+            }
+
+            char full_key[50];
+            unsigned int prefix_length = strlen(root_key);
+            copy_fct(full_key, root_key, prefix_length);
+
+            jsmntok_t token;
+            if (json_stream_get_item(
+                    stream,
+                    item_index,
+                    full_key + prefix_length + 1,
+                    sizeof(full_key) - prefix_length - 1,
+                    &token) != 1) {
+                return -1;
+            }
+            full_key[prefix_length] = full_key[prefix_length + 1] == '\0' ? '\0' : '/';
+
+            stream_display_value(display, value, &token);
+            stream_display_key(key, full_key);
+            break;
+        }
+    }
+    return 0;
+}
+
+int stream_display_get_pages(
+        const stream_display_t* display)
+{
+    return display->msg_bytes.item_count + display->alt_bytes.item_count + 3;
+}
@@ -0,0 +1,235 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_JSONSTREAM_H
+#define CI_TEST_JSONSTREAM_H
+
+#include "json_parser.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of tokenizer checkpoints kept per displayed value.
+// stream_display_t shares memory with parsed_json_t and has to stay smaller.
+#define JSON_STREAM_MAX_CHECKPOINTS     16
+// Smallest distance (in display items) between two checkpoints.
+// The distance is fixed by the count pass: max(JSON_STREAM_CHECKPOINT_INTERVAL,
+// ceil(item_count / JSON_STREAM_MAX_CHECKPOINTS)). A lookup never steps over
+// more items than that distance.
+#define JSON_STREAM_CHECKPOINT_INTERVAL 4
+// Bytes of the top level object scanned by one stream_display_init_step
+#define JSON_STREAM_SCAN_STEP           1024
+
+//---------------------------------------------
+
+// Container currently being walked by the pull parser, it is left at its closing bracket
+typedef struct
+{
+    uint16_t key_start;     // key of the current member (objects only)
+    uint8_t key_length;
+    uint8_t type;           // JSMN_OBJECT or JSMN_ARRAY
+    uint8_t level;          // display level of the container itself
+    uint8_t expect_key;     // next token is a key (objects only)
+} json_stream_frame_t;
+
+// Complete pull parser state. Copies of it are used as checkpoints.
+typedef struct
+{
+    uint16_t pos;
+    uint16_t item_index;    // number of display items emitted so far
+    uint8_t depth;
+    json_stream_frame_t frames[MAX_JSON_DEPTH];
+} json_stream_state_t;
+
+// Display walker over a single json value that keeps no token array
+typedef struct
+{
+    const char* json;
+    uint16_t root;
+    uint16_t root_end;
+    uint16_t item_count;
+    uint16_t checkpoint_interval;
+    uint8_t checkpoint_count;
+    uint8_t phase;          // progress of json_stream_init_step
+    json_stream_state_t checkpoints[JSON_STREAM_MAX_CHECKPOINTS];
+} json_stream_t;
+
+// Resumable scan of the top level object that locates its members
+typedef struct
+{
+    uint16_t pos;
+    uint16_t key_start;
+    uint16_t key_end;
+    uint16_t value_start;
+    uint8_t depth;          // brackets open at pos, 1 inside the top level object
+    uint8_t lexer;          // JSON_FRAGMENT_IN_STRING and JSON_FRAGMENT_ESCAPE
+    uint8_t member;         // part of the current member
+    uint8_t found;          // displayed fields located so far, one bit each
+} json_stream_scan_t;
+
+// Everything needed to display a transaction that does not fit into parsed_json_t
+typedef struct
+{
+    const char* transaction;
+    uint16_t length;
+    json_stream_scan_t scan;
+    jsmntok_t chain_id;
+    jsmntok_t sequences;
+    jsmntok_t fee_bytes;
+    json_stream_t msg_bytes;
+    json_stream_t alt_bytes;
+    uint8_t phase;          // progress of stream_display_init_step
+} stream_display_t;
+
+//---------------------------------------------
+// PULL PARSER
+
+// Read the token that starts at or after *pos and produce it in jsmn format.
+// Tokens are returned in the same order jsmn would store them. Containers
+// are returned with their final end position and size, *pos is moved inside
+// them so the following call returns their first child.
+// Returns 1 if a token was read, 0 at the end of input and -1 on malformed json.
+int json_stream_next_token(
+        const char* json,
+        uint16_t length,
+        uint16_t* pos,
+        jsmntok_t* token);
+
+// Find the value of the given key in the top level object
+// Returns 1 if found, 0 if the key is missing and -1 on malformed json.
+int json_stream_find_value(
+        const char* json,
+        uint16_t length,
+        const char* key_name,
+        jsmntok_t* value);
+
+// Find a value below the top level object by its '/' separated keys, as the
+// display names them ("msg_bytes/outputs/address"). Arrays on the way are
+// entered at their first element.
+// Returns 1 if found, 0 if a key is missing and -1 on malformed json.
+int json_stream_find_path(
+        const char* json,
+        uint16_t length,
+        const char* path,
+        jsmntok_t* value);
+
+// Prepare a display walker for the value starting at value->start.
+// Counts display items, then records checkpoints at a fixed stride.
+// Returns number of display items or -1 on malformed json.
+int json_stream_init(
+        json_stream_t* stream,
+        const char* json,
+        const jsmntok_t* value);
+
+// Same as json_stream_init, split over several calls: json_stream_begin
+// followed by json_stream_init_step until it returns 0.
+void json_stream_begin(
+        json_stream_t* stream,
+        const char* json,
+        const jsmntok_t* value);
+
+// Walk at most step display items of the count pass or of the checkpoint pass.
+// Returns 1 while items are left, 0 when the walker is ready and -1 on malformed json.
+int json_stream_init_step(
+        json_stream_t* stream,
+        uint16_t step);
+
+// Get the nth display item. Resumes from the nearest checkpoint.
+// key receives the '/' separated path of object keys (truncated to key_size).
+// Returns 1 on success and -1 when the item does not exist.
+int json_stream_get_item(
+        const json_stream_t* stream,
+        int item_index,
+        char* key,
+        uint16_t key_size,
+        jsmntok_t* value);
+
+//---------------------------------------------
+// FRAGMENTS
+
+// Lexer state carried from one fragment of a json document to the next
+#define JSON_FRAGMENT_IN_STRING     0x01
+#define JSON_FRAGMENT_ESCAPE        0x02
+#define JSON_FRAGMENT_PRIMITIVE     0x04    // last byte kept was part of a primitive
+#define JSON_FRAGMENT_SPACE         0x08    // whitespace followed that primitive
+
+// Render an arbitrary slice of a json document as readable text. Quotes,
+// brackets and whitespace outside strings are dropped, ':' becomes ": " and
+// ',' becomes "; ". *state is the lexer state at the start of the fragment
+// and receives the state after it. Rendered text from offset skip on is
+// written to out (zero terminated, out may be NULL to only measure).
+// Returns the length of the whole rendered fragment.
+int json_fragment_render(
+        const char* fragment,
+        uint16_t length,
+        uint8_t* state,
+        uint16_t skip,
+        char* out,
+        uint16_t out_size);
+
+// Remove whitespace outside strings from a slice of a json document, in place.
+// *state is the lexer state at the start of the fragment and receives the state
+// after it, a document can be compacted in chunks of any size.
+// Returns the compacted length, or -1 if only whitespace separates two
+// primitives: they would be joined, and no valid json contains them.
+int json_fragment_compact(
+        char* fragment,
+        uint16_t length,
+        uint8_t* state);
+
+//---------------------------------------------
+// TRANSACTION DISPLAY
+
+// Locate top level fields and count pages.
+// Returns number of display pages or -1 if transaction can not be displayed.
+int stream_display_init(
+        stream_display_t* display,
+        const char* transaction,
+        uint16_t length);
+
+// Same as stream_display_init, split over several calls: stream_display_begin
+// followed by stream_display_init_step until it returns 0.
+void stream_display_begin(
+        stream_display_t* display,
+        const char* transaction,
+        uint16_t length);
+
+// Scan at most JSON_STREAM_SCAN_STEP bytes of the top level object, or walk at
+// most step display items. Containers the walk enters are not scanned ahead,
+// only a container that is shown as a single item is scanned to its end.
+// Returns 1 while work is left, 0 when ready and -1 if the transaction can not be displayed.
+int stream_display_init_step(
+        stream_display_t* display,
+        uint16_t step);
+
+// Same as transaction_get_display_key_value, without using tokens
+int stream_display_get_key_value(
+        const stream_display_t* display,
+        char* key, // output
+        char* value, // output
+        int index); // input
+
+int stream_display_get_pages(
+        const stream_display_t* display);
+
+//---------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
+#endif //CI_TEST_JSONSTREAM_H
@@ -0,0 +1,687 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <stdio.h>
+#include "policy.h"
+
+#define POLICY_AMOUNT_SIZE      8
+
+typedef struct
+{
+    uint8_t op;
+    const uint8_t* text;
+    uint8_t text_length;
+    uint64_t amount;
+} policy_rule_t;
+
+int policy_init(
+        uint8_t* policy,
+        unsigned int capacity,
+        uint8_t curve,
+        const uint32_t* path,
+        uint8_t depth)
+{
+    if (depth > POLICY_MAX_DEPTH || capacity < 3 + 4u * depth) {
+        return -1;
+    }
+    unsigned int length = 0;
+    policy[length++] = POLICY_VERSION;
+    policy[length++] = curve;
+    policy[length++] = depth;
+    for (int level = 0; level < depth; level++) {
+        for (int i = 0; i < 4; i++) {
+            policy[length++] = (path[level] >> (8 * i)) & 0xFF;
+        }
+    }
+    return length;
+}
+
+int policy_add_rule(
+        uint8_t* policy,
+        unsigned int capacity,
+        unsigned int length,
+        uint8_t op,
+        const char* text,
+        uint64_t amount)
+{
+    unsigned int text_length = strlen(text);
+    unsigned int payload_length = text_length;
+    if (op == POLICY_OP_AMOUNT_CAP || op == POLICY_OP_FEE_CAP) {
+        payload_length += POLICY_AMOUNT_SIZE;
+    }
+    if (text_length == 0 || payload_length > 255 || length + 2 + payload_length > capacity) {
+        return -1;
+    }
+
+    policy[length++] = op;
+    policy[length++] = payload_length;
+    if (op == POLICY_OP_AMOUNT_CAP || op == POLICY_OP_FEE_CAP) {
+        for (int i = POLICY_AMOUNT_SIZE - 1; i >= 0; i--) {
+            policy[length++] = (amount >> (8 * i)) & 0xFF;
+        }
+    }
+    memcpy(policy + length, text, text_length);
+    return length + text_length;
+}
+
+// Reads the rule at offset and returns the offset of the next one, -1 if the rule is malformed
+int policy_read_rule(
+        const uint8_t* policy,
+        unsigned int length,
+        unsigned int offset,
+        policy_rule_t* rule)
+{
+    if (offset + 2 > length) {
+        return -1;
+    }
+    rule->op = policy[offset];
+    uint8_t payload_length = policy[offset + 1];
+    const uint8_t* payload = policy + offset + 2;
+    if (offset + 2 + payload_length > length) {
+        return -1;
+    }
+
+    rule->amount = 0;
+    switch (rule->op) {
+        case POLICY_OP_CHAIN_ID:
+        case POLICY_OP_RECIPIENT:
+            rule->text = payload;
+            rule->text_length = payload_length;
+            break;
+        case POLICY_OP_AMOUNT_CAP:
+        case POLICY_OP_FEE_CAP:
+            if (payload_length <= POLICY_AMOUNT_SIZE) {
+                return -1;
+            }
+            for (int i = 0; i < POLICY_AMOUNT_SIZE; i++) {
+                rule->amount = (rule->amount << 8) | payload[i];
+            }
+            rule->text = payload + POLICY_AMOUNT_SIZE;
+            rule->text_length = payload_length - POLICY_AMOUNT_SIZE;
+            break;
+        default:
+            return -1;
+    }
+    if (rule->text_length == 0) {
+        return -1;
+    }
+    return offset + 2 + payload_length;
+}
+
+// Offset of the first rule, -1 if the header is malformed
+int policy_rules_offset(
+        const uint8_t* policy,
+        unsigned int length)
+{
+    if (length < 3 || policy[0] != POLICY_VERSION) {
+        return -1;
+    }
+    uint8_t curve = policy[1];
+    uint8_t depth = policy[2];
+    if ((curve != POLICY_CURVE_SECP256K1 && curve != POLICY_CURVE_ED25519)
+        || depth > POLICY_MAX_DEPTH || 3 + 4u * depth > length) {
+        return -1;
+    }
+    return 3 + 4 * depth;
+}
+
+int policy_get_rule_count(
+        const uint8_t* policy,
+        unsigned int length)
+{
+    int first = policy_rules_offset(policy, length);
+    if (first < 0) {
+        return -1;
+    }
+    int count = 0;
+    unsigned int offset = first;
+    while (offset < length) {
+        policy_rule_t rule;
+        int next = policy_read_rule(policy, length, offset, &rule);
+        if (next < 0) {
+            return -1;
+        }
+        offset = next;
+        count++;
+    }
+    return count;
+}
+
+int policy_get_key(
+        const uint8_t* policy,
+        unsigned int length,
+        uint8_t* curve,
+        uint32_t* path,
+        uint8_t* depth)
+{
+    if (policy_rules_offset(policy, length) < 0) {
+        return -1;
+    }
+    *curve = policy[1];
+    *depth = policy[2];
+    const uint8_t* levels = policy + 3;
+    for (int level = 0; level < *depth; level++) {
+        path[level] = 0;
+        for (int i = 0; i < 4; i++) {
+            path[level] |= (uint32_t) *levels++ << (8 * i);
+        }
+    }
+    return 0;
+}
+
+void policy_format_amount(
+        uint64_t amount,
+        char* digits,
+        unsigned int size)
+{
+    char reversed[21];
+    int count = 0;
+    do {
+        reversed[count++] = '0' + (amount % 10);
+        amount /= 10;
+    } while (amount > 0);
+
+    unsigned int i = 0;
+    while (count > 0 && i + 1 < size) {
+        digits[i++] = reversed[--count];
+    }
+    digits[i] = '\0';
+}
+
+// Writes the part of a longer text that starts at skip (see policy_get_key_text)
+typedef struct
+{
+    char* out;
+    unsigned int size;
+    unsigned int skip;
+    unsigned int total;
+    unsigned int written;
+} policy_text_t;
+
+void policy_text_init(
+        policy_text_t* text,
+        char* out,
+        unsigned int size,
+        unsigned int skip)
+{
+    text->out = out;
+    text->size = size;
+    text->skip = skip;
+    text->total = 0;
+    text->written = 0;
+    if (size > 0) {
+        out[0] = '\0';
+    }
+}
+
+void policy_text_append(
+        policy_text_t* text,
+        const char* data,
+        unsigned int length)
+{
+    for (unsigned int i = 0; i < length; i++) {
+        if (text->total++ >= text->skip && text->written + 1 < text->size) {
+            text->out[text->written++] = data[i];
+            text->out[text->written] = '\0';
+        }
+    }
+}
+
+int policy_get_key_text(
+        const uint8_t* policy,
+        unsigned int length,
+        char* key,
+        unsigned int key_size,
+        char* value,
+        unsigned int value_size,
+        unsigned int value_offset)
+{
+    uint8_t curve, depth;
+    uint32_t path[POLICY_MAX_DEPTH];
+    if (policy_get_key(policy, length, &curve, path, &depth) != 0) {
+        return -1;
+    }
+
+    policy_text_t text;
+    policy_text_init(&text, value, value_size, value_offset);
+    if (curve == POLICY_CURVE_SECP256K1) {
+        policy_text_append(&text, "secp256k1 m", 11);
+    }
+    else {
+        policy_text_append(&text, "ed25519 m", 9);
+    }
+    for (int level = 0; level < depth; level++) {
+        char digits[21];
+        policy_format_amount(path[level] & 0x7FFFFFFF, digits, sizeof(digits));
+        policy_text_append(&text, "/", 1);
+        policy_text_append(&text, digits, strlen(digits));
+        if (path[level] & 0x80000000) {
+            policy_text_append(&text, "'", 1);
+        }
+    }
+
+    snprintf(key, key_size, "Signing key");
+    return text.total;
+}
+
+int policy_get_rule_text(
+        const uint8_t* policy,
+        unsigned int length,
+        int rule_index,
+        char* key,
+        unsigned int key_size,
+        char* value,
+        unsigned int value_size,
+        unsigned int value_offset)
+{
+    if (policy_get_rule_count(policy, length) <= rule_index || rule_index < 0) {
+        return -1;
+    }
+
+    policy_rule_t rule;
+    unsigned int offset = policy_rules_offset(policy, length);
+    for (int i = 0; i <= rule_index; i++) {
+        offset = policy_read_rule(policy, length, offset, &rule);
+    }
+
+    policy_text_t text;
+    policy_text_init(&text, value, value_size, value_offset);
+    switch (rule.op) {
+        case POLICY_OP_CHAIN_ID:
+            snprintf(key, key_size, "Allowed chain");
+            break;
+        case POLICY_OP_RECIPIENT:
+            snprintf(key, key_size, "Allowed recipient");
+            break;
+        case POLICY_OP_AMOUNT_CAP:
+            snprintf(key, key_size, "Max amount");
+            break;
+        case POLICY_OP_FEE_CAP:
+            snprintf(key, key_size, "Max fee");
+            break;
+    }
+    if (rule.op == POLICY_OP_AMOUNT_CAP || rule.op == POLICY_OP_FEE_CAP) {
+        char amount[21];
+        policy_format_amount(rule.amount, amount, sizeof(amount));
+        policy_text_append(&text, amount, strlen(amount));
+        policy_text_append(&text, " ", 1);
+    }
+    policy_text_append(&text, (const char*) rule.text, rule.text_length);
+    return text.total;
+}
+
+//---------------------------------------------
+// Evaluation
+
+int policy_token_equals(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        int token_index,
+        const uint8_t* text,
+        unsigned int text_length)
+{
+    if (token_index < 0) {
+        return 0;
+    }
+    const jsmntok_t* token = json_get_token(parsed_transaction, token_index);
+    return token->type == JSMN_STRING
+           && (unsigned int) (token->end - token->start) == text_length
+           && memcmp(transaction + token->start, text, text_length) == 0;
+}
+
+// Value of the key, the whole key has to match (object_get_value compares prefixes)
+int policy_object_get(
+        int object_index,
+        const char* key_name,
+        const parsed_json_t* parsed_transaction,
+        const char* transaction)
+{
+    if (object_index < 0 || json_get_token(parsed_transaction, object_index)->type != JSMN_OBJECT) {
+        return -1;
+    }
+    int count = object_get_element_count(object_index, parsed_transaction);
+    for (int i = 0; i < count; i++) {
+        int key_index = object_get_nth_key(object_index, i, parsed_transaction);
+        if (policy_token_equals(parsed_transaction, transaction, key_index,
+                                (const uint8_t*) key_name, strlen(key_name))) {
+            return key_index + 1;
+        }
+    }
+    return -1;
+}
+
+// Reads a decimal amount, quoted or not. Returns 0 or -1.
+int policy_token_to_amount(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        int token_index,
+        uint64_t* amount)
+{
+    if (token_index < 0) {
+        return -1;
+    }
+    const jsmntok_t* token = json_get_token(parsed_transaction, token_index);
+    if ((token->type != JSMN_STRING && token->type != JSMN_PRIMITIVE) || token->end <= token->start) {
+        return -1;
+    }
+    uint64_t result = 0;
+    for (int i = token->start; i < token->end; i++) {
+        char c = transaction[i];
+        if (c < '0' || c > '9' || result > (UINT64_MAX - (c - '0')) / 10) {
+            return -1;
+        }
+        result = result * 10 + (c - '0');
+    }
+    *amount = result;
+    return 0;
+}
+
+// Checks that the object only has the listed keys, each one at most once, and has
+// the first required_count of them. Returns 0 or -1.
+int policy_check_object(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        int object_index,
+        const char* const* keys,
+        int key_count,
+        int required_count)
+{
+    if (object_index < 0 || json_get_token(parsed_transaction, object_index)->type != JSMN_OBJECT) {
+        return -1;
+    }
+    unsigned int seen = 0;
+    int count = object_get_element_count(object_index, parsed_transaction);
+    for (int i = 0; i < count; i++) {
+        int key_index = object_get_nth_key(object_index, i, parsed_transaction);
+        int key = 0;
+        while (key < key_count
+               && !policy_token_equals(parsed_transaction, transaction, key_index,
+                                       (const uint8_t*) keys[key], strlen(keys[key]))) {
+            key++;
+        }
+        if (key == key_count || (seen & (1u << key))) {
+            return -1;
+        }
+        seen |= 1u << key;
+    }
+    unsigned int required = (1u << required_count) - 1;
+    return (seen & required) == required ? 0 : -1;
+}
+
+// Checks an array whose elements are all objects with the listed keys (see policy_check_object)
+int policy_check_array(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        int array_index,
+        const char* const* keys,
+        int key_count)
+{
+    if (array_index < 0 || json_get_token(parsed_transaction, array_index)->type != JSMN_ARRAY) {
+        return -1;
+    }
+    int count = array_get_element_count(array_index, parsed_transaction);
+    for (int i = 0; i < count; i++) {
+        int element = array_get_nth_element(array_index, i, parsed_transaction);
+        if (policy_check_object(parsed_transaction, transaction, element, keys, key_count, key_count) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Checks that the transaction is a send message and every object in it has the
+// expected keys exactly once, so first-match lookups see the only value.
+// Returns 0 or -1.
+int policy_check_send(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction)
+{
+    static const char* const root_keys[] = {"chain_id", "fee_bytes", "msg_bytes", "alt_bytes", "sequences"};
+    static const char* const fee_keys[] = {"amount", "gas"};
+    static const char* const msg_keys[] = {"inputs", "outputs"};
+    static const char* const entry_keys[] = {"address", "coins"};
+    static const char* const coin_keys[] = {"amount", "denom"};
+
+    if (policy_check_object(parsed_transaction, transaction, 0, root_keys, 5, 3) != 0) {
+        return -1;
+    }
+
+    // Another message in alt_bytes would be signed unchecked
+    int alt_bytes = policy_object_get(0, "alt_bytes", parsed_transaction, transaction);
+    if (alt_bytes >= 0) {
+        const jsmntok_t* token = json_get_token(parsed_transaction, alt_bytes);
+        if (token->type != JSMN_PRIMITIVE || transaction[token->start] != 'n') {
+            return -1;
+        }
+    }
+    int sequences = policy_object_get(0, "sequences", parsed_transaction, transaction);
+    if (sequences >= 0) {
+        if (json_get_token(parsed_transaction, sequences)->type != JSMN_ARRAY) {
+            return -1;
+        }
+        int count = array_get_element_count(sequences, parsed_transaction);
+        for (int i = 0; i < count; i++) {
+            int element = array_get_nth_element(sequences, i, parsed_transaction);
+            if (json_get_token(parsed_transaction, element)->type != JSMN_PRIMITIVE) {
+                return -1;
+            }
+        }
+    }
+
+    int fee_bytes = policy_object_get(0, "fee_bytes", parsed_transaction, transaction);
+    if (policy_check_object(parsed_transaction, transaction, fee_bytes, fee_keys, 2, 2) != 0
+        || policy_check_array(parsed_transaction, transaction,
+                              policy_object_get(fee_bytes, "amount", parsed_transaction, transaction),
+                              coin_keys, 2) != 0) {
+        return -1;
+    }
+
+    int msg_bytes = policy_object_get(0, "msg_bytes", parsed_transaction, transaction);
+    if (policy_check_object(parsed_transaction, transaction, msg_bytes, msg_keys, 2, 2) != 0) {
+        return -1;
+    }
+    for (int k = 0; k < 2; k++) {
+        int entries = policy_object_get(msg_bytes, msg_keys[k], parsed_transaction, transaction);
+        if (policy_check_array(parsed_transaction, transaction, entries, entry_keys, 2) != 0) {
+            return -1;
+        }
+        int count = array_get_element_count(entries, parsed_transaction);
+        for (int i = 0; i < count; i++) {
+            int entry = array_get_nth_element(entries, i, parsed_transaction);
+            int address = policy_object_get(entry, "address", parsed_transaction, transaction);
+            if (json_get_token(parsed_transaction, address)->type != JSMN_STRING
+                || policy_check_array(parsed_transaction, transaction,
+                                      policy_object_get(entry, "coins", parsed_transaction, transaction),
+                                      coin_keys, 2) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Checks an array of {"amount","denom"} coins of a validated policy.
+// Every denom needs a cap rule of op. Returns 0, or -1 if the coins are refused.
+int policy_check_coins(
+        const uint8_t* policy,
+        unsigned int length,
+        uint8_t op,
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        int coins_index)
+{
+    if (coins_index < 0 || json_get_token(parsed_transaction, coins_index)->type != JSMN_ARRAY) {
+        return -1;
+    }
+    int count = array_get_element_count(coins_index, parsed_transaction);
+    for (int i = 0; i < count; i++) {
+        int coin = array_get_nth_element(coins_index, i, parsed_transaction);
+        int denom = policy_object_get(coin, "denom", parsed_transaction, transaction);
+        uint64_t amount;
+        if (policy_token_to_amount(parsed_transaction, transaction,
+                                   policy_object_get(coin, "amount", parsed_transaction, transaction),
+                                   &amount) != 0) {
+            return -1;
+        }
+
+        int capped = 0;
+        policy_rule_t rule;
+        unsigned int offset = policy_rules_offset(policy, length);
+        while (offset < length) {
+            offset = policy_read_rule(policy, length, offset, &rule);
+            if (rule.op == op && policy_token_equals(parsed_transaction, transaction, denom, rule.text, rule.text_length)) {
+                capped = 1;
+            }
+        }
+        if (!capped) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Adds the amounts of the coins with the denom of the rule to sum.
+// Returns 0, or -1 on a malformed amount or an overflow.
+int policy_sum_coins(
+        const parsed_json_t* parsed_transaction,
+        const char* transaction,
+        int coins_index,
+        const policy_rule_t* rule,
+        uint64_t* sum)
+{
+    int count = array_get_element_count(coins_index, parsed_transaction);
+    for (int i = 0; i < count; i++) {
+        int coin = array_get_nth_element(coins_index, i, parsed_transaction);
+        int denom = policy_object_get(coin, "denom", parsed_transaction, transaction);
+        if (!policy_token_equals(parsed_transaction, transaction, denom, rule->text, rule->text_length)) {
+            continue;
+        }
+        uint64_t amount;
+        if (policy_token_to_amount(parsed_transaction, transaction,
+                                   policy_object_get(coin, "amount", parsed_transaction, transaction),
+                                   &amount) != 0) {
+            return -1;
+        }
+        if (*sum > UINT64_MAX - amount) {
+            return -1;
+        }
+        *sum += amount;
+    }
+    return 0;
+}
+
+int policy_evaluate(
+        const uint8_t* policy,
+        unsigned int length,
+        const parsed_json_t* parsed_transaction,
+        const char* transaction)
+{
+    if (policy_get_rule_count(policy, length) < 0) {
+        return POLICY_INVALID;
+    }
+    if (json_get_token_count(parsed_transaction) < 1
+        || policy_check_send(parsed_transaction, transaction) != 0) {
+        return POLICY_DENY;
+    }
+
+    int chain_id = policy_object_get(0, "chain_id", parsed_transaction, transaction);
+    int msg_bytes = policy_object_get(0, "msg_bytes", parsed_transaction, transaction);
+    int outputs = policy_object_get(msg_bytes, "outputs", parsed_transaction, transaction);
+    int fee_bytes = policy_object_get(0, "fee_bytes", parsed_transaction, transaction);
+    int fee_coins = policy_object_get(fee_bytes, "amount", parsed_transaction, transaction);
+    int output_count = array_get_element_count(outputs, parsed_transaction);
+
+    // Allowlists, one flag per rule kind: present and matched
+    int chain_listed = 0, chain_matched = 0;
+    int recipient_listed = 0, amount_capped = 0, fee_capped = 0;
+
+    policy_rule_t rule;
+    unsigned int offset = policy_rules_offset(policy, length);
+    while (offset < length) {
+        offset = policy_read_rule(policy, length, offset, &rule);
+        switch (rule.op) {
+            case POLICY_OP_CHAIN_ID:
+                chain_listed = 1;
+                chain_matched |= policy_token_equals(parsed_transaction, transaction, chain_id,
+                                                     rule.text, rule.text_length);
+                break;
+            case POLICY_OP_RECIPIENT:
+                recipient_listed = 1;
+                break;
+            case POLICY_OP_AMOUNT_CAP: {
+                amount_capped = 1;
+                uint64_t sum = 0;
+                for (int i = 0; i < output_count; i++) {
+                    int output = array_get_nth_element(outputs, i, parsed_transaction);
+                    int coins = policy_object_get(output, "coins", parsed_transaction, transaction);
+                    if (coins < 0 || policy_sum_coins(parsed_transaction, transaction, coins, &rule, &sum) != 0) {
+                        return POLICY_DENY;
+                    }
+                }
+                if (sum > rule.amount) {
+                    return POLICY_DENY;
+                }
+                break;
+            }
+            case POLICY_OP_FEE_CAP: {
+                fee_capped = 1;
+                uint64_t sum = 0;
+                if (policy_sum_coins(parsed_transaction, transaction, fee_coins, &rule, &sum) != 0
+                    || sum > rule.amount) {
+                    return POLICY_DENY;
+                }
+                break;
+            }
+        }
+    }
+
+    // Without a recipient allowlist any destination could be auto-signed
+    if (!recipient_listed || (chain_listed && !chain_matched)) {
+        return POLICY_DENY;
+    }
+
+    for (int i = 0; i < output_count; i++) {
+        int output = array_get_nth_element(outputs, i, parsed_transaction);
+
+        int address = policy_object_get(output, "address", parsed_transaction, transaction);
+        int listed = 0;
+        offset = policy_rules_offset(policy, length);
+        while (offset < length) {
+            offset = policy_read_rule(policy, length, offset, &rule);
+            if (rule.op == POLICY_OP_RECIPIENT) {
+                listed |= policy_token_equals(parsed_transaction, transaction, address,
+                                              rule.text, rule.text_length);
+            }
+        }
+        if (!listed) {
+            return POLICY_DENY;
+        }
+
+        if (amount_capped) {
+            int coins = policy_object_get(output, "coins", parsed_transaction, transaction);
+            if (policy_check_coins(policy, length, POLICY_OP_AMOUNT_CAP, parsed_transaction, transaction, coins) != 0) {
+                return POLICY_DENY;
+            }
+        }
+    }
+
+    if (fee_capped
+        && policy_check_coins(policy, length, POLICY_OP_FEE_CAP, parsed_transaction, transaction, fee_coins) != 0) {
+        return POLICY_DENY;
+    }
+
+    return POLICY_ALLOW;
+}
@@ -0,0 +1,125 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_POLICY_H
+#define CI_TEST_POLICY_H
+
+#include <stdint.h>
+#include "json_parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Rules that a transaction has to satisfy to be signed without review.
+//  policy  := POLICY_VERSION curve depth path[depth] rule*
+//  path    := 4 bytes, little endian, per level (the layout of the paths in the APDUs)
+//  rule    := op length payload[length]
+// The policy only applies to signatures with the key of curve and path.
+// Only send messages ({"inputs":[...],"outputs":[...]}) are understood, other
+// transactions and documents with repeated keys are denied.
+// Rules of the same kind form an allowlist. A recipient allowlist is required,
+// the other kinds do not restrict when absent.
+//  POLICY_OP_CHAIN_ID      chain_id is one of the listed ones             payload: chain id
+//  POLICY_OP_RECIPIENT     every output address is one of the listed ones  payload: address
+//  POLICY_OP_AMOUNT_CAP    sum of the output coins of denom is at most     payload: amount (8 bytes, big endian) denom
+//                          amount, coins of other denoms are refused
+//  POLICY_OP_FEE_CAP       same for the fee coins                          payload: amount (8 bytes, big endian) denom
+
+#define POLICY_VERSION          3
+#define POLICY_MAX_SIZE         256
+#define POLICY_MAX_DEPTH        10
+
+#define POLICY_CURVE_SECP256K1  1
+#define POLICY_CURVE_ED25519    2
+
+#define POLICY_OP_CHAIN_ID      1
+#define POLICY_OP_RECIPIENT     2
+#define POLICY_OP_AMOUNT_CAP    3
+#define POLICY_OP_FEE_CAP       4
+
+#define POLICY_ALLOW            1
+#define POLICY_DENY             0
+#define POLICY_INVALID          -1
+
+// Starts an empty policy for the key of curve and path.
+// Returns its length or -1 if it does not fit.
+int policy_init(
+        uint8_t* policy,
+        unsigned int capacity,
+        uint8_t curve,
+        const uint32_t* path,
+        uint8_t depth);
+
+// Appends a rule. amount is ignored for POLICY_OP_CHAIN_ID and POLICY_OP_RECIPIENT.
+// Returns the new policy length or -1 if the rule does not fit.
+int policy_add_rule(
+        uint8_t* policy,
+        unsigned int capacity,
+        unsigned int length,
+        uint8_t op,
+        const char* text,
+        uint64_t amount);
+
+// Returns the number of rules or -1 if the policy is malformed
+int policy_get_rule_count(
+        const uint8_t* policy,
+        unsigned int length);
+
+// Reads the key the policy is bound to, path holds POLICY_MAX_DEPTH levels.
+// Returns 0 or -1 if the policy is malformed.
+int policy_get_key(
+        const uint8_t* policy,
+        unsigned int length,
+        uint8_t* curve,
+        uint32_t* path,
+        uint8_t* depth);
+
+// Describes the key for review. The value is written from character value_offset on,
+// as much as fits into value_size. Returns the length of the whole value or -1.
+int policy_get_key_text(
+        const uint8_t* policy,
+        unsigned int length,
+        char* key,
+        unsigned int key_size,
+        char* value,
+        unsigned int value_size,
+        unsigned int value_offset);
+
+// Describes a rule for review, the value is written as for policy_get_key_text.
+// Returns the length of the whole value or -1 if there is no such rule.
+int policy_get_rule_text(
+        const uint8_t* policy,
+        unsigned int length,
+        int rule_index,
+        char* key,
+        unsigned int key_size,
+        char* value,
+        unsigned int value_size,
+        unsigned int value_offset);
+
+// Checks the parsed transaction against the policy.
+// Returns POLICY_ALLOW, POLICY_DENY or POLICY_INVALID if the policy is malformed.
+int policy_evaluate(
+        const uint8_t* policy,
+        unsigned int length,
+        const parsed_json_t* parsed_transaction,
+        const char* transaction);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //CI_TEST_POLICY_H
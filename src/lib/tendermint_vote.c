@@ -0,0 +1,187 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <jsmn.h>
+#include <string.h>
+#include "tendermint_vote.h"
+
+int tm_token_equals(
+        const char* json,
+        const jsmntok_t* token,
+        const char* text)
+{
+    unsigned int length = strlen(text);
+    return token->type == JSMN_STRING
+           && (unsigned int) (token->end - token->start) == length
+           && memcmp(json + token->start, text, length) == 0;
+}
+
+// Reads a decimal number, quoted or not
+int tm_token_to_uint64(
+        const char* json,
+        const jsmntok_t* token,
+        uint64_t* value)
+{
+    if (token->type != JSMN_STRING && token->type != JSMN_PRIMITIVE) {
+        return -1;
+    }
+    if (token->end <= token->start) {
+        return -1;
+    }
+    uint64_t result = 0;
+    for (int i = token->start; i < token->end; i++) {
+        char c = json[i];
+        if (c < '0' || c > '9') {
+            return -1;
+        }
+        if (result > (UINT64_MAX - (c - '0')) / 10) {
+            return -1;
+        }
+        result = result * 10 + (c - '0');
+    }
+    *value = result;
+    return 0;
+}
+
+int tm_parse_sign_bytes(
+        parsed_json_t* parsed_json,
+        const char* sign_bytes,
+        uint16_t length,
+        tm_hrs_t* hrs,
+        char* chain_id)
+{
+    jsmn_parser parser;
+    jsmn_init(&parser);
+    int token_count = jsmn_parse(&parser, sign_bytes, length, parsed_json->Tokens, MAX_NUMBER_OF_TOKENS);
+    parsed_json->NumberOfTokens = token_count < 0 ? 0 : token_count;
+    parsed_json->SpillTokens = NULL;
+    parsed_json->NumberOfSpillTokens = 0;
+    parsed_json->CorrectFormat = false;
+
+    const jsmntok_t* tokens = parsed_json->Tokens;
+    if (token_count < 1 || tokens[0].type != JSMN_OBJECT) {
+        return -1;
+    }
+
+    enum { TYPE_UNKNOWN, TYPE_VOTE, TYPE_PROPOSAL } type = TYPE_UNKNOWN;
+    uint64_t height = 0, round = 0, vote_type = 0;
+    int found_type = 0, found_height = 0, found_round = 0, found_vote_type = 0;
+    const jsmntok_t* chain_id_token = NULL;
+
+    // Walk the members of the root object and skip nested values
+    int i = 1;
+    for (int member = 0; member < tokens[0].size && i + 1 < token_count; member++) {
+        const jsmntok_t* key = &tokens[i];
+        const jsmntok_t* value = &tokens[i + 1];
+
+        if (tm_token_equals(sign_bytes, key, "@type")) {
+            if (found_type) {
+                return -1;
+            }
+            found_type = 1;
+            if (tm_token_equals(sign_bytes, value, "vote")) {
+                type = TYPE_VOTE;
+            }
+            else if (tm_token_equals(sign_bytes, value, "proposal")) {
+                type = TYPE_PROPOSAL;
+            }
+        }
+        else if (tm_token_equals(sign_bytes, key, "@chain_id")
+                 || tm_token_equals(sign_bytes, key, "chain_id")) {
+            if (chain_id_token != NULL || value->type != JSMN_STRING) {
+                return -1;
+            }
+            chain_id_token = value;
+        }
+        else if (tm_token_equals(sign_bytes, key, "height")) {
+            if (found_height || tm_token_to_uint64(sign_bytes, value, &height) != 0) {
+                return -1;
+            }
+            found_height = 1;
+        }
+        else if (tm_token_equals(sign_bytes, key, "round")) {
+            if (found_round || tm_token_to_uint64(sign_bytes, value, &round) != 0) {
+                return -1;
+            }
+            found_round = 1;
+        }
+        else if (tm_token_equals(sign_bytes, key, "type")) {
+            if (found_vote_type || tm_token_to_uint64(sign_bytes, value, &vote_type) != 0) {
+                return -1;
+            }
+            found_vote_type = 1;
+        }
+
+        i += 2;
+        while (i < token_count && tokens[i].start < value->end) {
+            i++;
+        }
+    }
+
+    if (!found_height || !found_round || round > UINT32_MAX) {
+        return -1;
+    }
+    if (chain_id_token == NULL) {
+        return -1;
+    }
+    int chain_id_length = chain_id_token->end - chain_id_token->start;
+    if (chain_id_length < 1 || chain_id_length >= TM_CHAIN_ID_SIZE) {
+        return -1;
+    }
+    switch (type) {
+        case TYPE_PROPOSAL:
+            hrs->step = TM_STEP_PROPOSE;
+            break;
+        case TYPE_VOTE:
+            if (!found_vote_type) {
+                return -1;
+            }
+            if (vote_type == TM_VOTE_PREVOTE) {
+                hrs->step = TM_STEP_PREVOTE;
+            }
+            else if (vote_type == TM_VOTE_PRECOMMIT) {
+                hrs->step = TM_STEP_PRECOMMIT;
+            }
+            else {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+    hrs->height = height;
+    hrs->round = (uint32_t) round;
+    memset(chain_id, 0, TM_CHAIN_ID_SIZE);
+    memcpy(chain_id, sign_bytes + chain_id_token->start, chain_id_length);
+    parsed_json->CorrectFormat = true;
+    return 0;
+}
+
+int tm_hrs_compare(
+        const tm_hrs_t* a,
+        const tm_hrs_t* b)
+{
+    if (a->height != b->height) {
+        return a->height < b->height ? -1 : 1;
+    }
+    if (a->round != b->round) {
+        return a->round < b->round ? -1 : 1;
+    }
+    if (a->step != b->step) {
+        return a->step < b->step ? -1 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_TENDERMINT_VOTE_H
+#define CI_TEST_TENDERMINT_VOTE_H
+
+#include <stdint.h>
+#include "json_parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Consensus steps, in the order they happen within a round
+#define TM_STEP_PROPOSE     1
+#define TM_STEP_PREVOTE     2
+#define TM_STEP_PRECOMMIT   3
+
+// Vote types as found in vote sign bytes
+#define TM_VOTE_PREVOTE     1
+#define TM_VOTE_PRECOMMIT   2
+
+// Longest chain id accepted by Tendermint, plus the terminator
+#define TM_CHAIN_ID_SIZE    51
+
+// Height, round and step of a vote or proposal
+typedef struct
+{
+    uint64_t height;
+    uint32_t round;
+    uint8_t step;
+} tm_hrs_t;
+
+// Read height, round, step and chain id from the canonical json sign bytes of a vote
+// ("@type":"vote") or a proposal ("@type":"proposal"). Numbers may be quoted.
+// The tokens are kept in parsed_json, the sign bytes do not need a terminator.
+// chain_id is zero padded to TM_CHAIN_ID_SIZE.
+// Returns 0 on success and -1 if the sign bytes are not a vote or proposal,
+// have no chain id or repeat one of the fields.
+int tm_parse_sign_bytes(
+        parsed_json_t* parsed_json,
+        const char* sign_bytes,
+        uint16_t length,
+        tm_hrs_t* hrs,
+        char* chain_id);
+
+// Compares height, then round, then step.
+// Returns a negative number, zero or a positive number like memcmp.
+int tm_hrs_compare(
+        const tm_hrs_t* a,
+        const tm_hrs_t* b);
+
+#ifdef __cplusplus
+}
+#endif
+#endif //CI_TEST_TENDERMINT_VOTE_H
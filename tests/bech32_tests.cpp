@@ -0,0 +1,68 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/bech32.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::vector<uint8_t> from_hex(const std::string& hex)
+    {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+            data.push_back((uint8_t) std::stoul(hex.substr(i, 2), nullptr, 16));
+        }
+        return data;
+    }
+
+    TEST(Bech32Test, EmptyData) {
+        char address[100];
+        // BIP-173 test vector
+        EXPECT_EQ(bech32_encode(address, sizeof(address), "a", nullptr, 0), 8);
+        EXPECT_STREQ(address, "a12uel5l");
+    }
+
+    TEST(Bech32Test, CosmosAddress) {
+        char address[100];
+        auto hash = from_hex("751e76e8199196d454941c45d1b3a323f1433bd6");
+        EXPECT_EQ(bech32_encode(address, sizeof(address), "cosmos", hash.data(), hash.size()), 45);
+        EXPECT_STREQ(address, "cosmos1w508d6qejxtdg4y5r3zarvary0c5xw7k6ah60c");
+
+        std::vector<uint8_t> counting;
+        for (int i = 0; i < 20; i++) {
+            counting.push_back(i);
+        }
+        bech32_encode(address, sizeof(address), "cosmos", counting.data(), counting.size());
+        EXPECT_STREQ(address, "cosmos1qqqsyqcyq5rqwzqfpg9scrgwpugpzysnrk363e");
+    }
+
+    TEST(Bech32Test, PaddedData) {
+        char address[100];
+        std::vector<uint8_t> data(7, 0xFF);
+        // 56 bits are padded to 12 groups of 5 bits
+        EXPECT_EQ(bech32_encode(address, sizeof(address), "cosmos", data.data(), data.size()), 25);
+        EXPECT_STREQ(address, "cosmos1llllllllllls8l39vx");
+    }
+
+    TEST(Bech32Test, OutputTooSmall) {
+        char address[45];
+        auto hash = from_hex("751e76e8199196d454941c45d1b3a323f1433bd6");
+        EXPECT_EQ(bech32_encode(address, sizeof(address), "cosmos", hash.data(), hash.size()), -1)
+                            << "No room for the terminating zero";
+    }
+}
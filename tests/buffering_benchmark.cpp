@@ -0,0 +1,156 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Simulated upload time of a transaction for different chunk sizes and
+// buffering strategies. Not a test, run buffering_benchmark manually.
+
+#include "flash_simulator.h"
+#include "lib/buffering.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+    // USB HID moves one 64 byte report per millisecond
+    constexpr uint32_t USB_REPORT_SIZE = 64;
+    constexpr uint32_t USB_REPORT_US = 1000;
+    constexpr uint32_t APDU_HEADER_SIZE = 5;
+
+    constexpr int RAM_BUFFER_SIZE = 512;
+    constexpr int FLASH_BUFFER_SIZE = 16384;
+
+    enum strategy_t {
+        DIRECT,             // flash write before the reply
+        STAGED,             // reply first, flash write overlaps the next transfer
+        STAGED_PREPARED,    // as STAGED, the buffer was erased while idle
+    };
+
+    const char* strategy_names[] = {"direct", "staged", "staged+prepared"};
+
+    struct result_t {
+        uint64_t upload_us;
+        uint32_t writes;
+        uint32_t erases;
+        uint32_t max_wear;
+        uint32_t stored_bytes;
+    };
+
+    std::string make_transaction(int outputs, int seed)
+    {
+        std::string msg = R"({"inputs":[{"address":"cosmos1kky4yzth6gdrm8ga5zlfwhav33yr7hl87jycah","coins":[{"amount":"10","denom":"uatom"}]}],"outputs":[)";
+        for (int i = 0; i < outputs; i++) {
+            if (i > 0) {
+                msg += ",";
+            }
+            msg += R"({"address":"cosmos1w3k9k4x8e9r7ydn3cjv2lshfjaqh3ju6ay)" + std::to_string(1000 + i + seed) + R"(","coins":[{"amount":")" + std::to_string(i * 7 + seed) + R"(","denom":"uatom"}]})";
+        }
+        msg += "]}";
+        return R"({"alt_bytes":null,"chain_id":"cosmoshub-1","fee_bytes":{"amount":[{"amount":"600","denom":"uatom"}],"gas":"200000"},"msg_bytes":)"
+               + msg + R"(,"sequences":[106]})";
+    }
+
+    uint64_t transfer_us(uint32_t chunk_size)
+    {
+        uint32_t reports = (chunk_size + APDU_HEADER_SIZE + USB_REPORT_SIZE - 1) / USB_REPORT_SIZE;
+        // Command and status word reply
+        return (reports + 1) * USB_REPORT_US;
+    }
+
+    void upload(buffering_t* buffering, flash_simulator* flash, const std::string& transaction,
+                uint32_t chunk_size, bool staged, uint64_t* upload_us)
+    {
+        uint64_t pending_commit_us = 0;
+        buffering_instance_reset(buffering);
+        for (size_t offset = 0; offset < transaction.size(); offset += chunk_size) {
+            uint32_t length = std::min<size_t>(chunk_size, transaction.size() - offset);
+
+            // The previous commit runs while this chunk is on the wire
+            *upload_us += std::max(transfer_us(length), pending_commit_us);
+
+            uint64_t before = flash->get_stats().elapsed_us;
+            buffering_instance_append(buffering, (uint8_t*) transaction.data() + offset, length);
+            *upload_us += flash->get_stats().elapsed_us - before;
+
+            pending_commit_us = 0;
+            if (staged) {
+                before = flash->get_stats().elapsed_us;
+                buffering_instance_flush(buffering);
+                pending_commit_us = flash->get_stats().elapsed_us - before;
+            }
+        }
+        // Barrier before parsing
+        *upload_us += pending_commit_us;
+        buffering_instance_get_buffer(buffering);
+    }
+
+    result_t run(strategy_t strategy, const std::string& previous, const std::string& transaction, uint32_t chunk_size)
+    {
+        static uint8_t ram_buffer[RAM_BUFFER_SIZE];
+        flash_simulator flash(FLASH_BUFFER_SIZE);
+        flash.activate();
+
+        buffering_t buffering;
+        buffering_instance_init(
+                &buffering,
+                ram_buffer,
+                sizeof(ram_buffer),
+                [](buffer_state_t* buffer, uint8_t* data, int size) {
+                    memcpy(buffer->data+buffer->pos, data, size);
+                },
+                flash.data(),
+                flash.size(),
+                &flash_simulator::append);
+        if (strategy != DIRECT) {
+            buffering_instance_enable_staging(&buffering);
+        }
+
+        // Steady state: the buffer holds the previous transaction
+        uint64_t warmup_us = 0;
+        upload(&buffering, &flash, previous, chunk_size, strategy != DIRECT, &warmup_us);
+        if (strategy == STAGED_PREPARED) {
+            flash.erase(0, flash.size());
+        }
+        flash.reset_stats();
+
+        result_t result = {};
+        upload(&buffering, &flash, transaction, chunk_size, strategy != DIRECT, &result.upload_us);
+        result.writes = flash.get_stats().writes;
+        result.erases = flash.get_stats().pages_erased;
+        result.max_wear = flash.max_wear();
+        result.stored_bytes = buffering_instance_get_buffer(&buffering)->pos;
+        return result;
+    }
+}
+
+int main()
+{
+    const std::string previous = make_transaction(60, 0);
+    const std::string transaction = make_transaction(60, 1);
+    printf("transaction: %zu bytes, RAM buffer %d bytes, flash page 64 bytes\n\n",
+           transaction.size(), RAM_BUFFER_SIZE);
+    printf("%-6s %-18s %10s %8s %8s %9s %8s\n", "chunk", "strategy", "upload ms", "writes", "erases", "max wear", "stored");
+
+    for (uint32_t chunk_size : {64u, 128u, 200u, 250u}) {
+        for (int strategy = DIRECT; strategy <= STAGED_PREPARED; strategy++) {
+            result_t result = run((strategy_t) strategy, previous, transaction, chunk_size);
+            printf("%-6u %-18s %10.1f %8u %8u %9u %8u\n",
+                   chunk_size, strategy_names[strategy], result.upload_us / 1000.0,
+                   result.writes, result.erases, result.max_wear, result.stored_bytes);
+        }
+    }
+    return 0;
+}
@@ -211,4 +211,128 @@ namespace {
         EXPECT_FALSE(buffering_get_flash_buffer()->in_use) << "After reset RAM should be enabled by default";
 
     }
+    int flash_writes = 0;
+
+    TEST(Buffering, StagingDefersFlashWrites) {
+
+        uint8_t ram_buffer[100];
+        uint8_t flash_buffer[1000];
+
+        flash_writes = 0;
+        buffering_init(
+                ram_buffer,
+                sizeof(ram_buffer),
+                [](buffer_state_t* buffer, uint8_t* data, int size) {
+                    memcpy(buffer->data+buffer->pos, data, size);
+                },
+                flash_buffer,
+                sizeof(flash_buffer),
+                [](buffer_state_t* buffer, uint8_t* data, int size) {
+                    memcpy(buffer->data+buffer->pos, data, size);
+                    flash_writes++;
+                });
+        buffering_enable_staging();
+
+        uint8_t chunk[40];
+        uint8_t expected[400];
+        for (int i = 0; i < 10; i++) {
+            memset(chunk, 'a' + i, sizeof(chunk));
+            memcpy(expected + i * sizeof(chunk), chunk, sizeof(chunk));
+            int writes = flash_writes;
+            buffering_append(chunk, sizeof(chunk));
+            if (i >= 2) {
+                // Third chunk does not fit into RAM, RAM content moves to flash and staging starts
+                EXPECT_TRUE(buffering_has_pending()) << "Chunk " << i << " should be staged";
+                EXPECT_EQ(flash_writes, writes + (i == 2 ? 1 : 0)) << "Appending should not write to flash";
+                buffering_flush();
+                EXPECT_FALSE(buffering_has_pending());
+            }
+        }
+
+        EXPECT_EQ(400, buffering_get_buffer()->pos) << "Wrong position of the written data in the flash buffer";
+        EXPECT_EQ(0, memcmp(flash_buffer, expected, sizeof(expected))) << "Wrong flash content";
+    }
+
+    TEST(Buffering, StagingKeepsOrderWithoutFlush) {
+
+        uint8_t ram_buffer[100];
+        uint8_t flash_buffer[1000];
+
+        buffering_init(
+                ram_buffer,
+                sizeof(ram_buffer),
+                [](buffer_state_t* buffer, uint8_t* data, int size) {
+                    memcpy(buffer->data+buffer->pos, data, size);
+                },
+                flash_buffer,
+                sizeof(flash_buffer),
+                [](buffer_state_t* buffer, uint8_t* data, int size) {
+                    memcpy(buffer->data+buffer->pos, data, size);
+                });
+        buffering_enable_staging();
+
+        // Mix of chunks that fit into a staging half and chunks that do not
+        const int sizes[] = {30, 80, 20, 50, 70, 10, 45, 5};
+        uint8_t expected[1000];
+        int length = 0;
+        for (int i = 0; i < 8; i++) {
+            uint8_t chunk[100];
+            memset(chunk, 'a' + i, sizes[i]);
+            memcpy(expected + length, chunk, sizes[i]);
+            length += sizes[i];
+            buffering_append(chunk, sizes[i]);
+        }
+
+        // Getting the buffer acts as a barrier
+        buffer_state_t* buffer = buffering_get_buffer();
+        EXPECT_FALSE(buffering_has_pending());
+        EXPECT_EQ(length, buffer->pos) << "Wrong position of the written data in the flash buffer";
+        EXPECT_EQ(0, memcmp(flash_buffer, expected, length)) << "Wrong flash content";
+    }
+    TEST(Buffering, IndependentInstances) {
+
+        uint8_t ram_buffers[4][100];
+        uint8_t flash_buffers[4][1000];
+        buffering_t instances[4];
+
+        for (int i = 0; i < 4; i++) {
+            buffering_instance_init(
+                    &instances[i],
+                    ram_buffers[i],
+                    sizeof(ram_buffers[i]),
+                    [](buffer_state_t* buffer, uint8_t* data, int size) {
+                        memcpy(buffer->data+buffer->pos, data, size);
+                    },
+                    flash_buffers[i],
+                    sizeof(flash_buffers[i]),
+                    [](buffer_state_t* buffer, uint8_t* data, int size) {
+                        memcpy(buffer->data+buffer->pos, data, size);
+                    });
+            if (i % 2) {
+                buffering_instance_enable_staging(&instances[i]);
+            }
+        }
+
+        // Interleave appends, instance i receives (i + 1) * 60 bytes of the letter 'a' + i
+        for (int round = 0; round < 4; round++) {
+            for (int i = 0; i < 4; i++) {
+                if (round <= i) {
+                    uint8_t chunk[60];
+                    memset(chunk, 'a' + i, sizeof(chunk));
+                    buffering_instance_append(&instances[i], chunk, sizeof(chunk));
+                }
+            }
+        }
+
+        for (int i = 0; i < 4; i++) {
+            buffer_state_t* buffer = buffering_instance_get_buffer(&instances[i]);
+            EXPECT_EQ((i + 1) * 60, buffer->pos) << "Wrong length of instance " << i;
+            EXPECT_EQ(i == 0, buffer == buffering_instance_get_ram_buffer(&instances[i]))
+                                << "Only the first instance should fit into RAM";
+            for (int k = 0; k < buffer->pos; k++) {
+                ASSERT_EQ('a' + i, buffer->data[k]) << "Wrong content of instance " << i;
+            }
+        }
+        EXPECT_NE(buffering_default(), &instances[0]);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/ecdsa_der.h"
+#include <vector>
+
+namespace {
+
+    const std::vector<uint8_t> curve_order = {
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+            0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b,
+            0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41
+    };
+
+    // DER integer of a 32 byte big endian number, minimal encoding
+    std::vector<uint8_t> der_integer(std::vector<uint8_t> value)
+    {
+        while (value.size() > 1 && value[0] == 0 && value[1] < 0x80) {
+            value.erase(value.begin());
+        }
+        if (value[0] >= 0x80) {
+            value.insert(value.begin(), 0);
+        }
+        std::vector<uint8_t> integer = {0x02, (uint8_t) value.size()};
+        integer.insert(integer.end(), value.begin(), value.end());
+        return integer;
+    }
+
+    std::vector<uint8_t> der_signature(const std::vector<uint8_t>& r, const std::vector<uint8_t>& s)
+    {
+        auto r_der = der_integer(r);
+        auto s_der = der_integer(s);
+        std::vector<uint8_t> der = {0x30, (uint8_t) (r_der.size() + s_der.size())};
+        der.insert(der.end(), r_der.begin(), r_der.end());
+        der.insert(der.end(), s_der.begin(), s_der.end());
+        return der;
+    }
+
+    std::vector<uint8_t> number(uint8_t first, uint8_t fill, uint8_t last)
+    {
+        std::vector<uint8_t> value(32, fill);
+        value[0] = first;
+        value[31] = last;
+        return value;
+    }
+
+    TEST(EcdsaDerTest, LowS) {
+        auto r = number(0x12, 0x34, 0x56);
+        auto s = number(0x01, 0x02, 0x03);
+        auto der = der_signature(r, s);
+
+        uint8_t compact[ECDSA_COMPACT_SIZE];
+        ASSERT_EQ(ecdsa_der_to_compact(der.data(), der.size(), compact), 0);
+        EXPECT_EQ(std::vector<uint8_t>(compact, compact + 32), r);
+        EXPECT_EQ(std::vector<uint8_t>(compact + 32, compact + 64), s);
+    }
+
+    TEST(EcdsaDerTest, PaddedIntegers) {
+        // r with the high bit set gets a leading zero, short s is left padded
+        auto r = number(0xF0, 0x11, 0x22);
+        auto s = number(0x00, 0x00, 0x7F);
+        auto der = der_signature(r, s);
+        EXPECT_EQ(der[3], 33);
+        EXPECT_EQ(der.size(), 2u + 2 + 33 + 2 + 1);
+
+        uint8_t compact[ECDSA_COMPACT_SIZE];
+        ASSERT_EQ(ecdsa_der_to_compact(der.data(), der.size(), compact), 0);
+        EXPECT_EQ(std::vector<uint8_t>(compact, compact + 32), r);
+        EXPECT_EQ(std::vector<uint8_t>(compact + 32, compact + 64), s);
+    }
+
+    TEST(EcdsaDerTest, HighSIsNormalized) {
+        auto r = number(0x12, 0x34, 0x56);
+        // s = n - 1 becomes 1
+        auto s = curve_order;
+        s[31] -= 1;
+        auto der = der_signature(r, s);
+
+        uint8_t compact[ECDSA_COMPACT_SIZE];
+        ASSERT_EQ(ecdsa_der_to_compact(der.data(), der.size(), compact), 0);
+        EXPECT_EQ(std::vector<uint8_t>(compact + 32, compact + 64), number(0, 0, 1));
+
+        // s = n - 0x100 needs a borrow
+        s = curve_order;
+        s[30] -= 1;
+        der = der_signature(r, s);
+        ASSERT_EQ(ecdsa_der_to_compact(der.data(), der.size(), compact), 0);
+        auto expected = number(0, 0, 0);
+        expected[30] = 1;
+        EXPECT_EQ(std::vector<uint8_t>(compact + 32, compact + 64), expected);
+    }
+
+    TEST(EcdsaDerTest, Malformed) {
+        auto der = der_signature(number(0x12, 0x34, 0x56), number(0x01, 0x02, 0x03));
+        uint8_t compact[ECDSA_COMPACT_SIZE];
+
+        auto wrong_tag = der;
+        wrong_tag[0] = 0x31;
+        EXPECT_EQ(ecdsa_der_to_compact(wrong_tag.data(), wrong_tag.size(), compact), -1);
+
+        auto truncated = der;
+        truncated.pop_back();
+        EXPECT_EQ(ecdsa_der_to_compact(truncated.data(), truncated.size(), compact), -1);
+
+        auto wrong_length = der;
+        wrong_length[3] += 1;
+        EXPECT_EQ(ecdsa_der_to_compact(wrong_length.data(), wrong_length.size(), compact), -1);
+
+        // r longer than 32 bytes
+        std::vector<uint8_t> long_r(33, 0x11);
+        std::vector<uint8_t> r_der = {0x02, 33};
+        r_der.insert(r_der.end(), long_r.begin(), long_r.end());
+        std::vector<uint8_t> s_der = {0x02, 1, 0x01};
+        std::vector<uint8_t> too_long = {0x30, (uint8_t) (r_der.size() + s_der.size())};
+        too_long.insert(too_long.end(), r_der.begin(), r_der.end());
+        too_long.insert(too_long.end(), s_der.begin(), s_der.end());
+        EXPECT_EQ(ecdsa_der_to_compact(too_long.data(), too_long.size(), compact), -1);
+    }
+}
@@ -0,0 +1,153 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#ifndef CI_TEST_FLASH_SIMULATOR_H
+#define CI_TEST_FLASH_SIMULATOR_H
+
+#include "lib/buffering.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Host model of the device NVM used as flash delegate of the buffering layer.
+// Flash is written in whole pages. A page has to be erased (all bits set)
+// before bits can be set again, so any write that turns a 0 bit into 1
+// costs an erase. Times are simulated, nothing actually waits.
+class flash_simulator
+{
+public:
+    struct config
+    {
+        config() : page_size(64), erase_us(1800), program_us(1500), write_overhead_us(100) {}
+
+        uint32_t page_size;
+        uint32_t erase_us;              // erase of one page
+        uint32_t program_us;            // program of one page
+        uint32_t write_overhead_us;     // fixed cost of a single nvm_write call
+    };
+
+    struct stats
+    {
+        uint64_t elapsed_us = 0;
+        uint32_t writes = 0;
+        uint32_t pages_programmed = 0;
+        uint32_t pages_erased = 0;
+        uint64_t bytes_written = 0;
+    };
+
+    flash_simulator(size_t size, const config& cfg = config())
+            : cfg_(cfg), memory_(size, 0xFF), wear_((size + cfg.page_size - 1) / cfg.page_size, 0)
+    {
+    }
+
+    ~flash_simulator()
+    {
+        if (active_slot() == this) {
+            active_slot() = nullptr;
+        }
+    }
+
+    uint8_t* data() { return memory_.data(); }
+    size_t size() const { return memory_.size(); }
+    const stats& get_stats() const { return stats_; }
+    void reset_stats() { stats_ = stats(); }
+
+    // Number of erases of the most worn page
+    uint32_t max_wear() const { return *std::max_element(wear_.begin(), wear_.end()); }
+    uint32_t wear(size_t page) const { return wear_[page]; }
+
+    void write(size_t offset, const uint8_t* source, size_t length)
+    {
+        stats_.writes++;
+        stats_.elapsed_us += cfg_.write_overhead_us;
+        stats_.bytes_written += length;
+
+        size_t end = offset + length;
+        for (size_t page = offset / cfg_.page_size; page * cfg_.page_size < end; page++) {
+            size_t page_start = page * cfg_.page_size;
+            size_t from = std::max(offset, page_start);
+            size_t to = std::min(end, page_start + cfg_.page_size);
+
+            bool needs_erase = false;
+            for (size_t i = from; i < to; i++) {
+                uint8_t value = source != nullptr ? source[i - offset] : 0;
+                needs_erase |= (memory_[i] & value) != value;
+            }
+            if (needs_erase) {
+                // The rest of the page survives the erase
+                std::vector<uint8_t> saved(memory_.begin() + page_start,
+                                           memory_.begin() + std::min(page_start + cfg_.page_size, memory_.size()));
+                erase_page(page);
+                for (size_t i = page_start; i < page_start + saved.size(); i++) {
+                    if (i < from || i >= to) {
+                        memory_[i] = saved[i - page_start];
+                    }
+                }
+            }
+            for (size_t i = from; i < to; i++) {
+                memory_[i] = source != nullptr ? source[i - offset] : 0;
+            }
+            stats_.pages_programmed++;
+            stats_.elapsed_us += cfg_.program_us;
+        }
+    }
+
+    // Erase whole pages covering the range
+    void erase(size_t offset, size_t length)
+    {
+        for (size_t page = offset / cfg_.page_size; page * cfg_.page_size < offset + length; page++) {
+            erase_page(page);
+        }
+    }
+
+    // Delegates only receive the buffer, so one simulator at a time is
+    // reachable through append()
+    void activate() { active_slot() = this; }
+
+    static flash_simulator* active() { return active_slot(); }
+
+    // append_buffer_delegate writing to the active simulator
+    static void append(buffer_state_t* buffer, uint8_t* source, int length)
+    {
+        flash_simulator* simulator = active_slot();
+        simulator->write(buffer->data + buffer->pos - simulator->data(), source, length);
+    }
+
+private:
+    static flash_simulator*& active_slot()
+    {
+        static flash_simulator* active = nullptr;
+        return active;
+    }
+
+    void erase_page(size_t page)
+    {
+        size_t page_start = page * cfg_.page_size;
+        size_t page_end = std::min(page_start + cfg_.page_size, memory_.size());
+        std::fill(memory_.begin() + page_start, memory_.begin() + page_end, 0xFF);
+        wear_[page]++;
+        stats_.pages_erased++;
+        stats_.elapsed_us += cfg_.erase_us;
+    }
+
+    config cfg_;
+    std::vector<uint8_t> memory_;
+    std::vector<uint32_t> wear_;
+    stats stats_;
+};
+
+#endif //CI_TEST_FLASH_SIMULATOR_H
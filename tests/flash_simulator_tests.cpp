@@ -0,0 +1,98 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "flash_simulator.h"
+
+namespace {
+
+    TEST(FlashSimulator, EraseOnlyWhenNeeded) {
+
+        flash_simulator::config cfg;
+        cfg.page_size = 64;
+        flash_simulator flash(256, cfg);
+
+        uint8_t data[32];
+        memset(data, 0x0F, sizeof(data));
+
+        // Fresh flash is erased, programming only clears bits
+        flash.write(0, data, sizeof(data));
+        EXPECT_EQ(flash.get_stats().pages_erased, 0u);
+        EXPECT_EQ(flash.get_stats().pages_programmed, 1u);
+
+        // Clearing more bits needs no erase either
+        memset(data, 0x0E, sizeof(data));
+        flash.write(0, data, sizeof(data));
+        EXPECT_EQ(flash.get_stats().pages_erased, 0u);
+
+        // Setting bits again does
+        memset(data, 0xF0, sizeof(data));
+        flash.write(0, data, sizeof(data));
+        EXPECT_EQ(flash.get_stats().pages_erased, 1u);
+        EXPECT_EQ(flash.wear(0), 1u);
+        EXPECT_EQ(0, memcmp(flash.data(), data, sizeof(data)));
+    }
+
+    TEST(FlashSimulator, PartialPageSurvivesErase) {
+
+        flash_simulator flash(128);
+
+        uint8_t first[100];
+        memset(first, 0x00, sizeof(first));
+        flash.write(0, first, sizeof(first));
+
+        uint8_t second[10];
+        memset(second, 0xAA, sizeof(second));
+        flash.write(70, second, sizeof(second));
+
+        EXPECT_EQ(flash.get_stats().pages_erased, 1u) << "Only the second page should be erased";
+        EXPECT_EQ(flash.data()[69], 0x00);
+        EXPECT_EQ(flash.data()[70], 0xAA);
+        EXPECT_EQ(flash.data()[80], 0x00);
+        EXPECT_EQ(flash.get_stats().pages_programmed, 3u) << "Writes spanning pages program each page";
+    }
+
+    TEST(FlashSimulator, BufferingDelegate) {
+
+        flash_simulator flash(1000);
+        flash.activate();
+
+        uint8_t ram_buffer[100];
+        buffering_t buffering;
+        buffering_instance_init(
+                &buffering,
+                ram_buffer,
+                sizeof(ram_buffer),
+                [](buffer_state_t* buffer, uint8_t* data, int size) {
+                    memcpy(buffer->data+buffer->pos, data, size);
+                },
+                flash.data(),
+                flash.size(),
+                &flash_simulator::append);
+
+        uint8_t chunk[60];
+        for (int i = 0; i < 5; i++) {
+            memset(chunk, 'a' + i, sizeof(chunk));
+            buffering_instance_append(&buffering, chunk, sizeof(chunk));
+        }
+
+        EXPECT_EQ(buffering_instance_get_buffer(&buffering)->pos, 300);
+        EXPECT_EQ(flash.data()[299], 'e');
+        // First chunk moves from RAM in one write, the other four are written per chunk
+        EXPECT_EQ(flash.get_stats().writes, 5u);
+        EXPECT_GT(flash.get_stats().elapsed_us, 0u);
+    }
+}
@@ -0,0 +1,110 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/json_parser.h"
+#include "lib/json_arena.h"
+#include <string>
+#include <jsmn.h>
+
+namespace {
+
+    std::string transaction_with_outputs(int outputs)
+    {
+        std::string msg = R"({"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[)";
+        for (int i = 0; i < outputs; i++) {
+            if (i > 0) {
+                msg += ",";
+            }
+            msg += R"({"address":"ADDR)" + std::to_string(i) + R"(","coins":[{"amount":)" + std::to_string(i) + R"(,"denom":"atom"}]})";
+        }
+        msg += "]}";
+        return R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":)"
+               + msg + R"(,"sequences":[1]})";
+    }
+
+    TEST(JsonArenaTest, NoTokenCeiling) {
+
+        auto transaction = transaction_with_outputs(2000);
+
+        json_arena_t arena;
+        json_arena_init(&arena);
+
+        parsed_json_t parsed_json;
+        int token_count = json_parse_arena(&parsed_json, &arena, transaction.c_str());
+
+        EXPECT_EQ(token_count, json_count_tokens(transaction.c_str())) << "Wrong number of tokens";
+        EXPECT_GT(token_count, 10000) << "Transaction should be far beyond MAX_NUMBER_OF_TOKENS";
+        EXPECT_EQ(json_get_token_count(&parsed_json), token_count) << "Wrong number of tokens";
+        EXPECT_GE(arena.capacity, (unsigned int) token_count) << "Arena is too small";
+
+        int msg_bytes = object_get_value(0, "msg_bytes", &parsed_json, transaction.c_str());
+        int outputs = object_get_value(msg_bytes, "outputs", &parsed_json, transaction.c_str());
+        EXPECT_EQ(array_get_element_count(outputs, &parsed_json), 2000) << "Wrong number of array elements";
+
+        int output = array_get_nth_element(outputs, 1999, &parsed_json);
+        int address = object_get_value(output, "address", &parsed_json, transaction.c_str());
+        const jsmntok_t* token = json_get_token(&parsed_json, address);
+        EXPECT_EQ(std::string(transaction.c_str() + token->start, token->end - token->start), "ADDR1999");
+
+        json_arena_free(&arena);
+    }
+
+    TEST(JsonArenaTest, SteadyStateDoesNotAllocate) {
+
+        auto big = transaction_with_outputs(100);
+        auto small = transaction_with_outputs(1);
+
+        json_arena_t arena;
+        json_arena_init(&arena);
+
+        parsed_json_t parsed_json;
+        json_parse_arena(&parsed_json, &arena, big.c_str());
+        unsigned int allocations = arena.allocations;
+        unsigned int capacity = arena.capacity;
+
+        for (int i = 0; i < 1000; i++) {
+            EXPECT_GT(json_parse_arena(&parsed_json, &arena, (i % 2 ? big : small).c_str()), 0);
+        }
+
+        EXPECT_EQ(arena.allocations, allocations) << "Arena should be reused";
+        EXPECT_EQ(arena.capacity, capacity) << "Arena should not shrink or grow";
+
+        json_arena_free(&arena);
+    }
+
+    TEST(JsonArenaTest, SameResultAsFixedArray) {
+
+        auto transaction = R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[{"address":"6F7574707574","coins":[{"amount":10,"denom":"atom"}]}]},"sequences":[1]})";
+
+        json_arena_t arena;
+        json_arena_init(&arena);
+
+        parsed_json_t arena_json;
+        parsed_json_t fixed_json;
+        json_parse_arena(&arena_json, &arena, transaction);
+        json_parse(&fixed_json, transaction);
+
+        EXPECT_EQ(arena_json.CorrectFormat, fixed_json.CorrectFormat);
+        ASSERT_EQ(json_get_token_count(&arena_json), json_get_token_count(&fixed_json));
+        for (int i = 0; i < json_get_token_count(&fixed_json); i++) {
+            EXPECT_EQ(json_get_token(&arena_json, i)->start, json_get_token(&fixed_json, i)->start);
+            EXPECT_EQ(json_get_token(&arena_json, i)->end, json_get_token(&fixed_json, i)->end);
+        }
+
+        json_arena_free(&arena);
+    }
+}
@@ -0,0 +1,127 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/json_parser.hpp"
+#include <string>
+#include <vector>
+
+namespace {
+
+    const char* sample_transaction =
+            R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[{"address":"6F7574707574","coins":[{"amount":10,"denom":"atom"}]}]},"sequences":[1,-2,18446744073709551615]})";
+
+    TEST(JsonParserCppTest, Members) {
+
+        json::document doc(sample_transaction);
+        ASSERT_TRUE(doc.ok());
+
+        std::vector<std::string> keys;
+        for (const json::member& m : doc.root().members()) {
+            keys.push_back(std::string(m.key.data(), m.key.size()));
+        }
+        std::vector<std::string> expected = {"alt_bytes", "chain_id", "fee_bytes", "msg_bytes", "sequences"};
+        EXPECT_EQ(keys, expected);
+        EXPECT_EQ(doc.root().size(), 5);
+    }
+
+    TEST(JsonParserCppTest, Elements) {
+
+        json::document doc(sample_transaction);
+
+        std::vector<std::string> sequences;
+        for (json::value v : doc.root()["sequences"].elements()) {
+            sequences.push_back(std::string(v.text().data(), v.text().size()));
+        }
+        std::vector<std::string> expected = {"1", "-2", "18446744073709551615"};
+        EXPECT_EQ(sequences, expected);
+
+        int count = 0;
+        for (json::value v : doc.root()["chain_id"].elements()) {
+            count += v.valid();
+        }
+        EXPECT_EQ(count, 0) << "Strings have no elements";
+    }
+
+    TEST(JsonParserCppTest, SameTokensAsC) {
+
+        json::document doc(sample_transaction);
+        const parsed_json_t* parsed = doc.parsed();
+
+        json::value outputs = doc.root().at_path("msg_bytes/outputs");
+        EXPECT_EQ(outputs.index(), object_get_value(
+                object_get_value(0, "msg_bytes", parsed, sample_transaction), "outputs", parsed, sample_transaction));
+
+        int n = 0;
+        for (const json::member& m : doc.root()["fee_bytes"].members()) {
+            EXPECT_EQ(m.value.index(), object_get_nth_value(doc.root()["fee_bytes"].index(), n++, parsed));
+        }
+        EXPECT_EQ(n, 2);
+
+        // Values point into the original text
+        EXPECT_EQ(doc.root()["chain_id"].text().data(), sample_transaction + 30);
+    }
+
+    TEST(JsonParserCppTest, TypedPath) {
+
+        json::document doc(sample_transaction);
+        json::value root = doc.root();
+
+        int64_t gas = 0;
+        EXPECT_TRUE(root.get("fee_bytes/gas", &gas));
+        EXPECT_EQ(gas, 10000);
+
+        std::string denom;
+        EXPECT_TRUE(root.get("fee_bytes/amount/0/denom", &denom));
+        EXPECT_EQ(denom, "photon");
+
+        json::string_view address;
+        EXPECT_TRUE(root.get("msg_bytes/outputs/0/address", &address));
+        EXPECT_TRUE(address == json::string_view("6F7574707574"));
+
+        int64_t negative = 0;
+        EXPECT_TRUE(root.get("sequences/1", &negative));
+        EXPECT_EQ(negative, -2);
+
+        uint64_t big = 0;
+        EXPECT_TRUE(root.get("sequences/2", &big));
+        EXPECT_EQ(big, UINT64_MAX);
+        EXPECT_FALSE(root.get("sequences/2", &negative)) << "Does not fit into int64_t";
+
+        EXPECT_FALSE(root.get("chain_id", &gas)) << "Wrong type";
+        EXPECT_FALSE(root.get("fee_bytes/missing", &gas)) << "Missing key";
+        EXPECT_FALSE(root.get("sequences/3", &gas)) << "Index out of range";
+        EXPECT_FALSE(root.get("sequences/x", &gas)) << "Not an index";
+        EXPECT_TRUE(root["alt_bytes"].is_null());
+        EXPECT_FALSE(root["missing"]["deeper"].valid());
+    }
+
+    TEST(JsonParserCppTest, Reparse) {
+
+        json::document doc;
+        EXPECT_FALSE(doc.ok());
+        EXPECT_FALSE(doc.root().valid());
+
+        EXPECT_LT(doc.parse(R"({"chain_id":)"), 0);
+        EXPECT_FALSE(doc.ok());
+
+        EXPECT_GT(doc.parse(sample_transaction), 0);
+        EXPECT_TRUE(doc.ok());
+        std::string chain_id;
+        EXPECT_TRUE(doc.root().get("chain_id", &chain_id));
+        EXPECT_EQ(chain_id, "test-chain-1");
+    }
+}
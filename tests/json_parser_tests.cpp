@@ -46,6 +46,22 @@ namespace {
         EXPECT_EQ(0, parserData.NumberOfTokens);
     }
 
+    TEST(JsonParserTest, TooManyTokens) {
+        std::string json = "[";
+        for (int i = 0; i < MAX_NUMBER_OF_TOKENS + 10; i++) {
+            json += i > 0 ? ",1" : "1";
+        }
+        json += "]";
+
+        parsed_json_t parserData = {0};
+        json_parse(&parserData, json.c_str());
+
+        // The jsmn error must not turn into a token count
+        EXPECT_EQ(MAX_NUMBER_OF_TOKENS, parserData.NumberOfTokens);
+        EXPECT_EQ(MAX_NUMBER_OF_TOKENS, json_get_token_count(&parserData));
+        EXPECT_EQ(-1, json_get_token(&parserData, MAX_NUMBER_OF_TOKENS)->start);
+    }
+
     TEST(JsonParserTest, SinglePrimitive) {
         parsed_json_t parserData = {0};
         json_parse(&parserData, "EMPTY");
@@ -135,4 +151,36 @@ namespace {
         EXPECT_TRUE(parserData.Tokens[8].type == jsmntype_t::JSMN_STRING);
         EXPECT_TRUE(parserData.Tokens[9].type == jsmntype_t::JSMN_PRIMITIVE);
     }
+    TEST(JsonParserTest, CountJobMatchesCount) {
+        auto transaction = R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[{"address":"6F7574707574","coins":[{"amount":10,"denom":"atom"}]}]},"sequences":[1], "memo":"a \"quoted\" string, that is long"})";
+        int expected = json_count_tokens(transaction);
+
+        for (unsigned int step = 1; step < strlen(transaction) + 2; step++) {
+            json_count_job_t job;
+            json_count_job_init(&job, strlen(transaction));
+
+            int result;
+            int steps = 0;
+            while ((result = json_count_job_step(&job, transaction, step)) == 1) {
+                steps++;
+            }
+            EXPECT_EQ(result, 0) << "Step size " << step;
+            EXPECT_EQ(job.count, expected) << "Step size " << step;
+            if (step < 16) {
+                EXPECT_GT(steps, 1) << "Work should have been split with step size " << step;
+            }
+        }
+    }
+
+    TEST(JsonParserTest, CountJobUnterminatedString) {
+        auto transaction = R"({"chain_id":"test-chain-1)";
+
+        json_count_job_t job;
+        json_count_job_init(&job, strlen(transaction));
+
+        int result;
+        while ((result = json_count_job_step(&job, transaction, 4)) == 1) {
+        }
+        EXPECT_EQ(result, -1);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/json_parser.h"
+#include "lib/json_arena.h"
+#include "lib/json_soa.h"
+#include <string>
+#include <jsmn.h>
+
+namespace {
+
+    std::string transaction_with_outputs(int outputs)
+    {
+        std::string msg = R"({"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[)";
+        for (int i = 0; i < outputs; i++) {
+            if (i > 0) {
+                msg += ",";
+            }
+            msg += R"({"address":"ADDR)" + std::to_string(i) + R"(","coins":[{"amount":)" + std::to_string(i) + R"(,"denom":"atom"}]})";
+        }
+        msg += "]}";
+        return R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":)"
+               + msg + R"(,"sequences":[1]})";
+    }
+
+    TEST(JsonSoaTest, FindNextStartAfter) {
+
+        auto transaction = transaction_with_outputs(10);
+
+        json_arena_t arena;
+        json_arena_init(&arena);
+        parsed_json_t parsed_json;
+        json_parse_arena(&parsed_json, &arena, transaction.c_str());
+
+        json_soa_t soa;
+        json_soa_init(&soa);
+        ASSERT_EQ(json_soa_load(&soa, &parsed_json), json_get_token_count(&parsed_json));
+
+        // Compare against a plain scan for every start index and a range of positions
+        for (unsigned int from = 0; from < soa.count; from += 3) {
+            for (int32_t position = -1; position <= (int32_t) transaction.size(); position += 17) {
+                unsigned int expected = from;
+                while (expected < soa.count && soa.start[expected] <= position) {
+                    expected++;
+                }
+                EXPECT_EQ(json_soa_find_next_start_after(&soa, from, position), expected)
+                                    << "from " << from << " position " << position;
+            }
+        }
+
+        json_soa_free(&soa);
+        json_arena_free(&arena);
+    }
+
+    TEST(JsonSoaTest, SameResultAsTokens) {
+
+        auto transaction = transaction_with_outputs(300);
+
+        json_arena_t arena;
+        json_arena_init(&arena);
+        parsed_json_t parsed_json;
+        json_parse_arena(&parsed_json, &arena, transaction.c_str());
+
+        json_soa_t soa;
+        json_soa_init(&soa);
+        json_soa_load(&soa, &parsed_json);
+
+        for (int i = 0; i < json_get_token_count(&parsed_json); i++) {
+            const jsmntok_t* token = json_get_token(&parsed_json, i);
+            if (token->type == JSMN_ARRAY) {
+                int count = array_get_element_count(i, &parsed_json);
+                EXPECT_EQ(json_soa_array_get_element_count(i, &soa), count) << "Wrong count of array " << i;
+                for (int n = 0; n <= count; n++) {
+                    EXPECT_EQ(json_soa_array_get_nth_element(i, n, &soa), array_get_nth_element(i, n, &parsed_json));
+                }
+            }
+            if (token->type == JSMN_OBJECT) {
+                int count = object_get_element_count(i, &parsed_json);
+                EXPECT_EQ(json_soa_object_get_element_count(i, &soa), count) << "Wrong count of object " << i;
+                for (int n = 0; n <= count; n++) {
+                    EXPECT_EQ(json_soa_object_get_nth_key(i, n, &soa), object_get_nth_key(i, n, &parsed_json));
+                    EXPECT_EQ(json_soa_object_get_nth_value(i, n, &soa), object_get_nth_value(i, n, &parsed_json));
+                }
+            }
+        }
+
+        json_soa_free(&soa);
+        json_arena_free(&arena);
+    }
+
+    TEST(JsonSoaTest, StorageIsReused) {
+
+        auto big = transaction_with_outputs(100);
+        auto small = transaction_with_outputs(1);
+
+        parsed_json_t big_json;
+        parsed_json_t small_json;
+        json_arena_t big_arena;
+        json_arena_t small_arena;
+        json_arena_init(&big_arena);
+        json_arena_init(&small_arena);
+        json_parse_arena(&big_json, &big_arena, big.c_str());
+        json_parse_arena(&small_json, &small_arena, small.c_str());
+
+        json_soa_t soa;
+        json_soa_init(&soa);
+        json_soa_load(&soa, &big_json);
+        unsigned int capacity = soa.capacity;
+        const int32_t* start = soa.start;
+
+        EXPECT_EQ(json_soa_load(&soa, &small_json), json_get_token_count(&small_json));
+        EXPECT_EQ(soa.capacity, capacity) << "Storage should not shrink";
+        EXPECT_EQ(soa.start, start) << "Storage should be reused";
+
+        json_soa_free(&soa);
+        json_arena_free(&big_arena);
+        json_arena_free(&small_arena);
+    }
+}
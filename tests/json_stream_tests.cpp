@@ -0,0 +1,498 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/json_parser.h"
+#include "lib/json_stream.h"
+#include <string>
+#include <jsmn.h>
+
+namespace {
+
+    const char* sample_transaction =
+            R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[{"address":"6F7574707574","coins":[{"amount":10,"denom":"atom"}]}]},"sequences":[1]})";
+
+    // Builds a send message with the given number of outputs
+    std::string big_transaction(int outputs)
+    {
+        std::string msg = R"({"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[)";
+        for (int i = 0; i < outputs; i++) {
+            if (i > 0) {
+                msg += ",";
+            }
+            msg += R"({"address":"ADDR)" + std::to_string(i) + R"(","coins":[{"amount":)" + std::to_string(i) + R"(,"denom":"atom"}]})";
+        }
+        msg += "]}";
+        return R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":)"
+               + msg + R"(,"sequences":[1]})";
+    }
+
+    // Indents a compact json document, two spaces per level
+    std::string pretty_print(const std::string& json)
+    {
+        std::string out;
+        int level = 0;
+        bool in_string = false;
+        for (size_t i = 0; i < json.size(); i++) {
+            char c = json[i];
+            if (in_string) {
+                out += c;
+                if (c == '\\') {
+                    out += json[++i];
+                }
+                else if (c == '"') {
+                    in_string = false;
+                }
+                continue;
+            }
+            switch (c) {
+                case '"':
+                    in_string = true;
+                    out += c;
+                    break;
+                case '{':
+                case '[':
+                    level++;
+                    out += c;
+                    out += "\n" + std::string(2 * level, ' ');
+                    break;
+                case '}':
+                case ']':
+                    level--;
+                    out += "\n" + std::string(2 * level, ' ');
+                    out += c;
+                    break;
+                case ',':
+                    out += ",\n" + std::string(2 * level, ' ');
+                    break;
+                case ':':
+                    out += ": ";
+                    break;
+                default:
+                    out += c;
+                    break;
+            }
+        }
+        return out;
+    }
+
+    void setup_context(
+            parsed_json_t* parsed_json,
+            int screen_size,
+            const char* transaction)
+    {
+        static unsigned short view_scrolling_total_size = 0;
+        static unsigned short view_scrolling_step = 0;
+        static unsigned short key_scrolling_total_size = 0;
+        static unsigned short key_scrolling_step = 0;
+
+        parsing_context_t context;
+        context.parsed_transaction = parsed_json;
+        context.max_chars_per_line = screen_size;
+        context.view_scrolling_total_size = &view_scrolling_total_size;
+        context.view_scrolling_step = &view_scrolling_step;
+        context.key_scrolling_total_size = &key_scrolling_total_size;
+        context.key_scrolling_step = &key_scrolling_step;
+        context.transaction = transaction;
+        set_parsing_context(context);
+        set_copy_delegate([](void* d, const void* s, unsigned int size) { memcpy(d, s, size);});
+    }
+
+    TEST(JsonStreamTest, TokensMatchJsmn) {
+
+        auto transaction = sample_transaction;
+
+        parsed_json_t parsed_json;
+        json_parse(&parsed_json, transaction);
+
+        uint16_t pos = 0;
+        jsmntok_t token;
+        int token_index = 0;
+        while (json_stream_next_token(transaction, strlen(transaction), &pos, &token) == 1) {
+            ASSERT_LT(token_index, parsed_json.NumberOfTokens) << "Too many tokens";
+            const jsmntok_t& expected = parsed_json.Tokens[token_index];
+            EXPECT_EQ(token.type, expected.type) << "Wrong type of token " << token_index;
+            EXPECT_EQ(token.start, expected.start) << "Wrong start of token " << token_index;
+            EXPECT_EQ(token.end, expected.end) << "Wrong end of token " << token_index;
+            EXPECT_EQ(token.size, expected.size) << "Wrong size of token " << token_index;
+            token_index++;
+        }
+        EXPECT_EQ(token_index, parsed_json.NumberOfTokens) << "Wrong number of tokens";
+    }
+
+    TEST(JsonStreamTest, FindValue) {
+
+        auto transaction = sample_transaction;
+
+        jsmntok_t value;
+        EXPECT_EQ(json_stream_find_value(transaction, strlen(transaction), "chain_id", &value), 1);
+        EXPECT_EQ(value.type, JSMN_STRING);
+        EXPECT_EQ(std::string(transaction + value.start, value.end - value.start), "test-chain-1");
+
+        EXPECT_EQ(json_stream_find_value(transaction, strlen(transaction), "sequences", &value), 1);
+        EXPECT_EQ(value.type, JSMN_ARRAY);
+        EXPECT_EQ(std::string(transaction + value.start, value.end - value.start), "[1]");
+
+        EXPECT_EQ(json_stream_find_value(transaction, strlen(transaction), "amount", &value), 0)
+                            << "Only top level keys should be matched";
+    }
+
+    TEST(JsonStreamTest, FindPath) {
+
+        auto transaction =
+                R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},)"
+                R"("msg_bytes":{"outputs":[{"address":"ADDR0","coins":[]},{"address":"ADDR1"}]},"sequences":[]})";
+        uint16_t length = strlen(transaction);
+
+        jsmntok_t value;
+        EXPECT_EQ(json_stream_find_path(transaction, length, "chain_id", &value), 1);
+        EXPECT_EQ(std::string(transaction + value.start, value.end - value.start), "test-chain-1");
+
+        EXPECT_EQ(json_stream_find_path(transaction, length, "fee_bytes/amount/denom", &value), 1);
+        EXPECT_EQ(value.type, JSMN_STRING);
+        EXPECT_EQ(std::string(transaction + value.start, value.end - value.start), "photon");
+
+        EXPECT_EQ(json_stream_find_path(transaction, length, "fee_bytes/gas", &value), 1);
+        EXPECT_EQ(value.type, JSMN_PRIMITIVE);
+        EXPECT_EQ(std::string(transaction + value.start, value.end - value.start), "10000");
+
+        EXPECT_EQ(json_stream_find_path(transaction, length, "msg_bytes/outputs/address", &value), 1)
+                            << "Arrays should be entered at their first element";
+        EXPECT_EQ(std::string(transaction + value.start, value.end - value.start), "ADDR0");
+
+        EXPECT_EQ(json_stream_find_path(transaction, length, "msg_bytes/outputs/coins/amount", &value), 0);
+        EXPECT_EQ(json_stream_find_path(transaction, length, "sequences/amount", &value), 0);
+        EXPECT_EQ(json_stream_find_path(transaction, length, "chain_id/amount", &value), 0);
+        EXPECT_EQ(json_stream_find_path(transaction, length, "msg_bytes/type", &value), 0);
+        EXPECT_EQ(json_stream_find_path(transaction, length, "fee", &value), 0)
+                            << "Keys should match in full";
+
+        auto truncated = R"({"msg_bytes":{"outputs":[{"address":"ADDR0")";
+        EXPECT_EQ(json_stream_find_path(truncated, strlen(truncated), "msg_bytes/outputs/address", &value), -1);
+    }
+
+    TEST(JsonStreamTest, Malformed) {
+
+        auto transaction = R"({"chain_id":"test-chain-1)";
+
+        jsmntok_t value;
+        EXPECT_EQ(json_stream_find_value(transaction, strlen(transaction), "chain_id", &value), -1);
+
+        stream_display_t display;
+        EXPECT_EQ(stream_display_init(&display, transaction, strlen(transaction)), -1);
+    }
+
+    TEST(JsonStreamTest, SamePagesAsTokens) {
+
+        auto transaction = sample_transaction;
+        parsed_json_t parsed_json;
+        json_parse(&parsed_json, transaction);
+
+        constexpr int screen_size = 100;
+        setup_context(&parsed_json, screen_size, transaction);
+
+        stream_display_t display;
+        int pages = stream_display_init(&display, transaction, strlen(transaction));
+        EXPECT_EQ(pages, transaction_get_display_pages()) << "Wrong number of displayable pages";
+
+        for (int page = 0; page < pages; page++) {
+            char key[screen_size];
+            char value[screen_size];
+            char stream_key[screen_size];
+            char stream_value[screen_size];
+            transaction_get_display_key_value(key, value, page);
+            stream_display_get_key_value(&display, stream_key, stream_value, page);
+
+            EXPECT_STREQ(stream_key, key) << "Wrong key on page " << page;
+            EXPECT_STREQ(stream_value, value) << "Wrong value on page " << page;
+        }
+    }
+
+    TEST(JsonStreamTest, OversizeTransaction) {
+
+        constexpr int outputs = 100;
+        auto transaction = big_transaction(outputs);
+
+        jsmn_parser parser;
+        jsmn_init(&parser);
+        EXPECT_GT(jsmn_parse(&parser, transaction.c_str(), transaction.size(), NULL, 0), MAX_NUMBER_OF_TOKENS)
+                            << "Transaction should not fit into parsed_json_t";
+
+        constexpr int screen_size = 100;
+        setup_context(nullptr, screen_size, transaction.c_str());
+
+        stream_display_t display;
+        int pages = stream_display_init(&display, transaction.c_str(), transaction.size());
+        // 3 fixed pages, 2 for the input, 2 per output and null alt_bytes
+        EXPECT_EQ(pages, 3 + 2 + 2 * outputs + 1) << "Wrong number of displayable pages";
+        EXPECT_EQ(display.msg_bytes.checkpoint_count <= JSON_STREAM_MAX_CHECKPOINTS, true);
+        EXPECT_GT(display.msg_bytes.checkpoint_interval, JSON_STREAM_CHECKPOINT_INTERVAL)
+                            << "Checkpoints should be spread over the whole value";
+
+        char key[screen_size];
+        char value[screen_size];
+
+        stream_display_get_key_value(&display, key, value, 3 + 2 + 2 * 57);
+        EXPECT_STREQ(key, "msg_bytes/outputs/address");
+        EXPECT_STREQ(value, "ADDR57");
+
+        stream_display_get_key_value(&display, key, value, 3 + 2 + 2 * 99 + 1);
+        EXPECT_STREQ(key, "msg_bytes/outputs/coins");
+        EXPECT_STREQ(value, R"([{"amount":99,"denom":"atom"}])");
+
+        stream_display_get_key_value(&display, key, value, pages - 1);
+        EXPECT_STREQ(key, "alt_bytes");
+        EXPECT_STREQ(value, "null");
+    }
+
+    TEST(JsonStreamTest, EveryItemReachable) {
+
+        auto transaction = big_transaction(40);
+
+        constexpr int screen_size = 100;
+        setup_context(nullptr, screen_size, transaction.c_str());
+
+        jsmntok_t msg_bytes;
+        ASSERT_EQ(json_stream_find_value(transaction.c_str(), transaction.size(), "msg_bytes", &msg_bytes), 1);
+
+        json_stream_t stream;
+        int count = json_stream_init(&stream, transaction.c_str(), &msg_bytes);
+        EXPECT_EQ(count, 2 + 2 * 40);
+
+        for (int i = 2; i < count; i += 2) {
+            char key[64];
+            jsmntok_t value;
+            ASSERT_EQ(json_stream_get_item(&stream, i, key, sizeof(key), &value), 1);
+            EXPECT_STREQ(key, "outputs/address");
+            EXPECT_EQ(std::string(transaction.c_str() + value.start, value.end - value.start),
+                      "ADDR" + std::to_string(i / 2 - 1));
+        }
+
+        char key[64];
+        jsmntok_t value;
+        EXPECT_EQ(json_stream_get_item(&stream, count, key, sizeof(key), &value), -1);
+    }
+
+    TEST(JsonStreamTest, CheckpointStrideBoundsLookup) {
+
+        for (int outputs : {1, 7, 31, 40, 200, 1000}) {
+            auto transaction = big_transaction(outputs);
+
+            jsmntok_t msg_bytes;
+            ASSERT_EQ(json_stream_find_value(transaction.c_str(), transaction.size(), "msg_bytes", &msg_bytes), 1);
+
+            json_stream_t stream;
+            int count = json_stream_init(&stream, transaction.c_str(), &msg_bytes);
+            ASSERT_EQ(count, 2 + 2 * outputs);
+
+            // Fixed stride from the count pass
+            int expected_interval = (count + JSON_STREAM_MAX_CHECKPOINTS - 1) / JSON_STREAM_MAX_CHECKPOINTS;
+            if (expected_interval < JSON_STREAM_CHECKPOINT_INTERVAL) {
+                expected_interval = JSON_STREAM_CHECKPOINT_INTERVAL;
+            }
+            EXPECT_EQ(stream.checkpoint_interval, expected_interval);
+            ASSERT_LE(stream.checkpoint_count, JSON_STREAM_MAX_CHECKPOINTS);
+            EXPECT_EQ(stream.checkpoint_count, (count + expected_interval - 1) / expected_interval);
+            for (int i = 0; i < stream.checkpoint_count; i++) {
+                EXPECT_EQ(stream.checkpoints[i].item_index, i * expected_interval);
+            }
+
+            // Every item is at most one stride away from its checkpoint
+            for (int i = 0; i < count; i++) {
+                int checkpoint = i / stream.checkpoint_interval;
+                ASSERT_LT(checkpoint, stream.checkpoint_count);
+                EXPECT_LT(i - stream.checkpoints[checkpoint].item_index, stream.checkpoint_interval);
+            }
+        }
+    }
+
+    TEST(JsonStreamTest, InitInSteps) {
+        auto transaction = big_transaction(60);
+
+        stream_display_t expected;
+        int pages = stream_display_init(&expected, transaction.c_str(), transaction.size());
+        ASSERT_GT(pages, 0);
+
+        for (uint16_t step : {1, 7, 50}) {
+            stream_display_t display;
+            stream_display_begin(&display, transaction.c_str(), transaction.size());
+            int result;
+            int steps = 0;
+            while ((result = stream_display_init_step(&display, step)) == 1) {
+                steps++;
+            }
+            ASSERT_EQ(result, 0) << "step " << step;
+            EXPECT_GE(steps, pages / step) << "Every step walks a bounded number of items";
+            EXPECT_EQ(stream_display_get_pages(&display), pages);
+
+            EXPECT_EQ(display.msg_bytes.checkpoint_count, expected.msg_bytes.checkpoint_count);
+            EXPECT_EQ(display.msg_bytes.checkpoint_interval, expected.msg_bytes.checkpoint_interval);
+            for (int i = 0; i < expected.msg_bytes.checkpoint_count; i++) {
+                EXPECT_EQ(display.msg_bytes.checkpoints[i].pos, expected.msg_bytes.checkpoints[i].pos);
+                EXPECT_EQ(display.msg_bytes.checkpoints[i].item_index, expected.msg_bytes.checkpoints[i].item_index);
+            }
+        }
+
+        // Missing fields are reported once the top level object has been scanned
+        stream_display_t display;
+        const char* missing = R"({"chain_id":"c","sequences":[1]})";
+        stream_display_begin(&display, missing, strlen(missing));
+        EXPECT_EQ(stream_display_init_step(&display, 10), -1);
+    }
+
+    TEST(JsonStreamTest, ScanIsBoundedInBytes) {
+        auto transaction = big_transaction(300);
+        ASSERT_GT(transaction.size(), 4u * JSON_STREAM_SCAN_STEP);
+
+        stream_display_t display;
+        stream_display_begin(&display, transaction.c_str(), transaction.size());
+        unsigned int scan_steps = 0;
+        while (display.scan.pos < transaction.size()) {
+            uint16_t before = display.scan.pos;
+            ASSERT_EQ(stream_display_init_step(&display, 1), 1);
+            EXPECT_LE(display.scan.pos - before, JSON_STREAM_SCAN_STEP);
+            scan_steps++;
+            if (display.scan.pos == before) {
+                break;
+            }
+        }
+        EXPECT_GE(scan_steps, transaction.size() / JSON_STREAM_SCAN_STEP);
+
+        int result;
+        while ((result = stream_display_init_step(&display, 50)) == 1) {
+        }
+        EXPECT_EQ(result, 0);
+
+        stream_display_t expected;
+        EXPECT_EQ(stream_display_get_pages(&display), stream_display_init(&expected, transaction.c_str(), transaction.size()));
+        EXPECT_EQ(expected.msg_bytes.item_count, 2 + 2 * 300);
+    }
+
+    TEST(JsonStreamTest, ScanRejectsMalformed) {
+        for (const char* transaction : {
+                R"({"chain_id":"c" "sequences":[1]})",
+                R"({"chain_id":"c","sequences":[1]]})",
+                R"({"chain_id":"c","sequences":[1})",
+                R"(["chain_id","c"])",
+                R"({"chain_id":"c","sequences":[1],"fee_bytes":{},"msg_bytes":{"a":1},"alt_bytes":null)"}) {
+            stream_display_t display;
+            EXPECT_EQ(stream_display_init(&display, transaction, strlen(transaction)), -1) << transaction;
+        }
+
+        // The first occurrence of a key is displayed
+        const char* duplicate = R"({"chain_id":"c","sequences":[1],"fee_bytes":{},"msg_bytes":{"a":1},)"
+                                R"("alt_bytes":null,"chain_id":"d"})";
+        stream_display_t display;
+        ASSERT_EQ(stream_display_init(&display, duplicate, strlen(duplicate)), 5);
+        EXPECT_EQ(std::string(duplicate + display.chain_id.start, display.chain_id.end - display.chain_id.start), "c");
+    }
+
+    TEST(JsonStreamTest, WalkRejectsUnclosedContainer) {
+        const char* json = R"({"a":[1,{"b":2}],"c":3})";
+        jsmntok_t value;
+        value.type = JSMN_OBJECT;
+        value.start = 0;
+        value.end = 12;     // ends inside the array
+
+        json_stream_t stream;
+        EXPECT_EQ(json_stream_init(&stream, json, &value), -1);
+    }
+
+    TEST(JsonStreamTest, FragmentsRenderAcrossCuts) {
+        std::string json = R"({"coins":[{"amount":"10","denom":"u\"atom"}],"memo":"a b"})";
+        const char* expected = "coins: amount: 10; denom: u\\\"atom; memo: a b";
+
+        // Whole document at once
+        char out[64];
+        uint8_t state = 0;
+        int length = json_fragment_render(json.c_str(), json.size(), &state, 0, out, sizeof(out));
+        EXPECT_STREQ(out, expected);
+        EXPECT_EQ(length, (int) strlen(expected));
+        EXPECT_EQ(state, 0);
+
+        // Every cut gives the same text when the state is carried over
+        for (size_t cut = 0; cut <= json.size(); cut++) {
+            char first[64];
+            char second[64];
+            state = 0;
+            json_fragment_render(json.c_str(), cut, &state, 0, first, sizeof(first));
+            json_fragment_render(json.c_str() + cut, json.size() - cut, &state, 0, second, sizeof(second));
+            EXPECT_EQ(std::string(first) + second, expected) << "cut at " << cut;
+        }
+
+        // Window into the rendered text
+        state = 0;
+        length = json_fragment_render(json.c_str(), json.size(), &state, 7, out, 7);
+        EXPECT_STREQ(out, "amount");
+        EXPECT_EQ(length, (int) strlen(expected));
+    }
+
+    TEST(JsonStreamTest, CompactAcrossCuts) {
+        std::string json = " {\n  \"memo\" : \"a \\\" b\",\r\n\t\"gas\": 10 ,\"ok\":[ true\n, null ]\n} ";
+        const char* expected = R"({"memo":"a \" b","gas":10,"ok":[true,null]})";
+
+        // Whole document at once
+        std::string whole = json;
+        uint8_t state = 0;
+        int length = json_fragment_compact(&whole[0], whole.size(), &state);
+        EXPECT_EQ(whole.substr(0, length), expected);
+        EXPECT_EQ(state & JSON_FRAGMENT_IN_STRING, 0);
+
+        // Every cut gives the same document when the state is carried over
+        for (size_t cut = 0; cut <= json.size(); cut++) {
+            std::string first = json.substr(0, cut);
+            std::string second = json.substr(cut);
+            state = 0;
+            int first_length = json_fragment_compact(&first[0], first.size(), &state);
+            int second_length = json_fragment_compact(&second[0], second.size(), &state);
+            EXPECT_EQ(first.substr(0, first_length) + second.substr(0, second_length), expected) << "cut at " << cut;
+        }
+    }
+
+    TEST(JsonStreamTest, CompactRejectsJoinedPrimitives) {
+        std::string json = "[1 2]";
+        uint8_t state = 0;
+        EXPECT_EQ(json_fragment_compact(&json[0], json.size(), &state), -1);
+
+        // Also when the whitespace ends a fragment
+        std::string first = "[true\n";
+        std::string second = "false]";
+        state = 0;
+        EXPECT_EQ(json_fragment_compact(&first[0], first.size(), &state), 5);
+        EXPECT_EQ(json_fragment_compact(&second[0], second.size(), &state), -1);
+    }
+
+    TEST(JsonStreamTest, CompactedPrettyTransactionFits) {
+        // Size of the device's transaction buffer, minus the terminating zero
+        constexpr size_t capacity = 16384 - 1;
+        constexpr int outputs = 200;
+        auto transaction = big_transaction(outputs);
+        auto pretty = pretty_print(transaction);
+        ASSERT_LT(transaction.size(), capacity);
+        ASSERT_GT(pretty.size(), capacity) << "Pretty printed transaction should not fit as uploaded";
+
+        // Compacted in chunks of an APDU payload
+        std::string compacted;
+        uint8_t state = 0;
+        for (size_t offset = 0; offset < pretty.size(); offset += 250) {
+            std::string chunk = pretty.substr(offset, 250);
+            int length = json_fragment_compact(&chunk[0], chunk.size(), &state);
+            ASSERT_GE(length, 0);
+            compacted += chunk.substr(0, length);
+        }
+        EXPECT_EQ(compacted, transaction);
+    }
+}
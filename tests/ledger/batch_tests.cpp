@@ -0,0 +1,160 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+extern "C" {
+#include "batch.h"
+}
+
+namespace {
+
+    class BatchTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+        }
+
+        void start()
+        {
+            std::vector<uint8_t> body = {0, 0};
+            std::vector<uint8_t> path = device_path(cosmos_path);
+            body.insert(body.end(), path.begin(), path.end());
+            ASSERT_EQ(device_exchange(INS_BATCH_START, body).sw, APDU_CODE_OK);
+        }
+
+        apdu_reply_t add(const std::string& transaction)
+        {
+            return device_upload(INS_BATCH_ADD, device_packets({}, transaction, 200));
+        }
+
+        // Sends INS_BATCH_SIGN and polls until the review is shown
+        apdu_reply_t sign()
+        {
+            apdu_reply_t reply = device_exchange(INS_BATCH_SIGN, {0, 0});
+            for (int polls = 0; reply.sw == APDU_CODE_BUSY && polls < 1000; polls++) {
+                reply = device_exchange(INS_PARSE_POLL, {0, 0});
+            }
+            return reply;
+        }
+
+        // Header text of a transaction, put together from its scrolling steps
+        std::string header(int page)
+        {
+            char key[64];
+            char value[64];
+            view_scrolling_step = 0;
+            batch_get_page(key, value, page);
+            std::string text = value;
+            for (int step = 1; step + MAX_CHARS_PER_LINE <= view_scrolling_total_size; step++) {
+                view_scrolling_step = step;
+                batch_get_page(key, value, page);
+                text += value[MAX_CHARS_PER_LINE - 1];
+            }
+            view_scrolling_step = 0;
+            return text;
+        }
+    };
+
+    TEST_F(BatchTest, ReviewAndSign) {
+        start();
+        EXPECT_EQ(add(device_transaction(1)).data, std::vector<uint8_t>({1}));
+        EXPECT_EQ(add(device_transaction(2, "other-chain")).data, std::vector<uint8_t>({2}));
+
+        ASSERT_EQ(sign().sw, 0);
+        // A header page per transaction followed by its pages
+        int first_pages = 3 + 2 + 2 * 1 + 1;
+        int second_pages = 3 + 2 + 2 * 2 + 1;
+        EXPECT_EQ(view_stub_page_count, 1 + first_pages + 1 + second_pages);
+
+        char key[64];
+        char value[64];
+        view_stub_get_page(0, key, value);
+        EXPECT_STREQ(key, "Transaction 1/2");
+        EXPECT_EQ(header(0), "test-chain-1 Send 1atom to cosmos1out0 fee 5photon");
+        view_stub_get_page(1 + first_pages, key, value);
+        EXPECT_STREQ(key, "Transaction 2/2");
+        EXPECT_EQ(header(1 + first_pages), "other-chain Send 1atom to cosmos1out0 fee 5photon");
+
+        view_stub_sign();
+        EXPECT_EQ(device_last_async_reply().sw, APDU_CODE_OK);
+
+        apdu_reply_t reply = device_exchange(INS_BATCH_GET_SIGNATURES, {0, 0});
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        ASSERT_FALSE(reply.data.empty());
+        EXPECT_EQ(reply.data[0], 2);
+    }
+
+    TEST_F(BatchTest, MovingBetweenTransactionsDoesNotWriteFlash) {
+        start();
+        ASSERT_EQ(add(device_transaction(20)).sw, APDU_CODE_OK);
+        ASSERT_EQ(add(device_transaction(30)).sw, APDU_CODE_OK);
+
+        sdk_stub_nvm_write_count = 0;
+        ASSERT_EQ(sign().sw, 0);
+        int first_pages = 3 + 2 + 2 * 20 + 1;
+        EXPECT_EQ(view_stub_page_count, 1 + first_pages + 1 + 3 + 2 + 2 * 30 + 1);
+
+        char key[64];
+        char value[64];
+        for (int round = 0; round < 3; round++) {
+            view_stub_get_page(1, key, value);
+            device_run_jobs();
+            view_stub_get_page(1, key, value);
+            EXPECT_STRNE(value, "Parsing...");
+
+            view_stub_get_page(1 + first_pages + 1, key, value);
+            EXPECT_STREQ(value, "Parsing...");
+            device_run_jobs();
+            view_stub_get_page(1 + first_pages + 1, key, value);
+            EXPECT_STRNE(value, "Parsing...");
+        }
+        EXPECT_EQ(sdk_stub_nvm_write_count, 0) << "Transactions of a batch are not spilled to flash";
+    }
+
+    TEST_F(BatchTest, CommandsOutOfOrderAreRefused) {
+        EXPECT_EQ(add(device_transaction(1)).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+        EXPECT_EQ(device_exchange(INS_BATCH_SIGN, {0, 0}).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+
+        start();
+        EXPECT_EQ(device_exchange(INS_BATCH_SIGN, {0, 0}).sw, APDU_CODE_COMMAND_NOT_ALLOWED)
+                            << "An empty batch cannot be signed";
+
+        std::string transaction = device_transaction(1);
+        auto packets = device_packets({}, transaction, 100);
+        ASSERT_GT(packets.size(), 1u);
+        std::vector<uint8_t> body = {1, (uint8_t) packets.size()};
+        body.insert(body.end(), packets[0].begin(), packets[0].end());
+        ASSERT_EQ(device_exchange(INS_BATCH_ADD, body).sw, APDU_CODE_OK);
+        EXPECT_EQ(device_exchange(INS_BATCH_SIGN, {0, 0}).sw, APDU_CODE_COMMAND_NOT_ALLOWED)
+                            << "A transaction is still open";
+        EXPECT_EQ(device_exchange(INS_BATCH_GET_SIGNATURES, {0, 0}).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    TEST_F(BatchTest, MalformedTransactionStopsTheBatch) {
+        start();
+        ASSERT_EQ(add(device_transaction(1)).sw, APDU_CODE_OK);
+        std::string malformed = device_transaction(1);
+        malformed.pop_back();
+        ASSERT_EQ(add(malformed).sw, APDU_CODE_OK);
+
+        EXPECT_EQ(sign().sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(view_stub_page_count, -1);
+        EXPECT_EQ(add(device_transaction(1)).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+}
@@ -0,0 +1,186 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+extern "C" {
+#include "bip32_cache.h"
+}
+
+namespace {
+
+    constexpr uint32_t hardened = 0x80000000;
+
+    struct node_t {
+        std::vector<uint8_t> key;
+        std::vector<uint8_t> chain;
+
+        bool operator==(const node_t& other) const
+        {
+            return key == other.key && chain == other.chain;
+        }
+    };
+
+    node_t os_node(const std::vector<uint32_t>& path)
+    {
+        uint8_t key[32];
+        uint8_t chain[32];
+        os_perso_derive_node_bip32(CX_CURVE_256K1, path.data(), path.size(), key, chain);
+        sdk_stub_reset();
+        return {std::vector<uint8_t>(key, key + 32), std::vector<uint8_t>(chain, chain + 32)};
+    }
+
+    node_t cached_node(const std::vector<uint32_t>& path)
+    {
+        uint8_t key[32];
+        uint8_t chain[32];
+        bip32_cache_derive_node(path.data(), path.size(), key, chain);
+        return {std::vector<uint8_t>(key, key + 32), std::vector<uint8_t>(chain, chain + 32)};
+    }
+
+    class Bip32CacheTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+        }
+    };
+
+    TEST_F(Bip32CacheTest, SameNodesAsTheOs) {
+        const std::vector<std::vector<uint32_t>> paths = {
+                cosmos_path,
+                {hardened | 44, hardened | 118, hardened, 0, 1},
+                {hardened | 44, hardened | 118, hardened, 1, 0},
+                {hardened | 44, hardened | 118, hardened | 5, 0, 0},
+                {hardened | 44, hardened | 118, hardened, 1, 2, 3},
+                {hardened | 44, 7, hardened | 1, 2},
+                {hardened | 44, hardened | 118, hardened},
+                {0, 1},
+        };
+        for (const auto& path : paths) {
+            node_t expected = os_node(path);
+            EXPECT_EQ(cached_node(path), expected) << "path of depth " << path.size();
+        }
+        // Again in reverse order, now continuing from the cached node
+        for (auto path = paths.rbegin(); path != paths.rend(); path++) {
+            node_t expected = os_node(*path);
+            EXPECT_EQ(cached_node(*path), expected) << "path of depth " << path->size();
+        }
+    }
+
+    TEST_F(Bip32CacheTest, SiblingsCostNoOsDerivation) {
+        cached_node(cosmos_path);
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+
+        for (uint32_t index = 1; index < 5; index++) {
+            std::vector<uint32_t> sibling = cosmos_path;
+            sibling.back() = index;
+            node_t expected = os_node(sibling);
+            EXPECT_EQ(cached_node(sibling), expected);
+            EXPECT_EQ(sdk_stub_derive_count, 0);
+            EXPECT_EQ(sdk_stub_keypair_count, 0) << "The parent public key is kept";
+        }
+    }
+
+    TEST_F(Bip32CacheTest, OtherAccountGoesThroughTheOs) {
+        cached_node(cosmos_path);
+
+        std::vector<uint32_t> other = cosmos_path;
+        other[2] = hardened | 1;
+        node_t expected = os_node(other);
+        EXPECT_EQ(cached_node(other), expected);
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+    }
+
+    TEST_F(Bip32CacheTest, HardenedOnlyPathsGoThroughTheOs) {
+        const std::vector<uint32_t> account = {hardened | 44, hardened | 118, hardened};
+        cached_node(account);
+        cached_node(account);
+        EXPECT_EQ(sdk_stub_derive_count, 2);
+    }
+
+    TEST_F(Bip32CacheTest, PrepareStepDerivesOneLevelPerCall) {
+        std::vector<uint32_t> path = {hardened | 44, hardened | 118, hardened, 1, 2, 3};
+
+        EXPECT_TRUE(bip32_cache_prepare_step(path.data(), path.size()));
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+        EXPECT_EQ(sdk_stub_keypair_count, 1);
+        EXPECT_TRUE(bip32_cache_prepare_step(path.data(), path.size()));
+        EXPECT_TRUE(bip32_cache_prepare_step(path.data(), path.size()));
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+        EXPECT_EQ(sdk_stub_keypair_count, 3);
+        EXPECT_FALSE(bip32_cache_prepare_step(path.data(), path.size()));
+
+        node_t expected = os_node(path);
+        EXPECT_EQ(cached_node(path), expected);
+        EXPECT_EQ(sdk_stub_derive_count, 0);
+        EXPECT_EQ(sdk_stub_keypair_count, 0);
+
+        // Nothing to prepare without a non-hardened suffix
+        const std::vector<uint32_t> account = {hardened | 44, hardened | 118, hardened};
+        EXPECT_FALSE(bip32_cache_prepare_step(account.data(), account.size()));
+    }
+
+    TEST_F(Bip32CacheTest, ClearForgetsTheNode) {
+        cached_node(cosmos_path);
+        bip32_cache_clear();
+        sdk_stub_reset();
+
+        cached_node(cosmos_path);
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+    }
+
+    TEST_F(Bip32CacheTest, SigningKeysMatchTheOs) {
+        std::vector<uint32_t> sibling = cosmos_path;
+        sibling.back() = 9;
+        cached_node(cosmos_path);
+
+        uint8_t key[32];
+        bip32_cache_derive(sibling.data(), sibling.size(), key);
+        EXPECT_EQ(std::vector<uint8_t>(key, key + 32), os_node(sibling).key);
+    }
+
+    apdu_reply_t get_xpub(const std::vector<uint32_t>& path)
+    {
+        // The path starts at P1
+        return device_exchange(INS_GET_XPUB_SECP256K1, device_path(path));
+    }
+
+    TEST_F(Bip32CacheTest, XpubOfAccountPath) {
+        const std::vector<uint32_t> account = {hardened | 44, hardened | 118, hardened | 2};
+        node_t expected = os_node(account);
+
+        apdu_reply_t reply = get_xpub(account);
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        ASSERT_EQ(reply.data.size(), 33u + 32u);
+        EXPECT_EQ(std::vector<uint8_t>(reply.data.begin() + 33, reply.data.end()), expected.chain);
+
+        uint8_t publicKey[33];
+        uint8_t chain[32];
+        ASSERT_TRUE(bip32_cache_get_xpub(account.data(), account.size(), publicKey, chain));
+        EXPECT_EQ(std::vector<uint8_t>(publicKey, publicKey + 33), std::vector<uint8_t>(reply.data.begin(), reply.data.begin() + 33));
+    }
+
+    TEST_F(Bip32CacheTest, XpubOnlyForAccountPaths) {
+        EXPECT_EQ(get_xpub({hardened | 44, hardened | 118}).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(get_xpub({hardened | 44}).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(get_xpub({hardened | 44, hardened | 118, hardened, hardened}).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(get_xpub({hardened | 44, hardened | 118, 0}).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(get_xpub(cosmos_path).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(sdk_stub_derive_count, 0);
+    }
+}
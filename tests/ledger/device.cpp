@@ -0,0 +1,160 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "device.h"
+
+#include <cstring>
+
+extern "C" {
+#include "restream.h"
+#include "batch.h"
+#include "policy_store.h"
+#include "pubkey_cache.h"
+#include "bip32_cache.h"
+#include "validator.h"
+
+extern bool reply_pending;
+extern bool review_pending;
+extern uint8_t sign_path_count;
+extern uint8_t response_format;
+}
+
+const std::vector<uint32_t> cosmos_path = {0x80000000 | 44, 0x80000000 | 118, 0x80000000, 0, 0};
+
+void device_reset()
+{
+    restream_stop();
+    batch_stop();
+    policy_store_cancel();
+    validator_stop();
+    clear_key_caches();
+    transaction_initialize();
+    transaction_reset();
+    // Clear the slot left behind by the previous test
+    device_run_jobs();
+    reply_pending = false;
+    review_pending = false;
+    sign_path_count = 0;
+    response_format = 0;
+
+    view_add_reject_transaction_event_handler(&reject_transaction);
+    view_add_sign_transaction_event_handler(&sign_transaction);
+    view_add_exit_app_event_handler(&clear_key_caches);
+    view_idle(0);
+    sdk_stub_reset();
+}
+
+apdu_reply_t device_exchange(
+        uint8_t ins,
+        const std::vector<uint8_t>& body)
+{
+    G_io_apdu_buffer[OFFSET_CLA] = CLA;
+    G_io_apdu_buffer[OFFSET_INS] = ins;
+    memcpy(G_io_apdu_buffer + OFFSET_PCK_INDEX, body.data(), body.size());
+
+    volatile uint32_t flags = 0;
+    volatile uint32_t tx = 0;
+    // A command that waited for the user has been answered before the next one arrives
+    reply_pending = false;
+    handleApdu(&flags, &tx, OFFSET_PCK_INDEX + body.size());
+
+    apdu_reply_t reply;
+    if (flags & IO_ASYNCH_REPLY) {
+        reply.sw = 0;
+        return reply;
+    }
+    reply.sw = (G_io_apdu_buffer[tx - 2] << 8) | G_io_apdu_buffer[tx - 1];
+    reply.data.assign(G_io_apdu_buffer, G_io_apdu_buffer + tx - 2);
+    if (transaction_has_pending_commit()) {
+        transaction_commit();
+    }
+    return reply;
+}
+
+apdu_reply_t device_upload(
+        uint8_t ins,
+        const std::vector<std::vector<uint8_t>>& packets)
+{
+    apdu_reply_t reply;
+    for (size_t i = 0; i < packets.size(); i++) {
+        std::vector<uint8_t> body = {(uint8_t) (i + 1), (uint8_t) packets.size()};
+        body.insert(body.end(), packets[i].begin(), packets[i].end());
+        reply = device_exchange(ins, body);
+        if (reply.sw != APDU_CODE_OK) {
+            break;
+        }
+    }
+    return reply;
+}
+
+apdu_reply_t device_last_async_reply()
+{
+    apdu_reply_t reply;
+    uint16_t length = sdk_stub_last_reply.length;
+    reply.sw = (sdk_stub_last_reply.data[length - 2] << 8) | sdk_stub_last_reply.data[length - 1];
+    reply.data.assign(sdk_stub_last_reply.data, sdk_stub_last_reply.data + length - 2);
+    return reply;
+}
+
+void device_run_jobs(int slices)
+{
+    for (int i = 0; i < slices; i++) {
+        scheduler_run();
+    }
+}
+
+std::vector<uint8_t> device_path(const std::vector<uint32_t>& path)
+{
+    std::vector<uint8_t> bytes;
+    bytes.push_back(path.size());
+    for (uint32_t level : path) {
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(&level);
+        bytes.insert(bytes.end(), raw, raw + sizeof(level));
+    }
+    return bytes;
+}
+
+std::vector<std::vector<uint8_t>> device_packets(
+        const std::vector<uint32_t>& path,
+        const std::string& payload,
+        size_t chunk_size)
+{
+    std::vector<std::vector<uint8_t>> packets;
+    if (!path.empty()) {
+        packets.push_back(device_path(path));
+    }
+    for (size_t offset = 0; offset < payload.size(); offset += chunk_size) {
+        std::string chunk = payload.substr(offset, chunk_size);
+        packets.emplace_back(chunk.begin(), chunk.end());
+    }
+    return packets;
+}
+
+std::string device_transaction(int outputs, const std::string& chain_id)
+{
+    std::string msg = R"({"inputs":[{"address":"cosmos1in","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[)";
+    for (int i = 0; i < outputs; i++) {
+        if (i > 0) {
+            msg += ",";
+        }
+        msg += R"({"address":"cosmos1out)" + std::to_string(i) + R"(","coins":[{"amount":)" + std::to_string(i + 1)
+               + R"(,"denom":"atom"}]})";
+    }
+    msg += "]}";
+    return R"({"alt_bytes":null,"chain_id":")" + chain_id
+           + R"(","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":)"
+           + msg + R"(,"sequences":[1]})";
+}
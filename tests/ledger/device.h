@@ -0,0 +1,77 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Drives the app the way app_main does, on top of the stubbed SDK (see sdk/)
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "sdk/sdk_stub.h"
+#include "sdk/view_stub.h"
+#include "app_main.h"
+#include "transaction.h"
+#include "scheduler.h"
+
+void handleApdu(volatile uint32_t* flags, volatile uint32_t* tx, uint32_t rx);
+void sign_transaction();
+void reject_transaction();
+void clear_key_caches();
+}
+
+struct apdu_reply_t {
+    uint16_t sw;                    // 0 if the reply waits for the user
+    std::vector<uint8_t> data;
+};
+
+// Restores the state of a freshly started app
+void device_reset();
+
+// Sends a command, body follows the instruction byte (P1, P2 and the data).
+// Staged transaction data is committed afterwards, as app_main does once the
+// reply has been sent.
+apdu_reply_t device_exchange(
+        uint8_t ins,
+        const std::vector<uint8_t>& body);
+
+// Sends every packet of a chunked upload (P1 = index from 1, P2 = count)
+// and returns the reply to the last one, or the first error
+apdu_reply_t device_upload(
+        uint8_t ins,
+        const std::vector<std::vector<uint8_t>>& packets);
+
+// Status word and data of the reply the user's decision sent
+apdu_reply_t device_last_async_reply();
+
+// Runs scheduler slices, as ticker events do
+void device_run_jobs(int slices = 1000);
+
+// Packets of a v1 upload: the bip32 path first (if any), then chunks of the payload
+std::vector<std::vector<uint8_t>> device_packets(
+        const std::vector<uint32_t>& path,
+        const std::string& payload,
+        size_t chunk_size = 250);
+
+// Bytes of a bip32 path as the commands expect it: depth, then the native (little endian) levels
+std::vector<uint8_t> device_path(const std::vector<uint32_t>& path);
+
+// Transaction in the displayed format with a send message of the given number of outputs
+std::string device_transaction(int outputs, const std::string& chain_id = "test-chain-1");
+
+// Default Cosmos path m/44'/118'/0'/0/0
+extern const std::vector<uint32_t> cosmos_path;
@@ -0,0 +1,107 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+extern "C" {
+#include "policy.h"
+#include "policy_store.h"
+}
+
+namespace {
+
+    class PolicyStoreTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+            turn_off();
+        }
+
+        void TearDown() override
+        {
+            turn_off();
+        }
+
+        // Uploads the policy and approves it
+        void store(const uint8_t* policy, int length)
+        {
+            std::string payload((const char*) policy, length);
+            ASSERT_EQ(device_upload(INS_SET_POLICY, device_packets({}, payload)).sw, 0);
+            view_stub_sign();
+            ASSERT_EQ(device_last_async_reply().sw, APDU_CODE_OK);
+        }
+
+        void turn_off()
+        {
+            uint8_t policy[POLICY_MAX_SIZE];
+            store(policy, policy_init(policy, sizeof(policy), POLICY_CURVE_SECP256K1, nullptr, 0));
+        }
+
+        // Sends to cosmos1out0 from the key of cosmos_path
+        void store_recipient_policy()
+        {
+            uint8_t policy[POLICY_MAX_SIZE];
+            int length = policy_init(policy, sizeof(policy), POLICY_CURVE_SECP256K1, cosmos_path.data(),
+                                     cosmos_path.size());
+            length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_RECIPIENT, "cosmos1out0", 0);
+            ASSERT_GT(length, 0);
+            store(policy, length);
+        }
+    };
+
+    TEST_F(PolicyStoreTest, KeyOfTheApduIsAutoSigned) {
+        store_recipient_policy();
+
+        // The path bytes of the policy and of the APDU are read the same way
+        apdu_reply_t reply = device_upload(INS_SIGN_SECP256K1, device_packets(cosmos_path, device_transaction(1)));
+        EXPECT_EQ(reply.sw, 0) << "The signature is sent while signing";
+        EXPECT_EQ(view_stub_page_count, -1) << "No review";
+        reply = device_last_async_reply();
+        EXPECT_EQ(reply.sw, APDU_CODE_OK);
+        EXPECT_FALSE(reply.data.empty());
+    }
+
+    TEST_F(PolicyStoreTest, OtherKeyIsReviewed) {
+        store_recipient_policy();
+
+        std::vector<uint32_t> path = cosmos_path;
+        path.back() = 1;
+        apdu_reply_t reply = device_upload(INS_SIGN_SECP256K1, device_packets(path, device_transaction(1)));
+        EXPECT_EQ(reply.sw, 0);
+        EXPECT_GT(view_stub_page_count, 0);
+    }
+
+    TEST_F(PolicyStoreTest, OtherJsonThanTheParsedOneThrows) {
+        store_recipient_policy();
+        std::vector<uint32_t> path = cosmos_path;
+        path.back() = 1;
+        ASSERT_EQ(device_upload(INS_SIGN_SECP256K1, device_packets(path, device_transaction(1))).sw, 0);
+        ASSERT_NE(transaction_get_parsed(), nullptr);
+
+        // The same json at another address
+        std::string copy = transaction_get_selected();
+        exception_t thrown = sdk_stub_call([](void* json) {
+            policy_store_allows(transaction_get_parsed(), (const char*) json, POLICY_CURVE_SECP256K1,
+                                cosmos_path.data(), cosmos_path.size());
+        }, (void*) copy.c_str());
+        EXPECT_EQ(thrown, APDU_CODE_EXECUTION_ERROR);
+
+        EXPECT_TRUE(policy_store_allows(transaction_get_parsed(), transaction_get_selected(), POLICY_CURVE_SECP256K1,
+                                        cosmos_path.data(), cosmos_path.size()));
+    }
+}
@@ -0,0 +1,173 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+extern "C" {
+#include "pubkey_cache.h"
+#include "signature.h"
+}
+
+namespace {
+
+    std::vector<uint32_t> account_path(uint32_t index)
+    {
+        return {0x80000000 | 44, 0x80000000 | 118, 0x80000000, 0, index};
+    }
+
+    // Compressed key derived by the OS alone
+    std::vector<uint8_t> expected_key(cx_curve_t curve, const std::vector<uint32_t>& path)
+    {
+        uint8_t privateKeyData[32];
+        os_perso_derive_node_bip32(curve, path.data(), path.size(), privateKeyData, NULL);
+        cx_ecfp_public_key_t publicKey;
+        cx_ecfp_private_key_t privateKey;
+        uint8_t compressed[PUBKEY_CACHE_KEY_SIZE] = {0};
+        if (curve == CX_CURVE_256K1) {
+            keys_secp256k1(&publicKey, &privateKey, privateKeyData);
+            keys_compress_secp256k1(&publicKey, compressed);
+        }
+        else {
+            keys_ed25519(&publicKey, &privateKey, privateKeyData);
+            keys_compress_ed25519(&publicKey, compressed);
+        }
+        sdk_stub_reset();
+        return std::vector<uint8_t>(compressed, compressed + PUBKEY_CACHE_KEY_SIZE);
+    }
+
+    std::vector<uint8_t> get(cx_curve_t curve, const std::vector<uint32_t>& path)
+    {
+        uint8_t publicKey[PUBKEY_CACHE_KEY_SIZE];
+        pubkey_cache_get(curve, path.data(), path.size(), publicKey);
+        return std::vector<uint8_t>(publicKey, publicKey + PUBKEY_CACHE_KEY_SIZE);
+    }
+
+    class PubkeyCacheTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+        }
+    };
+
+    TEST_F(PubkeyCacheTest, HitCostsNoDerivation) {
+        std::vector<uint8_t> expected = expected_key(CX_CURVE_256K1, cosmos_path);
+
+        EXPECT_EQ(get(CX_CURVE_256K1, cosmos_path), expected);
+        EXPECT_GT(sdk_stub_keypair_count, 0);
+
+        sdk_stub_reset();
+        EXPECT_EQ(get(CX_CURVE_256K1, cosmos_path), expected);
+        EXPECT_EQ(sdk_stub_derive_count, 0);
+        EXPECT_EQ(sdk_stub_keypair_count, 0);
+    }
+
+    TEST_F(PubkeyCacheTest, CurvesAreKeptApart) {
+        std::vector<uint8_t> secp256k1 = expected_key(CX_CURVE_256K1, cosmos_path);
+        std::vector<uint8_t> ed25519 = expected_key(CX_CURVE_Ed25519, cosmos_path);
+
+        EXPECT_EQ(get(CX_CURVE_256K1, cosmos_path), secp256k1);
+        sdk_stub_reset();
+        EXPECT_EQ(get(CX_CURVE_Ed25519, cosmos_path), ed25519);
+        EXPECT_EQ(sdk_stub_derive_count, 1) << "The secp256k1 entry does not answer for ed25519";
+
+        sdk_stub_reset();
+        get(CX_CURVE_256K1, cosmos_path);
+        get(CX_CURVE_Ed25519, cosmos_path);
+        EXPECT_EQ(sdk_stub_keypair_count, 0);
+    }
+
+    TEST_F(PubkeyCacheTest, LeastRecentlyUsedIsReplaced) {
+        for (uint32_t i = 0; i < PUBKEY_CACHE_SIZE; i++) {
+            get(CX_CURVE_256K1, account_path(i));
+        }
+        get(CX_CURVE_256K1, account_path(0));
+        get(CX_CURVE_256K1, account_path(PUBKEY_CACHE_SIZE));
+
+        // Path 1 was the oldest, path 0 was used again
+        sdk_stub_reset();
+        get(CX_CURVE_256K1, account_path(0));
+        EXPECT_EQ(sdk_stub_keypair_count, 0);
+        std::vector<uint8_t> expected = expected_key(CX_CURVE_256K1, account_path(1));
+        EXPECT_EQ(get(CX_CURVE_256K1, account_path(1)), expected);
+        EXPECT_GT(sdk_stub_keypair_count, 0);
+
+        sdk_stub_reset();
+        get(CX_CURVE_256K1, account_path(1));
+        EXPECT_EQ(sdk_stub_keypair_count, 0) << "Path 1 is cached again";
+    }
+
+    TEST_F(PubkeyCacheTest, PathsAreComparedWithTheirDepth) {
+        std::vector<uint32_t> parent(cosmos_path.begin(), cosmos_path.end() - 1);
+        get(CX_CURVE_256K1, cosmos_path);
+
+        std::vector<uint8_t> expected = expected_key(CX_CURVE_256K1, parent);
+        EXPECT_EQ(get(CX_CURVE_256K1, parent), expected);
+        EXPECT_GT(sdk_stub_keypair_count, 0);
+    }
+
+    TEST_F(PubkeyCacheTest, DeepPathsAreNotCached) {
+        std::vector<uint32_t> deep(11, 0x80000000);
+        std::vector<uint8_t> expected = expected_key(CX_CURVE_256K1, deep);
+
+        EXPECT_EQ(get(CX_CURVE_256K1, deep), expected);
+        sdk_stub_reset();
+        EXPECT_EQ(get(CX_CURVE_256K1, deep), expected);
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+    }
+
+    TEST_F(PubkeyCacheTest, ClearForgetsKeys) {
+        get(CX_CURVE_256K1, cosmos_path);
+        pubkey_cache_clear();
+
+        sdk_stub_reset();
+        get(CX_CURVE_256K1, cosmos_path);
+        EXPECT_GT(sdk_stub_keypair_count, 0);
+    }
+
+    TEST_F(PubkeyCacheTest, WarmJobPreparesTheDefaultKey) {
+        int slices = 1;
+        while (pubkey_cache_warm()) {
+            ASSERT_LT(++slices, 10);
+        }
+        // Hardened node, one non-hardened level and the key
+        EXPECT_EQ(slices, 3);
+
+        sdk_stub_reset();
+        // The path starts at P1
+        apdu_reply_t reply = device_exchange(INS_PUBLIC_KEY_SECP256K1, device_path(cosmos_path));
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        EXPECT_EQ(reply.data.size(), 65u);
+        EXPECT_EQ(sdk_stub_derive_count, 0);
+
+        // Every slice derives at most one level
+        clear_key_caches();
+        sdk_stub_reset();
+        pubkey_cache_warm();
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+        EXPECT_EQ(sdk_stub_keypair_count, 1);
+    }
+
+    TEST_F(PubkeyCacheTest, ExitClearsKeys) {
+        get(CX_CURVE_256K1, cosmos_path);
+        clear_key_caches();
+
+        sdk_stub_reset();
+        get(CX_CURVE_256K1, cosmos_path);
+        EXPECT_EQ(sdk_stub_derive_count, 1);
+    }
+}
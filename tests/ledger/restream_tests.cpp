@@ -0,0 +1,215 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+extern "C" {
+#include "restream.h"
+#include "signature.h"
+}
+
+namespace {
+
+    const std::string restream_transaction =
+            R"({"account_number":"1","chain_id":"test-chain-1","fee":{"amount":[{"amount":"5","denom":"photon"}],"gas":"10000"},)"
+            R"("memo":"restreamed","msgs":[{"inputs":[{"address":"cosmos1in","coins":[{"amount":"10","denom":"atom"}]}],)"
+            R"("outputs":[{"address":"cosmos1out","coins":[{"amount":"10","denom":"atom"}]}]}],"sequence":"2"})";
+
+    const std::vector<uint32_t> other_path = {0x80000000 | 44, 0x80000000 | 118, 0x80000000 | 1, 0, 7};
+
+    constexpr size_t chunk_size = 100;
+
+    class RestreamTest : public ::testing::Test {
+    protected:
+        std::vector<std::vector<uint8_t>> packets;
+
+        void SetUp() override
+        {
+            device_reset();
+            packets = device_packets(cosmos_path, restream_transaction, chunk_size);
+        }
+
+        // First pass, the review starts on page 0
+        void start_review()
+        {
+            apdu_reply_t reply = device_upload(INS_SIGN_SECP256K1_RESTREAM, packets);
+            ASSERT_EQ(reply.sw, APDU_CODE_OK);
+            ASSERT_EQ(reply.data, std::vector<uint8_t>{RESTREAM_NO_CHUNK});
+            ASSERT_EQ(view_stub_page_count, (int) packets.size() - 1);
+            char key[64];
+            char value[64];
+            view_stub_get_page(0, key, value);
+        }
+
+        apdu_reply_t send_chunk(uint8_t index, const std::vector<uint8_t>& data)
+        {
+            std::vector<uint8_t> body = {0, 0, index};
+            body.insert(body.end(), data.begin(), data.end());
+            return device_exchange(INS_RESTREAM_CHUNK, body);
+        }
+
+        apdu_reply_t poll()
+        {
+            return device_exchange(INS_RESTREAM_CHUNK, {0, 0});
+        }
+
+        std::vector<uint8_t> expected_signature(const std::vector<uint32_t>& path)
+        {
+            cx_ecfp_private_key_t privateKey;
+            keys_derive(CX_CURVE_256K1, path.data(), path.size(), NULL, &privateKey);
+            uint8_t signature[80];
+            unsigned int length = 0;
+            sign_secp256k1_digest(restream_get_digest(), signature, sizeof(signature), &length, &privateKey, NULL);
+            return std::vector<uint8_t>(signature, signature + length);
+        }
+    };
+
+    TEST_F(RestreamTest, ChunksAreRequestedAndVerified) {
+        start_review();
+
+        char key[64];
+        char value[64];
+        view_stub_get_page(0, key, value);
+        EXPECT_STREQ(key, "Chunk 1/4");
+        EXPECT_STREQ(value, "Loading...");
+
+        // The displayed page asks for its chunk once
+        apdu_reply_t reply = poll();
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        EXPECT_EQ(reply.data, std::vector<uint8_t>{0});
+        EXPECT_EQ(poll().data, std::vector<uint8_t>{RESTREAM_NO_CHUNK});
+
+        // Data that does not match the first pass is refused
+        std::vector<uint8_t> tampered = packets[1];
+        tampered[10] ^= 1;
+        EXPECT_EQ(send_chunk(0, tampered).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(send_chunk(1, packets[1]).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(send_chunk(9, packets[1]).sw, APDU_CODE_DATA_INVALID);
+
+        reply = send_chunk(0, packets[1]);
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        EXPECT_EQ(reply.data, std::vector<uint8_t>{RESTREAM_NO_CHUNK});
+        EXPECT_EQ(view_stub_redisplay_count, 1);
+
+        view_stub_get_page(0, key, value);
+        EXPECT_STREQ(value, "account_number: 1; c");
+
+        // Moving on requests the next chunk
+        view_stub_get_page(2, key, value);
+        EXPECT_EQ(poll().data, std::vector<uint8_t>{2});
+    }
+
+    TEST_F(RestreamTest, OtherCommandsAreRefusedUntilDecided) {
+        start_review();
+
+        EXPECT_EQ(device_upload(INS_SIGN_SECP256K1, device_packets(cosmos_path, "{}")).sw,
+                  APDU_CODE_COMMAND_NOT_ALLOWED);
+        std::vector<uint8_t> body = device_path(other_path);
+        EXPECT_EQ(device_exchange(INS_PUBLIC_KEY_SECP256K1, body).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+        EXPECT_EQ(device_upload(INS_SIGN_SECP256K1_RESTREAM, packets).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+        EXPECT_EQ(device_exchange(INS_UPLOAD_STATUS, {0, 0}).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+
+        apdu_reply_t version = device_exchange(INS_GET_VERSION, {0, 0});
+        EXPECT_EQ(version.sw, APDU_CODE_OK);
+
+        // The review is still the same
+        EXPECT_TRUE(restream_is_active());
+        EXPECT_EQ(restream_get_decision(), RESTREAM_UNDECIDED);
+        EXPECT_EQ(poll().data, std::vector<uint8_t>{0});
+
+        // Once the user rejected, the host may start over
+        view_stub_reject();
+        EXPECT_EQ(device_exchange(INS_PUBLIC_KEY_SECP256K1, body).sw, APDU_CODE_OK);
+    }
+
+    TEST_F(RestreamTest, ApprovalIsSentWithTheNextCommand) {
+        start_review();
+
+        view_stub_sign();
+        EXPECT_EQ(sdk_stub_reply_count, 0) << "The host did not ask for a reply";
+        EXPECT_EQ(restream_get_decision(), RESTREAM_APPROVED);
+
+        apdu_reply_t reply = poll();
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        EXPECT_EQ(reply.data, expected_signature(cosmos_path));
+        EXPECT_FALSE(restream_is_active());
+        EXPECT_EQ(poll().sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+
+    TEST_F(RestreamTest, RejectionIsSentWithTheNextCommand) {
+        start_review();
+
+        view_stub_reject();
+        EXPECT_EQ(sdk_stub_reply_count, 0) << "The host did not ask for a reply";
+        EXPECT_EQ(restream_get_decision(), RESTREAM_REJECTED);
+
+        EXPECT_EQ(poll().sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+        EXPECT_FALSE(restream_is_active());
+    }
+
+    TEST_F(RestreamTest, SignsWithThePathOfTheFirstPacket) {
+        // Commands between the packets of the first pass change the current path
+        for (size_t i = 0; i < packets.size(); i++) {
+            std::vector<uint8_t> body = {(uint8_t) (i + 1), (uint8_t) packets.size()};
+            body.insert(body.end(), packets[i].begin(), packets[i].end());
+            ASSERT_EQ(device_exchange(INS_SIGN_SECP256K1_RESTREAM, body).sw, APDU_CODE_OK);
+            if (i + 1 < packets.size()) {
+                ASSERT_EQ(device_exchange(INS_PUBLIC_KEY_SECP256K1, device_path(other_path)).sw, APDU_CODE_OK);
+            }
+        }
+        ASSERT_TRUE(restream_is_active());
+
+        view_stub_sign();
+        apdu_reply_t reply = poll();
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        EXPECT_EQ(reply.data, expected_signature(cosmos_path));
+        EXPECT_NE(reply.data, expected_signature(other_path));
+    }
+
+    TEST_F(RestreamTest, ResentPacketsOfTheFirstPassAreNotHashedTwice) {
+        apdu_reply_t reply;
+        for (size_t i = 0; i < packets.size(); i++) {
+            std::vector<uint8_t> body = {(uint8_t) (i + 1), (uint8_t) packets.size()};
+            body.insert(body.end(), packets[i].begin(), packets[i].end());
+            ASSERT_EQ(device_exchange(INS_SIGN_SECP256K1_RESTREAM, body).sw, APDU_CODE_OK);
+            if (i == 2) {
+                // The host did not get the reply and sends the packet again
+                ASSERT_EQ(device_exchange(INS_SIGN_SECP256K1_RESTREAM, body).sw, APDU_CODE_OK);
+            }
+        }
+        EXPECT_EQ(restream_get_page_count(), (int) packets.size() - 1);
+
+        // Skipping a packet is refused
+        device_reset();
+        std::vector<uint8_t> first = {1, 4};
+        first.insert(first.end(), packets[0].begin(), packets[0].end());
+        ASSERT_EQ(device_exchange(INS_SIGN_SECP256K1_RESTREAM, first).sw, APDU_CODE_OK);
+        std::vector<uint8_t> third = {3, 4};
+        third.insert(third.end(), packets[2].begin(), packets[2].end());
+        EXPECT_EQ(device_exchange(INS_SIGN_SECP256K1_RESTREAM, third).sw, APDU_CODE_DATA_INVALID);
+    }
+
+    TEST_F(RestreamTest, UserDecisionWithoutWaitingCommandSendsNothing) {
+        // A transaction was uploaded, but no command waits for its review
+        ASSERT_EQ(device_upload(INS_HASH_TEST, device_packets({}, restream_transaction)).sw, APDU_CODE_OK);
+
+        view_stub_sign();
+        view_stub_reject();
+        EXPECT_EQ(sdk_stub_reply_count, 0);
+        EXPECT_EQ(sdk_stub_derive_count, 0) << "Nothing should have been signed";
+    }
+}
@@ -0,0 +1,66 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+namespace {
+
+    class ReviewTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+        }
+    };
+
+    TEST_F(ReviewTest, SmallTransactionIsShownRightAway) {
+        std::string transaction = device_transaction(2);
+        apdu_reply_t reply = device_upload(INS_SIGN_SECP256K1, device_packets(cosmos_path, transaction));
+        EXPECT_EQ(reply.sw, 0) << "No APDU_CODE_BUSY for a small transaction";
+        // 3 fixed pages, 2 for the input, 2 per output and null alt_bytes
+        EXPECT_EQ(view_stub_page_count, 3 + 2 + 2 * 2 + 1);
+
+        view_stub_sign();
+        EXPECT_EQ(device_last_async_reply().sw, APDU_CODE_OK);
+    }
+
+    TEST_F(ReviewTest, LargeTransactionIsPolled) {
+        std::string transaction = device_transaction(200);
+        ASSERT_LT(transaction.size(), transaction_get_capacity());
+
+        apdu_reply_t reply = device_upload(INS_SIGN_SECP256K1, device_packets(cosmos_path, transaction));
+        ASSERT_EQ(reply.sw, APDU_CODE_BUSY);
+        EXPECT_EQ(view_stub_page_count, -1);
+
+        int polls = 0;
+        while ((reply = device_exchange(INS_PARSE_POLL, {0, 0})).sw == APDU_CODE_BUSY) {
+            ASSERT_LT(++polls, 1000);
+        }
+        EXPECT_EQ(reply.sw, 0);
+        EXPECT_GT(polls, 0);
+        EXPECT_EQ(view_stub_page_count, 3 + 2 + 2 * 200 + 1);
+    }
+
+    TEST_F(ReviewTest, MalformedTransactionIsRefused) {
+        std::string transaction = device_transaction(2);
+        transaction.pop_back();
+        apdu_reply_t reply = device_upload(INS_SIGN_SECP256K1, device_packets(cosmos_path, transaction));
+        EXPECT_EQ(reply.sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(view_stub_page_count, -1);
+        EXPECT_EQ(device_exchange(INS_PARSE_POLL, {0, 0}).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+    }
+}
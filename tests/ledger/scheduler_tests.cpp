@@ -0,0 +1,151 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+#include <string>
+
+extern "C" {
+extern scheduler_job scheduler_jobs[SCHEDULER_MAX_JOBS];
+extern uint8_t scheduler_next;
+}
+
+namespace {
+
+    std::string trace;
+    int slices_left[SCHEDULER_MAX_JOBS + 1];
+
+    template<int id>
+    bool job()
+    {
+        trace += std::to_string(id);
+        return --slices_left[id] > 0;
+    }
+
+    // Removes itself and adds itself again while it runs
+    bool restart_job()
+    {
+        trace += "r";
+        scheduler_remove(&restart_job);
+        scheduler_add(&restart_job);
+        return false;
+    }
+
+    int scheduled()
+    {
+        int count = 0;
+        for (auto job : scheduler_jobs) {
+            count += job != nullptr;
+        }
+        return count;
+    }
+
+    class SchedulerTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+            ASSERT_EQ(scheduled(), 0) << "Jobs of the app finish on their own";
+            trace.clear();
+            scheduler_next = 0;
+        }
+
+        void TearDown() override
+        {
+            for (auto& job : scheduler_jobs) {
+                job = nullptr;
+            }
+        }
+    };
+
+    TEST_F(SchedulerTest, JobsRunRoundRobinUntilDone) {
+        slices_left[0] = 3;
+        slices_left[1] = 1;
+        slices_left[2] = 2;
+        scheduler_add(&job<0>);
+        scheduler_add(&job<1>);
+        scheduler_add(&job<2>);
+
+        device_run_jobs(10);
+        EXPECT_EQ(trace, "012020");
+        EXPECT_EQ(scheduled(), 0);
+    }
+
+    TEST_F(SchedulerTest, AddingTwiceKeepsOneSlot) {
+        slices_left[0] = 2;
+        scheduler_add(&job<0>);
+        scheduler_add(&job<0>);
+        EXPECT_EQ(scheduled(), 1);
+
+        device_run_jobs(10);
+        EXPECT_EQ(trace, "00");
+    }
+
+    TEST_F(SchedulerTest, RemovedJobDoesNotRun) {
+        slices_left[0] = 5;
+        slices_left[1] = 5;
+        scheduler_add(&job<0>);
+        scheduler_add(&job<1>);
+        device_run_jobs(1);
+        scheduler_remove(&job<0>);
+
+        device_run_jobs(2);
+        EXPECT_EQ(trace, "011");
+        scheduler_remove(&job<1>);
+        EXPECT_EQ(scheduled(), 0);
+        device_run_jobs(1);
+        EXPECT_EQ(trace, "011");
+    }
+
+    TEST_F(SchedulerTest, JobAddedAgainWhileRunningStays) {
+        scheduler_add(&restart_job);
+        device_run_jobs(1);
+        EXPECT_EQ(trace, "r");
+        EXPECT_EQ(scheduled(), 1);
+        device_run_jobs(1);
+        EXPECT_EQ(trace, "rr");
+        scheduler_remove(&restart_job);
+    }
+
+    TEST_F(SchedulerTest, EveryJobOfTheAppHasASlot) {
+        for (int i = 0; i < SCHEDULER_APP_JOBS; i++) {
+            slices_left[i] = 1;
+        }
+        scheduler_add(&job<0>);
+        scheduler_add(&job<1>);
+        scheduler_add(&job<2>);
+        scheduler_add(&job<3>);
+        EXPECT_EQ(scheduled(), SCHEDULER_APP_JOBS);
+
+        device_run_jobs(SCHEDULER_APP_JOBS);
+        EXPECT_EQ(trace, "0123");
+    }
+
+    TEST_F(SchedulerTest, ParseJobProgressesOnTicks) {
+        std::string transaction = device_transaction(200);
+        ASSERT_EQ(device_upload(INS_SIGN_SECP256K1, device_packets(cosmos_path, transaction)).sw, APDU_CODE_BUSY);
+        EXPECT_TRUE(transaction_parse_is_running());
+
+        device_run_jobs();
+        EXPECT_FALSE(transaction_parse_is_running());
+        EXPECT_EQ(scheduled(), 0);
+
+        // The poll finds the finished job and shows the transaction
+        EXPECT_EQ(device_exchange(INS_PARSE_POLL, {0, 0}).sw, 0);
+        EXPECT_EQ(view_stub_page_count, 3 + 2 + 2 * 200 + 1);
+    }
+}
@@ -0,0 +1,116 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Host replacement of the SDK crypto. The primitives are deterministic but not
+// secure: hashes are a 64 bit mix, keys are derived from hashes of the private key.
+// Modular addition and comparison are exact, so bip32 derivation can be checked.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CX_CURVE_NONE,
+    CX_CURVE_256K1,
+    CX_CURVE_Ed25519
+} cx_curve_t;
+
+#define CX_LAST             (1 << 0)
+#define CX_RND_RFC6979      (3 << 9)
+#define CX_SHA256           3
+#define CX_SHA512           5
+
+#define CX_SHA256_SIZE      32
+#define CX_SHA512_SIZE      64
+#define CX_RIPEMD160_SIZE   20
+
+typedef struct {
+    cx_curve_t curve;
+    unsigned int d_len;
+    unsigned char d[32];
+} cx_ecfp_private_key_t;
+
+typedef struct {
+    cx_curve_t curve;
+    unsigned int W_len;
+    unsigned char W[65];
+} cx_ecfp_public_key_t;
+
+typedef struct {
+    uint64_t state;
+} cx_hash_t;
+
+typedef struct {
+    cx_hash_t header;
+} cx_sha256_t;
+
+typedef struct {
+    cx_hash_t header;
+} cx_sha512_t;
+
+typedef struct {
+    cx_hash_t header;
+} cx_ripemd160_t;
+
+int cx_sha256_init(cx_sha256_t* hash);
+int cx_sha512_init(cx_sha512_t* hash);
+int cx_ripemd160_init(cx_ripemd160_t* hash);
+int cx_hash(cx_hash_t* hash, int mode, const unsigned char* in, unsigned int length,
+            unsigned char* out, unsigned int out_length);
+int cx_hash_sha256(const unsigned char* in, unsigned int length, unsigned char* out, unsigned int out_length);
+int cx_hash_sha512(const unsigned char* in, unsigned int length, unsigned char* out, unsigned int out_length);
+int cx_hmac_sha512(const unsigned char* key, unsigned int key_length,
+                   const unsigned char* in, unsigned int length,
+                   unsigned char* out, unsigned int out_length);
+
+int cx_ecfp_init_private_key(cx_curve_t curve, const unsigned char* raw, unsigned int length,
+                             cx_ecfp_private_key_t* key);
+int cx_ecfp_init_public_key(cx_curve_t curve, const unsigned char* raw, unsigned int length,
+                            cx_ecfp_public_key_t* key);
+int cx_ecfp_generate_pair(cx_curve_t curve, cx_ecfp_public_key_t* public_key,
+                          cx_ecfp_private_key_t* private_key, int keep_private);
+
+int cx_ecdsa_sign(const cx_ecfp_private_key_t* key, int mode, int hash_id,
+                  const unsigned char* hash, unsigned int hash_length,
+                  unsigned char* signature, unsigned int signature_length, unsigned int* info);
+int cx_ecdsa_verify(const cx_ecfp_public_key_t* key, int mode, int hash_id,
+                    const unsigned char* hash, unsigned int hash_length,
+                    const unsigned char* signature, unsigned int signature_length);
+int cx_eddsa_sign(const cx_ecfp_private_key_t* key, int mode, int hash_id,
+                  const unsigned char* hash, unsigned int hash_length,
+                  const unsigned char* context, unsigned int context_length,
+                  unsigned char* signature, unsigned int signature_length, unsigned int* info);
+int cx_eddsa_verify(const cx_ecfp_public_key_t* key, int mode, int hash_id,
+                    const unsigned char* hash, unsigned int hash_length,
+                    const unsigned char* context, unsigned int context_length,
+                    const unsigned char* signature, unsigned int signature_length);
+
+int cx_math_cmp(const unsigned char* a, const unsigned char* b, unsigned int length);
+int cx_math_is_zero(const unsigned char* a, unsigned int length);
+int cx_math_sub(unsigned char* r, const unsigned char* a, const unsigned char* b, unsigned int length);
+int cx_math_addm(unsigned char* r, const unsigned char* a, const unsigned char* b,
+                 const unsigned char* m, unsigned int length);
+int cx_math_multm(unsigned char* r, const unsigned char* a, const unsigned char* b,
+                  const unsigned char* m, unsigned int length);
+int cx_math_powm(unsigned char* r, const unsigned char* a, const unsigned char* e, unsigned int e_length,
+                 const unsigned char* m, unsigned int length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,134 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Host replacement of the parts of the Ledger SDK the app uses.
+// Exceptions follow the SDK: TRY sets a jump point, THROW jumps to the innermost one.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>      // snprintf, the SDK declares it in os.h
+#include <setjmp.h>
+#include "cx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIC(x) (x)
+
+#define IO_APDU_BUFFER_SIZE 260
+extern unsigned char G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+
+#ifndef LEDGER_MAJOR_VERSION
+#define LEDGER_MAJOR_VERSION 0
+#define LEDGER_MINOR_VERSION 0
+#define LEDGER_PATCH_VERSION 0
+#endif
+
+#ifndef UNUSED
+#define UNUSED(x) (void)x
+#endif
+
+void os_memmove(void* dst, const void* src, unsigned int length);
+void os_memset(void* dst, unsigned char value, unsigned int length);
+int os_memcmp(const void* a, const void* b, unsigned int length);
+
+// src == NULL clears the destination
+void nvm_write(void* dst, void* src, unsigned int length);
+
+void os_perso_derive_node_bip32(
+        cx_curve_t curve,
+        const uint32_t* path,
+        unsigned int path_length,
+        unsigned char* private_key,
+        unsigned char* chain);
+
+void os_sched_exit(unsigned int exit_code);
+void os_boot(void);
+void reset(void);
+
+//---------------------------------------------
+// Exceptions
+
+typedef unsigned short exception_t;
+
+typedef struct try_context_s {
+    jmp_buf jmp_buf;
+    struct try_context_s* previous;
+    exception_t ex;
+} try_context_t;
+
+extern try_context_t* G_try_last_open_context;
+
+void os_longjmp(exception_t exception) __attribute__((noreturn));
+
+#define THROW(x) os_longjmp(x)
+
+#define BEGIN_TRY                                               \
+    {                                                           \
+        try_context_t __try;
+#define TRY                                                     \
+        __try.previous = G_try_last_open_context;               \
+        __try.ex = setjmp(__try.jmp_buf);                       \
+        if (__try.ex == 0) {                                    \
+            G_try_last_open_context = &__try;
+#define CATCH(x)                                                \
+            goto __FINALLY;                                     \
+        }                                                       \
+        else if (__try.ex == (x)) {                             \
+            __try.ex = 0;                                       \
+            G_try_last_open_context = __try.previous;
+#define CATCH_OTHER(e)                                          \
+            goto __FINALLY;                                     \
+        }                                                       \
+        else {                                                  \
+            exception_t e;                                      \
+            e = __try.ex;                                       \
+            __try.ex = 0;                                       \
+            G_try_last_open_context = __try.previous;
+#define FINALLY                                                 \
+            goto __FINALLY;                                     \
+        }                                                       \
+        __FINALLY:                                              \
+        G_try_last_open_context = __try.previous;
+#define END_TRY                                                 \
+        if (__try.ex != 0) {                                    \
+            THROW(__try.ex);                                    \
+        }                                                       \
+    }
+
+#define EXCEPTION_IO_RESET  0x10
+#define INVALID_PARAMETER   2
+
+//---------------------------------------------
+// IO
+
+#define CHANNEL_APDU                0
+#define CHANNEL_KEYBOARD            1
+#define CHANNEL_SPI                 2
+#define IO_RESET_AFTER_REPLIED      0x80
+#define IO_RECEIVE_DATA             0x40
+#define IO_RETURN_AFTER_TX          0x20
+#define IO_ASYNCH_REPLY             0x10
+#define IO_FLAGS                    0xF0
+
+unsigned short io_exchange(unsigned char channel, unsigned short tx_len);
+
+#ifdef __cplusplus
+}
+#endif
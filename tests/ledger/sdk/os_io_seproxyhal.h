@@ -0,0 +1,49 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+#include "os.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IO_SEPROXYHAL_BUFFER_SIZE_B             128
+
+#define SEPROXYHAL_TAG_FINGER_EVENT             0x0C
+#define SEPROXYHAL_TAG_BUTTON_PUSH_EVENT        0x05
+#define SEPROXYHAL_TAG_DISPLAY_PROCESSED_EVENT  0x0D
+#define SEPROXYHAL_TAG_TICKER_EVENT             0x0E
+
+#define UX_FINGER_EVENT(buffer)
+#define UX_BUTTON_PUSH_EVENT(buffer)
+#define UX_DISPLAYED()                          1
+#define UX_DISPLAYED_EVENT()
+#define UX_TICKER_EVENT(buffer, callback)       do callback while (0)
+#define UX_ALLOWED                              1
+#define UX_REDISPLAY()
+#define UX_DEFAULT_EVENT()
+
+int io_seproxyhal_spi_is_status_sent(void);
+void io_seproxyhal_general_status(void);
+void io_seproxyhal_spi_send(const unsigned char* buffer, unsigned short length);
+unsigned short io_seproxyhal_spi_recv(unsigned char* buffer, unsigned short max_length, unsigned int flags);
+void io_seproxyhal_init(void);
+void USB_power(unsigned char enabled);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,452 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "sdk_stub.h"
+#include "apdu_codes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+unsigned char G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+try_context_t* G_try_last_open_context = NULL;
+
+int sdk_stub_reply_count = 0;
+sdk_stub_reply_t sdk_stub_last_reply;
+int sdk_stub_derive_count = 0;
+int sdk_stub_keypair_count = 0;
+int sdk_stub_nvm_write_count = 0;
+unsigned int sdk_stub_nvm_write_bytes = 0;
+
+void sdk_stub_reset()
+{
+    sdk_stub_reply_count = 0;
+    memset(&sdk_stub_last_reply, 0, sizeof(sdk_stub_last_reply));
+    sdk_stub_derive_count = 0;
+    sdk_stub_keypair_count = 0;
+    sdk_stub_nvm_write_count = 0;
+    sdk_stub_nvm_write_bytes = 0;
+}
+
+exception_t sdk_stub_call(void (*function)(void*), void* argument)
+{
+    volatile exception_t thrown = 0;
+    BEGIN_TRY
+    {
+        TRY
+        {
+            function(argument);
+        }
+        CATCH_OTHER(e)
+        {
+            thrown = e;
+        }
+        FINALLY
+        {
+        }
+    }
+    END_TRY;
+    return thrown;
+}
+
+void os_longjmp(exception_t exception)
+{
+    if (G_try_last_open_context == NULL) {
+        fprintf(stderr, "exception 0x%04X thrown outside of a TRY block\n", exception);
+        abort();
+    }
+    longjmp(G_try_last_open_context->jmp_buf, exception);
+}
+
+// set_code is a C99 inline function, its external definition is emitted here
+extern void set_code(uint8_t* buffer, uint8_t offset, uint16_t value);
+
+//---------------------------------------------
+// OS
+
+void os_memmove(void* dst, const void* src, unsigned int length)
+{
+    memmove(dst, src, length);
+}
+
+void os_memset(void* dst, unsigned char value, unsigned int length)
+{
+    memset(dst, value, length);
+}
+
+int os_memcmp(const void* a, const void* b, unsigned int length)
+{
+    return memcmp(a, b, length);
+}
+
+void nvm_write(void* dst, void* src, unsigned int length)
+{
+    sdk_stub_nvm_write_count++;
+    sdk_stub_nvm_write_bytes += length;
+    if (src == NULL) {
+        memset(dst, 0, length);
+        return;
+    }
+    memmove(dst, src, length);
+}
+
+void os_sched_exit(unsigned int exit_code)
+{
+    exit((int) exit_code);
+}
+
+void os_boot(void)
+{
+}
+
+void reset(void)
+{
+}
+
+unsigned short io_exchange(unsigned char channel, unsigned short tx_len)
+{
+    if (channel & IO_RETURN_AFTER_TX) {
+        sdk_stub_reply_count++;
+        sdk_stub_last_reply.length = tx_len;
+        memcpy(sdk_stub_last_reply.data, G_io_apdu_buffer, tx_len);
+    }
+    return 0;
+}
+
+int io_seproxyhal_spi_is_status_sent(void)
+{
+    return 1;
+}
+
+void io_seproxyhal_general_status(void)
+{
+}
+
+void io_seproxyhal_spi_send(const unsigned char* buffer, unsigned short length)
+{
+}
+
+unsigned short io_seproxyhal_spi_recv(unsigned char* buffer, unsigned short max_length, unsigned int flags)
+{
+    return 0;
+}
+
+void io_seproxyhal_init(void)
+{
+}
+
+void USB_power(unsigned char enabled)
+{
+}
+
+//---------------------------------------------
+// Hashes
+
+static void stub_absorb(uint64_t* state, const unsigned char* in, unsigned int length)
+{
+    for (unsigned int i = 0; i < length; i++) {
+        *state ^= in[i];
+        *state *= 0x100000001B3ULL;
+    }
+}
+
+// splitmix64 stream seeded with the state
+static void stub_squeeze(uint64_t state, unsigned char* out, unsigned int out_length)
+{
+    for (unsigned int i = 0; i < out_length; i++) {
+        if (i % 8 == 0) {
+            state += 0x9E3779B97F4A7C15ULL;
+        }
+        uint64_t z = state + i / 8;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        out[i] = (unsigned char) (z >> (8 * (i % 8)));
+    }
+}
+
+static void stub_digest(uint64_t seed, const unsigned char* in, unsigned int length,
+                        unsigned char* out, unsigned int out_length)
+{
+    uint64_t state = 0xCBF29CE484222325ULL ^ seed;
+    stub_absorb(&state, in, length);
+    stub_squeeze(state, out, out_length);
+}
+
+int cx_sha256_init(cx_sha256_t* hash)
+{
+    hash->header.state = 0xCBF29CE484222325ULL ^ CX_SHA256;
+    return CX_SHA256;
+}
+
+int cx_sha512_init(cx_sha512_t* hash)
+{
+    hash->header.state = 0xCBF29CE484222325ULL ^ CX_SHA512;
+    return CX_SHA512;
+}
+
+int cx_ripemd160_init(cx_ripemd160_t* hash)
+{
+    hash->header.state = 0xCBF29CE484222325ULL;
+    return 0;
+}
+
+int cx_hash(cx_hash_t* hash, int mode, const unsigned char* in, unsigned int length,
+            unsigned char* out, unsigned int out_length)
+{
+    stub_absorb(&hash->state, in, length);
+    if (mode & CX_LAST) {
+        stub_squeeze(hash->state, out, out_length);
+        return out_length;
+    }
+    return 0;
+}
+
+int cx_hash_sha256(const unsigned char* in, unsigned int length, unsigned char* out, unsigned int out_length)
+{
+    stub_digest(CX_SHA256, in, length, out, CX_SHA256_SIZE);
+    return CX_SHA256_SIZE;
+}
+
+int cx_hash_sha512(const unsigned char* in, unsigned int length, unsigned char* out, unsigned int out_length)
+{
+    stub_digest(CX_SHA512, in, length, out, CX_SHA512_SIZE);
+    return CX_SHA512_SIZE;
+}
+
+int cx_hmac_sha512(const unsigned char* key, unsigned int key_length,
+                   const unsigned char* in, unsigned int length,
+                   unsigned char* out, unsigned int out_length)
+{
+    uint64_t state = 0xCBF29CE484222325ULL;
+    stub_absorb(&state, key, key_length);
+    stub_absorb(&state, in, length);
+    stub_squeeze(state, out, CX_SHA512_SIZE);
+    return CX_SHA512_SIZE;
+}
+
+//---------------------------------------------
+// Keys and signatures
+
+int cx_ecfp_init_private_key(cx_curve_t curve, const unsigned char* raw, unsigned int length,
+                             cx_ecfp_private_key_t* key)
+{
+    key->curve = curve;
+    key->d_len = length;
+    memcpy(key->d, raw, length);
+    return length;
+}
+
+int cx_ecfp_init_public_key(cx_curve_t curve, const unsigned char* raw, unsigned int length,
+                            cx_ecfp_public_key_t* key)
+{
+    key->curve = curve;
+    key->W_len = length;
+    if (raw != NULL) {
+        memcpy(key->W, raw, length);
+    }
+    return length;
+}
+
+int cx_ecfp_generate_pair(cx_curve_t curve, cx_ecfp_public_key_t* public_key,
+                          cx_ecfp_private_key_t* private_key, int keep_private)
+{
+    sdk_stub_keypair_count++;
+    public_key->curve = curve;
+    public_key->W_len = 65;
+    public_key->W[0] = 0x04;
+    stub_digest(curve, private_key->d, private_key->d_len, public_key->W + 1, 64);
+    return 0;
+}
+
+// DER sequence of r and s, both 32 bytes without a sign byte
+int cx_ecdsa_sign(const cx_ecfp_private_key_t* key, int mode, int hash_id,
+                  const unsigned char* hash, unsigned int hash_length,
+                  unsigned char* signature, unsigned int signature_length, unsigned int* info)
+{
+    unsigned char data[32 + 64];
+    memcpy(data, key->d, 32);
+    memcpy(data + 32, hash, hash_length);
+
+    unsigned char rs[64];
+    stub_digest(CX_SHA256, data, 32 + hash_length, rs, sizeof(rs));
+    rs[0] &= 0x7F;
+    rs[32] &= 0x7F;
+    rs[0] |= 0x01;
+    rs[32] |= 0x01;
+
+    signature[0] = 0x30;
+    signature[1] = 68;
+    signature[2] = 0x02;
+    signature[3] = 32;
+    memcpy(signature + 4, rs, 32);
+    signature[36] = 0x02;
+    signature[37] = 32;
+    memcpy(signature + 38, rs + 32, 32);
+    return 70;
+}
+
+int cx_ecdsa_verify(const cx_ecfp_public_key_t* key, int mode, int hash_id,
+                    const unsigned char* hash, unsigned int hash_length,
+                    const unsigned char* signature, unsigned int signature_length)
+{
+    return 1;
+}
+
+int cx_eddsa_sign(const cx_ecfp_private_key_t* key, int mode, int hash_id,
+                  const unsigned char* hash, unsigned int hash_length,
+                  const unsigned char* context, unsigned int context_length,
+                  unsigned char* signature, unsigned int signature_length, unsigned int* info)
+{
+    unsigned char data[32 + 64];
+    memcpy(data, key->d, 32);
+    memcpy(data + 32, hash, hash_length);
+    stub_digest(CX_SHA512, data, 32 + hash_length, signature, 64);
+    return 64;
+}
+
+int cx_eddsa_verify(const cx_ecfp_public_key_t* key, int mode, int hash_id,
+                    const unsigned char* hash, unsigned int hash_length,
+                    const unsigned char* context, unsigned int context_length,
+                    const unsigned char* signature, unsigned int signature_length)
+{
+    return 1;
+}
+
+//---------------------------------------------
+// Big endian arithmetic
+
+int cx_math_cmp(const unsigned char* a, const unsigned char* b, unsigned int length)
+{
+    return memcmp(a, b, length);
+}
+
+int cx_math_is_zero(const unsigned char* a, unsigned int length)
+{
+    for (unsigned int i = 0; i < length; i++) {
+        if (a[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int cx_math_sub(unsigned char* r, const unsigned char* a, const unsigned char* b, unsigned int length)
+{
+    int borrow = 0;
+    for (int i = (int) length - 1; i >= 0; i--) {
+        int d = a[i] - b[i] - borrow;
+        borrow = d < 0;
+        r[i] = (unsigned char) d;
+    }
+    return borrow;
+}
+
+// a and b are below m
+int cx_math_addm(unsigned char* r, const unsigned char* a, const unsigned char* b,
+                 const unsigned char* m, unsigned int length)
+{
+    int carry = 0;
+    for (int i = (int) length - 1; i >= 0; i--) {
+        int s = a[i] + b[i] + carry;
+        carry = s > 0xFF;
+        r[i] = (unsigned char) s;
+    }
+    if (carry || cx_math_cmp(r, m, length) >= 0) {
+        cx_math_sub(r, r, m, length);
+    }
+    return 0;
+}
+
+// Not modular arithmetic, only keeps the results deterministic
+int cx_math_multm(unsigned char* r, const unsigned char* a, const unsigned char* b,
+                  const unsigned char* m, unsigned int length)
+{
+    unsigned char data[2 * 64];
+    memcpy(data, a, length);
+    memcpy(data + length, b, length);
+    stub_digest(0, data, 2 * length, r, length);
+    return 0;
+}
+
+int cx_math_powm(unsigned char* r, const unsigned char* a, const unsigned char* e, unsigned int e_length,
+                 const unsigned char* m, unsigned int length)
+{
+    unsigned char data[2 * 64];
+    memcpy(data, a, length);
+    memcpy(data + length, e, e_length);
+    stub_digest(1, data, length + e_length, r, length);
+    return 0;
+}
+
+//---------------------------------------------
+// bip32 on top of the primitives above, so the app's own CKD steps agree with it
+
+static const unsigned char STUB_SECP256K1_N[] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+        0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b,
+        0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41
+};
+
+void os_perso_derive_node_bip32(
+        cx_curve_t curve,
+        const uint32_t* path,
+        unsigned int path_length,
+        unsigned char* private_key,
+        unsigned char* chain)
+{
+    sdk_stub_derive_count++;
+
+    unsigned char key[32];
+    unsigned char node_chain[32];
+    const unsigned char seed[] = "sdk stub seed";
+    unsigned char I[64];
+    stub_digest(curve, seed, sizeof(seed), I, sizeof(I));
+    I[0] &= 0x7F;
+    memcpy(key, I, 32);
+    memcpy(node_chain, I + 32, 32);
+
+    for (unsigned int level = 0; level < path_length; level++) {
+        unsigned char data[33 + 4];
+        if (path[level] & 0x80000000) {
+            data[0] = 0;
+            memcpy(data + 1, key, 32);
+        }
+        else {
+            // Compressed public key, as keys_compress_secp256k1 writes it
+            cx_ecfp_private_key_t private_key_struct;
+            cx_ecfp_public_key_t public_key;
+            cx_ecfp_init_private_key(curve, key, 32, &private_key_struct);
+            public_key.W[0] = 0x04;
+            stub_digest(curve, private_key_struct.d, 32, public_key.W + 1, 64);
+            data[0] = (public_key.W[64] & 1) ? 0x03 : 0x02;
+            memcpy(data + 1, public_key.W + 1, 32);
+        }
+        data[33] = path[level] >> 24;
+        data[34] = path[level] >> 16;
+        data[35] = path[level] >> 8;
+        data[36] = path[level];
+
+        cx_hmac_sha512(node_chain, 32, data, sizeof(data), I, sizeof(I));
+        cx_math_addm(key, I, key, STUB_SECP256K1_N, 32);
+        memcpy(node_chain, I + 32, 32);
+    }
+
+    memcpy(private_key, key, 32);
+    if (chain != NULL) {
+        memcpy(chain, node_chain, 32);
+    }
+}
@@ -0,0 +1,51 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Controls and records of the stubbed SDK, for the device module tests
+
+#include "os.h"
+#include "cx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Replies sent with io_exchange outside of the command loop (IO_RETURN_AFTER_TX)
+typedef struct {
+    unsigned short length;
+    unsigned char data[IO_APDU_BUFFER_SIZE];
+} sdk_stub_reply_t;
+
+extern int sdk_stub_reply_count;
+extern sdk_stub_reply_t sdk_stub_last_reply;
+
+// Work done through the SDK since the last sdk_stub_reset
+extern int sdk_stub_derive_count;           // os_perso_derive_node_bip32 calls
+extern int sdk_stub_keypair_count;          // cx_ecfp_generate_pair calls
+extern int sdk_stub_nvm_write_count;        // nvm_write calls
+extern unsigned int sdk_stub_nvm_write_bytes;
+
+// Clears the records above
+void sdk_stub_reset();
+
+// Calls function(argument) inside a TRY block.
+// Returns the exception it threw, 0 if it returned.
+exception_t sdk_stub_call(void (*function)(void*), void* argument);
+
+#ifdef __cplusplus
+}
+#endif
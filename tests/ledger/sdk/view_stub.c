@@ -0,0 +1,107 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "view_stub.h"
+
+unsigned short view_scrolling_step = 0;
+unsigned short view_scrolling_step_count = 0;
+unsigned short view_scrolling_total_size = 0;
+unsigned char view_scrolling_direction = 0;
+unsigned short key_scrolling_step = 0;
+unsigned short key_scrolling_step_count = 0;
+unsigned short key_scrolling_total_size = 0;
+unsigned char key_scrolling_direction = 0;
+enum UI_STATE view_uiState = UI_IDLE;
+
+int view_stub_page_count = -1;
+int view_stub_redisplay_count = 0;
+
+delegate_update_transaction_info view_stub_update = NULL;
+delegate_reject_transaction view_stub_on_reject = NULL;
+delegate_sign_transaction view_stub_on_sign = NULL;
+delegate_exit_app view_stub_on_exit = NULL;
+
+void view_add_update_transaction_info_event_handler(delegate_update_transaction_info delegate)
+{
+    view_stub_update = delegate;
+}
+
+void view_add_reject_transaction_event_handler(delegate_reject_transaction delegate)
+{
+    view_stub_on_reject = delegate;
+}
+
+void view_add_sign_transaction_event_handler(delegate_sign_transaction delegate)
+{
+    view_stub_on_sign = delegate;
+}
+
+void view_add_exit_app_event_handler(delegate_exit_app delegate)
+{
+    view_stub_on_exit = delegate;
+}
+
+void view_init(void)
+{
+    view_idle(0);
+}
+
+void view_idle(unsigned int ignored)
+{
+    view_uiState = UI_IDLE;
+    view_stub_page_count = -1;
+}
+
+void view_display_transaction_menu(unsigned int page_count)
+{
+    view_uiState = UI_TRANSACTION;
+    view_stub_page_count = page_count;
+    view_stub_redisplay_count = 0;
+}
+
+void view_redisplay_transaction_info()
+{
+    if (view_uiState == UI_TRANSACTION) {
+        view_stub_redisplay_count++;
+    }
+}
+
+void view_display_signing_success()
+{
+    view_idle(0);
+}
+
+void view_display_signing_error()
+{
+    view_idle(0);
+}
+
+int view_stub_get_page(int page, char* key, char* value)
+{
+    view_scrolling_step = 0;
+    key_scrolling_step = 0;
+    return view_stub_update(key, value, page);
+}
+
+void view_stub_sign()
+{
+    view_stub_on_sign();
+}
+
+void view_stub_reject()
+{
+    view_stub_on_reject();
+}
@@ -0,0 +1,41 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Screen of the device module tests: remembers the menu that is shown and
+// plays the user's choice through the delegates the app registered
+
+#include "view.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pages of the transaction menu on screen, -1 while the idle menu is shown
+extern int view_stub_page_count;
+// Calls of view_redisplay_transaction_info while the menu is shown
+extern int view_stub_redisplay_count;
+
+// Fills key and value of a menu page through the registered delegate
+int view_stub_get_page(int page, char* key, char* value);
+
+// The user approves or rejects the menu on screen
+void view_stub_sign();
+void view_stub_reject();
+
+#ifdef __cplusplus
+}
+#endif
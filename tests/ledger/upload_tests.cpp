@@ -0,0 +1,165 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+extern "C" {
+#include "batch.h"
+}
+
+namespace {
+
+    const std::string upload_transaction =
+            R"({"account_number":"1","chain_id":"test-chain-1","fee":{"amount":[{"amount":"5","denom":"photon"}],"gas":"10000"},)"
+            R"("memo":"upload","msgs":[{"inputs":[{"address":"cosmos1in","coins":[{"amount":"10","denom":"atom"}]}],)"
+            R"("outputs":[{"address":"cosmos1out","coins":[{"amount":"10","denom":"atom"}]}]}],"sequence":"2"})";
+
+    class UploadTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+        }
+
+        apdu_reply_t send(uint8_t ins, uint8_t index, uint8_t count, const std::vector<uint8_t>& data)
+        {
+            std::vector<uint8_t> body = {index, count};
+            body.insert(body.end(), data.begin(), data.end());
+            return device_exchange(ins, body);
+        }
+
+        // v2 package 0: total length, bip32 path and the first bytes
+        apdu_reply_t send_v2_start(uint32_t total_length, const std::string& data)
+        {
+            std::vector<uint8_t> body = {0, 0,
+                                         (uint8_t) (total_length >> 24), (uint8_t) (total_length >> 16),
+                                         (uint8_t) (total_length >> 8), (uint8_t) total_length};
+            std::vector<uint8_t> path = device_path(cosmos_path);
+            body.insert(body.end(), path.begin(), path.end());
+            body.insert(body.end(), data.begin(), data.end());
+            return device_exchange(INS_SIGN_SECP256K1_V2, body);
+        }
+
+        std::vector<uint8_t> status()
+        {
+            apdu_reply_t reply = device_exchange(INS_UPLOAD_STATUS, {0, 0});
+            EXPECT_EQ(reply.sw, APDU_CODE_OK);
+            return reply.data;
+        }
+
+        std::vector<uint8_t> bytes(const std::string& text)
+        {
+            return std::vector<uint8_t>(text.begin(), text.end());
+        }
+    };
+
+    TEST_F(UploadTest, V1RefusesIndexAboveCount) {
+        EXPECT_EQ(send(INS_SIGN_SECP256K1, 3, 2, bytes("{}")).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(send(INS_SIGN_SECP256K1, 0, 2, bytes("{}")).sw, APDU_CODE_DATA_INVALID);
+
+        EXPECT_EQ(send(INS_SIGN_SECP256K1, 1, 3, device_path(cosmos_path)).sw, APDU_CODE_OK);
+        EXPECT_EQ(send(INS_SIGN_SECP256K1, 4, 3, bytes("{}")).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(status()[1], 1);
+    }
+
+    TEST_F(UploadTest, StatusReportsV1Progress) {
+        auto packets = device_packets(cosmos_path, upload_transaction, 110);
+        ASSERT_EQ(packets.size(), 4u);
+        for (uint8_t i = 0; i < 3; i++) {
+            ASSERT_EQ(send(INS_SIGN_SECP256K1, i + 1, 4, packets[i]).sw, APDU_CODE_OK);
+        }
+
+        std::vector<uint8_t> expected = {4, 3, 0, 0, 0, 220,
+                                         0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        EXPECT_EQ(status(), expected);
+    }
+
+    TEST_F(UploadTest, StatusReportsV2Progress) {
+        uint32_t total = upload_transaction.size();
+        apdu_reply_t reply = send_v2_start(total, upload_transaction.substr(0, 100));
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        std::vector<uint8_t> part = bytes(upload_transaction.substr(100, 50));
+        ASSERT_EQ(send(INS_SIGN_SECP256K1_V2, 0, 1, part).sw, APDU_CODE_OK);
+
+        std::vector<uint8_t> expected = {0, 0, 0, 0, 0, 0,
+                                         0, 2, 0, 0, 0, 150, 0, 0, (uint8_t) (total >> 8), (uint8_t) total};
+        EXPECT_EQ(status(), expected);
+    }
+
+    TEST_F(UploadTest, V2StartAbandonsV1) {
+        auto packets = device_packets(cosmos_path, upload_transaction, 110);
+        ASSERT_EQ(send(INS_SIGN_SECP256K1, 1, 4, packets[0]).sw, APDU_CODE_OK);
+        ASSERT_EQ(send_v2_start(upload_transaction.size(), upload_transaction.substr(0, 100)).sw, APDU_CODE_OK);
+
+        EXPECT_EQ(send(INS_SIGN_SECP256K1, 2, 4, packets[1]).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(status()[0], 0);
+    }
+
+    TEST_F(UploadTest, V1StartAbandonsV2) {
+        ASSERT_EQ(send_v2_start(upload_transaction.size(), upload_transaction.substr(0, 100)).sw, APDU_CODE_OK);
+        ASSERT_EQ(send(INS_SIGN_SECP256K1, 1, 4, device_path(cosmos_path)).sw, APDU_CODE_OK);
+
+        EXPECT_EQ(send(INS_SIGN_SECP256K1_V2, 0, 1, bytes(upload_transaction.substr(100, 50))).sw,
+                  APDU_CODE_DATA_INVALID);
+        std::vector<uint8_t> progress = status();
+        EXPECT_EQ(std::vector<uint8_t>(progress.begin() + 6, progress.end()), std::vector<uint8_t>(10, 0));
+    }
+
+    TEST_F(UploadTest, BatchDoesNotContinueV1) {
+        auto packets = device_packets({}, upload_transaction, 110);
+        std::vector<uint8_t> start = {0, 0};
+        std::vector<uint8_t> path = device_path(cosmos_path);
+        start.insert(start.end(), path.begin(), path.end());
+        ASSERT_EQ(device_exchange(INS_BATCH_START, start).sw, APDU_CODE_OK);
+        ASSERT_EQ(send(INS_BATCH_ADD, 1, 3, packets[0]).sw, APDU_CODE_OK);
+
+        // Same index and count as the batch upload in progress
+        EXPECT_EQ(send(INS_SIGN_SECP256K1, 2, 3, packets[1]).sw, APDU_CODE_DATA_INVALID);
+        EXPECT_EQ(status()[0], 0);
+    }
+
+    TEST_F(UploadTest, BatchAcknowledgesResentFirstPacket) {
+        auto packets = device_packets({}, upload_transaction, 110);
+        std::vector<uint8_t> start = {0, 0};
+        std::vector<uint8_t> path = device_path(cosmos_path);
+        start.insert(start.end(), path.begin(), path.end());
+        ASSERT_EQ(device_exchange(INS_BATCH_START, start).sw, APDU_CODE_OK);
+
+        ASSERT_EQ(send(INS_BATCH_ADD, 1, 3, packets[0]).sw, APDU_CODE_OK);
+        ASSERT_EQ(send(INS_BATCH_ADD, 1, 3, packets[0]).sw, APDU_CODE_OK);
+        ASSERT_EQ(send(INS_BATCH_ADD, 2, 3, packets[1]).sw, APDU_CODE_OK);
+        apdu_reply_t reply = send(INS_BATCH_ADD, 3, 3, packets[2]);
+        ASSERT_EQ(reply.sw, APDU_CODE_OK);
+        EXPECT_EQ(reply.data, std::vector<uint8_t>{1});
+
+        // The packet was not appended twice
+        EXPECT_EQ(transaction_get_length(), upload_transaction.size() + 1);
+    }
+
+    TEST_F(UploadTest, BatchRefusesRestartOfUnfinishedTransaction) {
+        auto packets = device_packets({}, upload_transaction, 110);
+        std::vector<uint8_t> start = {0, 0};
+        std::vector<uint8_t> path = device_path(cosmos_path);
+        start.insert(start.end(), path.begin(), path.end());
+        ASSERT_EQ(device_exchange(INS_BATCH_START, start).sw, APDU_CODE_OK);
+
+        ASSERT_EQ(send(INS_BATCH_ADD, 1, 3, packets[0]).sw, APDU_CODE_OK);
+        ASSERT_EQ(send(INS_BATCH_ADD, 2, 3, packets[1]).sw, APDU_CODE_OK);
+        EXPECT_EQ(send(INS_BATCH_ADD, 1, 2, packets[0]).sw, APDU_CODE_COMMAND_NOT_ALLOWED);
+        EXPECT_EQ(batch_get_count(), 0);
+    }
+}
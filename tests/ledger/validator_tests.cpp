@@ -0,0 +1,197 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "device.h"
+
+#include <cstring>
+
+extern "C" {
+#include "validator.h"
+#include "tendermint_vote.h"
+
+// Layout of the watermarks in flash (validator.c)
+struct watermark_t {
+    char chain_id[TM_CHAIN_ID_SIZE];
+    tm_hrs_t hrs;
+    uint32_t session;
+};
+extern watermark_t N_validator_watermarks_impl[VALIDATOR_MAX_CHAINS];
+}
+
+namespace {
+
+    const std::vector<uint32_t> validator_path = {0x80000000 | 44, 0x80000000 | 118, 0x80000000, 0x80000000, 0x80000000};
+
+    std::vector<uint8_t> vote(const std::string& chain_id, int height, int round, int type)
+    {
+        std::string json = R"({"@chain_id":")" + chain_id + R"(","@type":"vote","block_id":{},"height":")"
+                           + std::to_string(height) + R"(","round":")" + std::to_string(round)
+                           + R"(","timestamp":"2018-02-11T07:09:22.765Z","type":)" + std::to_string(type) + "}";
+        return std::vector<uint8_t>(json.begin(), json.end());
+    }
+
+    class ValidatorTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            device_reset();
+            std::memset(N_validator_watermarks_impl, 0, sizeof(N_validator_watermarks_impl));
+        }
+
+        void approve()
+        {
+            ASSERT_EQ(device_exchange(INS_VALIDATOR_START, device_path(validator_path)).sw, 0);
+            ASSERT_EQ(view_stub_page_count, 3);
+            view_stub_sign();
+            apdu_reply_t reply = device_last_async_reply();
+            ASSERT_EQ(reply.sw, APDU_CODE_OK);
+            ASSERT_EQ(reply.data.size(), 32u);
+            sdk_stub_reset();
+        }
+
+        uint16_t sign(const std::string& chain_id, int height, int round = 0, int type = 1)
+        {
+            std::vector<uint8_t> body = {1, 1};
+            std::vector<uint8_t> sign_bytes = vote(chain_id, height, round, type);
+            body.insert(body.end(), sign_bytes.begin(), sign_bytes.end());
+            apdu_reply_t reply = device_exchange(INS_VALIDATOR_SIGN, body);
+            if (reply.sw == APDU_CODE_OK) {
+                EXPECT_EQ(reply.data.size(), 64u);
+            }
+            return reply.sw;
+        }
+
+        std::string page(int index)
+        {
+            char key[64];
+            char value[64];
+            view_stub_get_page(index, key, value);
+            return std::string(key) + "=" + value;
+        }
+    };
+
+    TEST_F(ValidatorTest, OnlyIncreasingVotesAreSigned) {
+        approve();
+        EXPECT_EQ(sign("chain-a", 10, 0, 1), APDU_CODE_OK);
+        EXPECT_EQ(sign("chain-a", 10, 0, 2), APDU_CODE_OK);
+        EXPECT_EQ(sign("chain-a", 10, 0, 2), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-a", 10, 0, 1), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-a", 9, 5, 2), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-a", 10, 1, 1), APDU_CODE_OK);
+        EXPECT_EQ(sign("chain-a", 11, 0, 1), APDU_CODE_OK);
+    }
+
+    TEST_F(ValidatorTest, SignaturesNeedAnApprovedKey) {
+        EXPECT_EQ(sign("chain-a", 1), APDU_CODE_COMMAND_NOT_ALLOWED);
+
+        ASSERT_EQ(device_exchange(INS_VALIDATOR_START, device_path(validator_path)).sw, 0);
+        view_stub_reject();
+        EXPECT_EQ(sign("chain-a", 1), APDU_CODE_COMMAND_NOT_ALLOWED);
+
+        approve();
+        std::vector<uint8_t> body = {1, 1, '{', '}'};
+        EXPECT_EQ(device_exchange(INS_VALIDATOR_SIGN, body).sw, APDU_CODE_DATA_INVALID);
+        body[0] = 2;
+        EXPECT_EQ(device_exchange(INS_VALIDATOR_SIGN, body).sw, APDU_CODE_DATA_INVALID);
+
+        clear_key_caches();
+        EXPECT_EQ(sign("chain-a", 1), APDU_CODE_COMMAND_NOT_ALLOWED) << "Leaving the app ends the session";
+    }
+
+    TEST_F(ValidatorTest, SessionStaysOnItsChain) {
+        approve();
+        EXPECT_EQ(sign("chain-a", 10), APDU_CODE_OK);
+        EXPECT_EQ(sign("chain-b", 20), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-a", 11), APDU_CODE_OK);
+    }
+
+    TEST_F(ValidatorTest, WatermarkSurvivesANewSession) {
+        approve();
+        EXPECT_EQ(sign("chain-a", 10), APDU_CODE_OK);
+
+        approve();
+        EXPECT_EQ(sign("chain-a", 10), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-a", 11), APDU_CODE_OK);
+    }
+
+    TEST_F(ValidatorTest, ChainSwitchKeepsTheOtherWatermark) {
+        approve();
+        EXPECT_EQ(sign("chain-a", 10), APDU_CODE_OK);
+
+        approve();
+        EXPECT_EQ(sign("chain-b", 1), APDU_CODE_OK);
+
+        approve();
+        EXPECT_EQ(sign("chain-a", 5), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-a", 10), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-a", 11), APDU_CODE_OK);
+
+        approve();
+        EXPECT_EQ(sign("chain-b", 1), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sign("chain-b", 2), APDU_CODE_OK);
+    }
+
+    TEST_F(ValidatorTest, OldestSessionGivesWayToANewChain) {
+        const char* chains[] = {"chain-a", "chain-b", "chain-c", "chain-d"};
+        for (const char* chain : chains) {
+            approve();
+            ASSERT_EQ(sign(chain, 10), APDU_CODE_OK);
+        }
+        // chain-a signs again, chain-b has the oldest session now
+        approve();
+        ASSERT_EQ(sign("chain-a", 11), APDU_CODE_OK);
+
+        approve();
+        EXPECT_EQ(sign("chain-e", 1), APDU_CODE_OK);
+
+        for (const char* chain : {"chain-a", "chain-c", "chain-d"}) {
+            approve();
+            EXPECT_EQ(sign(chain, 10), APDU_CODE_CONDITIONS_NOT_SATISFIED) << chain;
+        }
+        approve();
+        EXPECT_EQ(sign("chain-b", 1), APDU_CODE_OK) << "The replaced chain starts over";
+    }
+
+    TEST_F(ValidatorTest, ApprovalShowsTheLastSignedChain) {
+        ASSERT_EQ(device_exchange(INS_VALIDATOR_START, device_path(validator_path)).sw, 0);
+        EXPECT_EQ(page(1), "Signed chain=None");
+        view_stub_sign();
+
+        EXPECT_EQ(sign("chain-a", 12, 3, 2), APDU_CODE_OK);
+        approve();
+        EXPECT_EQ(sign("chain-b", 7), APDU_CODE_OK);
+
+        ASSERT_EQ(device_exchange(INS_VALIDATOR_START, device_path(validator_path)).sw, 0);
+        EXPECT_EQ(page(1), "Signed chain=chain-b");
+        EXPECT_EQ(page(2), "Signed H/R/S=7/0/2");
+    }
+
+    TEST_F(ValidatorTest, OneFlashWritePerSignature) {
+        approve();
+        ASSERT_EQ(sign("chain-a", 10), APDU_CODE_OK);
+
+        sdk_stub_reset();
+        for (int height = 11; height < 15; height++) {
+            ASSERT_EQ(sign("chain-a", height), APDU_CODE_OK);
+        }
+        EXPECT_EQ(sdk_stub_nvm_write_count, 4);
+
+        sdk_stub_reset();
+        EXPECT_EQ(sign("chain-a", 11), APDU_CODE_CONDITIONS_NOT_SATISFIED);
+        EXPECT_EQ(sdk_stub_nvm_write_count, 0) << "Refused votes write nothing";
+    }
+}
@@ -0,0 +1,235 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/policy.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::string transaction(const std::string& chain_id, const std::string& address, const std::string& amount, int fee)
+    {
+        return R"({"alt_bytes":null,"chain_id":")" + chain_id
+               + R"(","fee_bytes":{"amount":[{"amount":)" + std::to_string(fee)
+               + R"(,"denom":"photon"}],"gas":10000},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[{"amount":)" + amount
+               + R"(,"denom":"atom"}]}],"outputs":[{"address":")" + address
+               + R"(","coins":[{"amount":)" + amount + R"(,"denom":"atom"}]}]},"sequences":[1]})";
+    }
+
+    // Withdrawals of at most 100 atom to one address on test-chain-1, fee at most 10 photon
+    class PolicyTest : public ::testing::Test {
+    protected:
+        void SetUp() override
+        {
+            length = policy_init(policy, sizeof(policy), POLICY_CURVE_SECP256K1, path, 5);
+            length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_CHAIN_ID, "test-chain-1", 0);
+            length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_RECIPIENT, "6F7574707574", 0);
+            length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_AMOUNT_CAP, "atom", 100);
+            length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_FEE_CAP, "photon", 10);
+            ASSERT_GT(length, 0);
+        }
+
+        int evaluate(const std::string& tx)
+        {
+            parsed_json_t parsed_json;
+            json_parse(&parsed_json, tx.c_str());
+            return policy_evaluate(policy, length, &parsed_json, tx.c_str());
+        }
+
+        const uint32_t path[5] = {0x8000002C, 0x80000076, 0x80000000, 0, 0};
+        uint8_t policy[POLICY_MAX_SIZE];
+        int length;
+    };
+
+    TEST_F(PolicyTest, Allow) {
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "6F7574707574", "100", 10)), POLICY_ALLOW);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "6F7574707574", "\"5\"", 1)), POLICY_ALLOW);
+    }
+
+    TEST_F(PolicyTest, DenyChain) {
+        EXPECT_EQ(evaluate(transaction("test-chain-2", "6F7574707574", "100", 10)), POLICY_DENY);
+        // The whole value has to match
+        EXPECT_EQ(evaluate(transaction("test-chain-10", "6F7574707574", "100", 10)), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, DenyRecipient) {
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "0BAD", "100", 10)), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, DenyAmount) {
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "6F7574707574", "101", 10)), POLICY_DENY);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "6F7574707574", "-1", 10)), POLICY_DENY);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "6F7574707574", "99999999999999999999", 10)), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, DenyFee) {
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "6F7574707574", "100", 11)), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, AmountsAreSummedOverOutputs) {
+        auto tx = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[]}],"outputs":[{"address":"6F7574707574","coins":[{"amount":60,"denom":"atom"}]},{"address":"6F7574707574","coins":[{"amount":60,"denom":"atom"}]}]}})";
+        EXPECT_EQ(evaluate(tx), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, UncappedDenomIsDenied) {
+        auto tx = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[]}],"outputs":[{"address":"6F7574707574","coins":[{"amount":1,"denom":"steak"}]}]}})";
+        EXPECT_EQ(evaluate(tx), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, MissingOutputsIsDenied) {
+        auto tx = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"validator":"abc"}})";
+        EXPECT_EQ(evaluate(tx), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, RecipientAllowlist) {
+        length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_RECIPIENT, "0B0B", 0);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "0B0B", "1", 1)), POLICY_ALLOW);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "6F7574707574", "1", 1)), POLICY_ALLOW);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "0B0B0B", "1", 1)), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, RecipientAllowlistIsRequired) {
+        length = policy_init(policy, sizeof(policy), POLICY_CURVE_SECP256K1, path, 5);
+        EXPECT_EQ(policy_get_rule_count(policy, length), 0);
+        EXPECT_EQ(evaluate(transaction("any", "any", "1000000", 1000)), POLICY_DENY);
+
+        length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_CHAIN_ID, "test-chain-1", 0);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "any", "1", 1)), POLICY_DENY);
+
+        length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_FEE_CAP, "photon", 10);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "any", "1", 1)), POLICY_DENY);
+
+        length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_RECIPIENT, "any", 0);
+        EXPECT_EQ(evaluate(transaction("test-chain-1", "any", "1", 1)), POLICY_ALLOW);
+    }
+
+    TEST_F(PolicyTest, UnknownMessageIsDenied) {
+        // Delegation, not a send
+        auto delegate = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"delegator":"696E707574","validator":"0BAD","inputs":[],"outputs":[]}})";
+        EXPECT_EQ(evaluate(delegate), POLICY_DENY);
+
+        auto alt_bytes = R"({"alt_bytes":{"outputs":[{"address":"0BAD"}]},"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[],"outputs":[]}})";
+        EXPECT_EQ(evaluate(alt_bytes), POLICY_DENY);
+
+        auto extra_root_key = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[],"outputs":[]},"memo":"x"})";
+        EXPECT_EQ(evaluate(extra_root_key), POLICY_DENY);
+
+        auto extra_input_key = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[],"to":"0BAD"}],"outputs":[]}})";
+        EXPECT_EQ(evaluate(extra_input_key), POLICY_DENY);
+
+        auto no_inputs = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"outputs":[]}})";
+        EXPECT_EQ(evaluate(no_inputs), POLICY_DENY);
+
+        auto send = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[],"outputs":[]}})";
+        EXPECT_EQ(evaluate(send), POLICY_ALLOW);
+    }
+
+    TEST_F(PolicyTest, DuplicateKeysAreDenied) {
+        auto chain_id = R"({"chain_id":"test-chain-1","chain_id":"other","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[],"outputs":[]}})";
+        EXPECT_EQ(evaluate(chain_id), POLICY_DENY);
+
+        auto address = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[],"outputs":[{"address":"6F7574707574","address":"0BAD","coins":[]}]}})";
+        EXPECT_EQ(evaluate(address), POLICY_DENY);
+
+        auto outputs = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[],"gas":1},"msg_bytes":{"inputs":[],"outputs":[],"outputs":[{"address":"0BAD","coins":[]}]}})";
+        EXPECT_EQ(evaluate(outputs), POLICY_DENY);
+
+        auto denom = R"({"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":1,"denom":"photon","denom":"steak"}],"gas":1},"msg_bytes":{"inputs":[],"outputs":[]}})";
+        EXPECT_EQ(evaluate(denom), POLICY_DENY);
+    }
+
+    TEST_F(PolicyTest, Key) {
+        uint8_t curve, depth;
+        uint32_t key_path[POLICY_MAX_DEPTH];
+        ASSERT_EQ(policy_get_key(policy, length, &curve, key_path, &depth), 0);
+        EXPECT_EQ(curve, POLICY_CURVE_SECP256K1);
+        ASSERT_EQ(depth, 5);
+        for (int i = 0; i < 5; i++) {
+            EXPECT_EQ(key_path[i], path[i]);
+        }
+        // Levels are little endian, as in the APDUs
+        EXPECT_EQ(std::vector<uint8_t>(policy + 3, policy + 7), std::vector<uint8_t>({0x2C, 0x00, 0x00, 0x80}));
+
+        char key[32];
+        char value[32];
+        EXPECT_EQ(policy_get_key_text(policy, length, key, sizeof(key), value, sizeof(value), 0), 27);
+        EXPECT_STREQ(key, "Signing key");
+        EXPECT_STREQ(value, "secp256k1 m/44'/118'/0'/0/0");
+    }
+
+    TEST_F(PolicyTest, MalformedPolicy) {
+        EXPECT_EQ(policy_get_rule_count(policy, length), 4);
+        EXPECT_EQ(policy_get_rule_count(policy, length - 1), -1);
+
+        uint8_t unknown_op[] = {POLICY_VERSION, POLICY_CURVE_SECP256K1, 0, 9, 1, 'x'};
+        EXPECT_EQ(policy_get_rule_count(unknown_op, sizeof(unknown_op)), -1);
+
+        uint8_t short_cap[] = {POLICY_VERSION, POLICY_CURVE_SECP256K1, 0, POLICY_OP_AMOUNT_CAP, 8, 0, 0, 0, 0, 0, 0, 0, 1};
+        EXPECT_EQ(policy_get_rule_count(short_cap, sizeof(short_cap)), -1);
+
+        uint8_t wrong_version[] = {POLICY_VERSION + 1, POLICY_CURVE_SECP256K1, 0};
+        EXPECT_EQ(policy_get_rule_count(wrong_version, sizeof(wrong_version)), -1);
+
+        uint8_t unknown_curve[] = {POLICY_VERSION, 7, 0};
+        EXPECT_EQ(policy_get_rule_count(unknown_curve, sizeof(unknown_curve)), -1);
+
+        uint8_t short_path[] = {POLICY_VERSION, POLICY_CURVE_ED25519, 2, 0, 0, 0, 1};
+        EXPECT_EQ(policy_get_rule_count(short_path, sizeof(short_path)), -1);
+
+        auto tx = transaction("test-chain-1", "6F7574707574", "1", 1);
+        parsed_json_t parsed_json;
+        json_parse(&parsed_json, tx.c_str());
+        EXPECT_EQ(policy_evaluate(unknown_op, sizeof(unknown_op), &parsed_json, tx.c_str()), POLICY_INVALID);
+    }
+
+    TEST_F(PolicyTest, RuleDoesNotFit) {
+        uint8_t small[8];
+        int small_length = policy_init(small, sizeof(small), POLICY_CURVE_ED25519, path, 0);
+        EXPECT_EQ(policy_add_rule(small, sizeof(small), small_length, POLICY_OP_CHAIN_ID, "test-chain-1", 0), -1);
+        EXPECT_EQ(policy_init(small, sizeof(small), POLICY_CURVE_ED25519, path, 5), -1);
+    }
+
+    TEST_F(PolicyTest, RuleText) {
+        char key[32];
+        char value[32];
+        ASSERT_EQ(policy_get_rule_text(policy, length, 0, key, sizeof(key), value, sizeof(value), 0), 12);
+        EXPECT_STREQ(key, "Allowed chain");
+        EXPECT_STREQ(value, "test-chain-1");
+        ASSERT_EQ(policy_get_rule_text(policy, length, 2, key, sizeof(key), value, sizeof(value), 0), 8);
+        EXPECT_STREQ(key, "Max amount");
+        EXPECT_STREQ(value, "100 atom");
+        ASSERT_EQ(policy_get_rule_text(policy, length, 3, key, sizeof(key), value, sizeof(value), 0), 9);
+        EXPECT_STREQ(key, "Max fee");
+        EXPECT_STREQ(value, "10 photon");
+        EXPECT_EQ(policy_get_rule_text(policy, length, 4, key, sizeof(key), value, sizeof(value), 0), -1);
+    }
+
+    TEST_F(PolicyTest, RuleTextScrolls) {
+        std::string address(90, 'a');
+        address += "end";
+        length = policy_add_rule(policy, sizeof(policy), length, POLICY_OP_RECIPIENT, address.c_str(), 0);
+
+        char key[32];
+        char value[21];
+        ASSERT_EQ(policy_get_rule_text(policy, length, 4, key, sizeof(key), value, sizeof(value), 0), 93);
+        EXPECT_EQ(std::string(value), std::string(20, 'a'));
+        ASSERT_EQ(policy_get_rule_text(policy, length, 4, key, sizeof(key), value, sizeof(value), 73), 93);
+        EXPECT_EQ(std::string(value), std::string(17, 'a') + "end");
+        ASSERT_EQ(policy_get_rule_text(policy, length, 4, key, sizeof(key), value, sizeof(value), 93), 93);
+        EXPECT_STREQ(value, "");
+    }
+}
@@ -0,0 +1,140 @@
+/*******************************************************************************
+*   (c) 2018 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "gtest/gtest.h"
+#include "lib/tendermint_vote.h"
+#include <string.h>
+
+namespace {
+
+    TEST(TendermintVoteTest, Prevote) {
+        auto sign_bytes = R"({"@chain_id":"test_chain_id","@type":"vote","block_id":{"hash":"8B01023386C371778ECB6368573E539AFC3CC860","parts":{"hash":"72DB3D959635DFF1BB567BEDAA70573392C51596","total":"1000000"}},"height":"12345","round":"2","timestamp":"2017-12-25T03:00:01.234Z","type":1})";
+
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+        ASSERT_EQ(tm_parse_sign_bytes(&parsed_json, sign_bytes, strlen(sign_bytes), &hrs, chain_id), 0);
+        EXPECT_EQ(hrs.height, 12345u);
+        EXPECT_EQ(hrs.round, 2u);
+        EXPECT_EQ(hrs.step, TM_STEP_PREVOTE);
+        EXPECT_STREQ(chain_id, "test_chain_id");
+    }
+
+    TEST(TendermintVoteTest, Precommit) {
+        auto sign_bytes = R"({"@chain_id":"test_chain_id","@type":"vote","block_id":{},"height":7,"round":0,"timestamp":"2017-12-25T03:00:01.234Z","type":2})";
+
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+        ASSERT_EQ(tm_parse_sign_bytes(&parsed_json, sign_bytes, strlen(sign_bytes), &hrs, chain_id), 0);
+        EXPECT_EQ(hrs.height, 7u);
+        EXPECT_EQ(hrs.round, 0u);
+        EXPECT_EQ(hrs.step, TM_STEP_PRECOMMIT);
+    }
+
+    TEST(TendermintVoteTest, Proposal) {
+        auto sign_bytes = R"({"@chain_id":"test_chain_id","@type":"proposal","block_parts_header":{"hash":"616263","total":"111"},"height":"12345","pol_block_id":{},"pol_round":"-1","round":"23456","timestamp":"2018-02-11T07:09:22.765Z"})";
+
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+        ASSERT_EQ(tm_parse_sign_bytes(&parsed_json, sign_bytes, strlen(sign_bytes), &hrs, chain_id), 0);
+        EXPECT_EQ(hrs.height, 12345u);
+        EXPECT_EQ(hrs.round, 23456u);
+        EXPECT_EQ(hrs.step, TM_STEP_PROPOSE);
+    }
+
+    TEST(TendermintVoteTest, NestedKeysAreIgnored) {
+        // height and round inside block_id must not be picked up
+        auto sign_bytes = R"({"@chain_id":"test_chain_id","@type":"vote","block_id":{"height":"99","round":"99"},"height":"5","round":"1","type":1})";
+
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+        ASSERT_EQ(tm_parse_sign_bytes(&parsed_json, sign_bytes, strlen(sign_bytes), &hrs, chain_id), 0);
+        EXPECT_EQ(hrs.height, 5u);
+        EXPECT_EQ(hrs.round, 1u);
+    }
+
+    TEST(TendermintVoteTest, NotAVote) {
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+        auto transaction = R"({"account_number":"1","chain_id":"cosmos","fee":{},"height":"5","round":"1"})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, transaction, strlen(transaction), &hrs, chain_id), -1);
+
+        auto unknown_vote = R"({"@type":"vote","height":"5","round":"1","type":3})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, unknown_vote, strlen(unknown_vote), &hrs, chain_id), -1);
+
+        auto negative = R"({"@type":"vote","height":"-5","round":"1","type":1})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, negative, strlen(negative), &hrs, chain_id), -1);
+
+        auto overflow = R"({"@type":"vote","height":"99999999999999999999","round":"1","type":1})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, overflow, strlen(overflow), &hrs, chain_id), -1);
+    }
+
+    TEST(TendermintVoteTest, ChainId) {
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+
+        auto plain_key = R"({"@type":"vote","chain_id":"cosmoshub","height":"5","round":"1","type":1})";
+        ASSERT_EQ(tm_parse_sign_bytes(&parsed_json, plain_key, strlen(plain_key), &hrs, chain_id), 0);
+        EXPECT_STREQ(chain_id, "cosmoshub");
+
+        auto missing = R"({"@type":"vote","height":"5","round":"1","type":1})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, missing, strlen(missing), &hrs, chain_id), -1);
+
+        auto too_long = R"({"@chain_id":"0123456789012345678901234567890123456789012345678901","@type":"vote","height":"5","round":"1","type":1})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, too_long, strlen(too_long), &hrs, chain_id), -1);
+    }
+
+    TEST(TendermintVoteTest, RepeatedFields) {
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+
+        auto height = R"({"@chain_id":"a","@type":"vote","height":"5","height":"4","round":"1","type":1})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, height, strlen(height), &hrs, chain_id), -1);
+
+        auto chain = R"({"@chain_id":"a","@type":"vote","chain_id":"b","height":"5","round":"1","type":1})";
+        EXPECT_EQ(tm_parse_sign_bytes(&parsed_json, chain, strlen(chain), &hrs, chain_id), -1);
+    }
+
+    TEST(TendermintVoteTest, NotTerminated) {
+        // Only length bytes are read, the sign bytes come straight from the APDU buffer
+        parsed_json_t parsed_json;
+        char chain_id[TM_CHAIN_ID_SIZE];
+        tm_hrs_t hrs;
+
+        auto sign_bytes = R"({"@chain_id":"a","@type":"vote","height":"5","round":"1","type":1}garbage)";
+        ASSERT_EQ(tm_parse_sign_bytes(&parsed_json, sign_bytes, strlen(sign_bytes) - 7, &hrs, chain_id), 0);
+        EXPECT_EQ(hrs.height, 5u);
+    }
+
+    TEST(TendermintVoteTest, Compare) {
+        tm_hrs_t a = {10, 0, TM_STEP_PRECOMMIT};
+        tm_hrs_t b = {11, 0, TM_STEP_PROPOSE};
+        tm_hrs_t c = {11, 1, TM_STEP_PROPOSE};
+        tm_hrs_t d = {11, 1, TM_STEP_PREVOTE};
+
+        EXPECT_LT(tm_hrs_compare(&a, &b), 0);
+        EXPECT_LT(tm_hrs_compare(&b, &c), 0);
+        EXPECT_LT(tm_hrs_compare(&c, &d), 0);
+        EXPECT_GT(tm_hrs_compare(&d, &a), 0);
+        EXPECT_EQ(tm_hrs_compare(&d, &d), 0);
+    }
+}
@@ -22,6 +22,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 #include <array>
 #include <jsmn.h>
 #include <lib/json_parser.h>
@@ -566,6 +567,185 @@ namespace {
         EXPECT_EQ_STR(value, "null", "Wrong value");
     }
 
+    // Plays the role of the flash region used on the device
+    jsmntok_t spill_storage[1024];
+
+    void spill_to_storage(unsigned int spill_index, const jsmntok_t* tokens, unsigned int count)
+    {
+        memcpy(spill_storage + spill_index, tokens, count * sizeof(jsmntok_t));
+    }
+
+    std::string transaction_with_outputs(int outputs)
+    {
+        std::string msg = R"({"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[)";
+        for (int i = 0; i < outputs; i++) {
+            if (i > 0) {
+                msg += ",";
+            }
+            msg += R"({"address":"ADDR)" + std::to_string(i) + R"(","coins":[{"amount":)" + std::to_string(i) + R"(,"denom":"atom"}]})";
+        }
+        msg += "]}";
+        return R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":)"
+               + msg + R"(,"sequences":[1]})";
+    }
+
+    TEST(TransactionParserTest, Spill_SmallTransactionStaysInRam) {
+
+        auto transaction = R"({"alt_bytes":null,"chain_id":"test-chain-1","fee_bytes":{"amount":[{"amount":5,"denom":"photon"}],"gas":10000},"msg_bytes":{"inputs":[{"address":"696E707574","coins":[{"amount":10,"denom":"atom"}]}],"outputs":[{"address":"6F7574707574","coins":[{"amount":10,"denom":"atom"}]}]},"sequences":[1]})";
+
+        parsed_json_t parsed_json;
+        int token_count = json_parse_spill(&parsed_json, transaction, json_count_tokens(transaction), spill_storage, 1024, spill_to_storage);
+
+        EXPECT_EQ(token_count, parsed_json.NumberOfTokens) << "Wrong number of tokens";
+        EXPECT_EQ(parsed_json.NumberOfSpillTokens, 0) << "Nothing should be spilled";
+    }
+
+    TEST(TransactionParserTest, Spill_Navigation) {
+
+        auto transaction = transaction_with_outputs(60);
+
+        parsed_json_t parsed_json;
+        int token_count = json_parse_spill(&parsed_json, transaction.c_str(), json_count_tokens(transaction.c_str()), spill_storage, 1024, spill_to_storage);
+
+        EXPECT_EQ(token_count, json_count_tokens(transaction.c_str())) << "Wrong number of tokens";
+        EXPECT_EQ(parsed_json.NumberOfTokens, MAX_NUMBER_OF_TOKENS) << "RAM window should be full";
+        EXPECT_EQ(parsed_json.NumberOfSpillTokens, token_count - MAX_NUMBER_OF_TOKENS) << "Wrong number of spilled tokens";
+
+        int msg_bytes = object_get_value(0, "msg_bytes", &parsed_json, transaction.c_str());
+        int outputs = object_get_value(msg_bytes, "outputs", &parsed_json, transaction.c_str());
+        EXPECT_EQ(array_get_element_count(outputs, &parsed_json), 60) << "Wrong number of array elements";
+
+        int output = array_get_nth_element(outputs, 59, &parsed_json);
+        int address = object_get_value(output, "address", &parsed_json, transaction.c_str());
+        ASSERT_GT(address, MAX_NUMBER_OF_TOKENS) << "Token should have been spilled";
+        const jsmntok_t* token = json_get_token(&parsed_json, address);
+        EXPECT_EQ(std::string(transaction.c_str() + token->start, token->end - token->start), "ADDR59");
+
+        int sequences = object_get_value(0, "sequences", &parsed_json, transaction.c_str());
+        EXPECT_EQ(json_get_token(&parsed_json, sequences)->type, JSMN_ARRAY) << "Wrong token type returned";
+    }
+
+    TEST(TransactionParserTest, Spill_Pages) {
+
+        auto transaction = transaction_with_outputs(60);
+
+        parsed_json_t parsed_json;
+        json_parse_spill(&parsed_json, transaction.c_str(), json_count_tokens(transaction.c_str()), spill_storage, 1024, spill_to_storage);
+
+        constexpr int screen_size = 100;
+        setup_context(&parsed_json, screen_size, transaction.c_str());
+        EXPECT_EQ(transaction_get_display_pages(), 3 + 2 + 2 * 60 + 1) << "Wrong number of displayable pages";
+
+        char key[screen_size];
+        char value[screen_size];
+        transaction_get_display_key_value(key, value, 3 + 2 + 2 * 59);
+        EXPECT_EQ_STR(key, "msg_bytes/outputs/address", "Wrong key");
+        EXPECT_EQ_STR(value, "ADDR59", "Wrong value");
+    }
+
+    TEST(TransactionParserTest, Spill_DoesNotFit) {
+
+        auto transaction = transaction_with_outputs(60);
+
+        parsed_json_t parsed_json;
+        int token_count = json_parse_spill(&parsed_json, transaction.c_str(), json_count_tokens(transaction.c_str()), spill_storage, 16, spill_to_storage);
+
+        EXPECT_EQ(token_count, -1) << "Spill region is too small";
+        EXPECT_FALSE(parsed_json.CorrectFormat);
+        EXPECT_EQ(json_get_token_count(&parsed_json), 0) << "No tokens should be available";
+    }
+
+    TEST(TransactionParserTest, Spill_CountMismatch) {
+
+        auto transaction = transaction_with_outputs(60);
+
+        parsed_json_t parsed_json;
+        int token_count = json_count_tokens(transaction.c_str());
+        EXPECT_EQ(json_parse_spill(&parsed_json, transaction.c_str(), token_count - 1, spill_storage, 1024, spill_to_storage), -1);
+        EXPECT_EQ(json_parse_spill(&parsed_json, transaction.c_str(), token_count + 1, spill_storage, 1024, spill_to_storage), -1);
+        EXPECT_EQ(json_parse_spill(&parsed_json, transaction.c_str(), token_count, spill_storage, 1024, spill_to_storage), token_count);
+    }
+
+    TEST(TransactionParserTest, ParseJob_SameTokensInSteps) {
+
+        auto transaction = transaction_with_outputs(60);
+        int token_count = json_count_tokens(transaction.c_str());
+
+        parsed_json_t expected;
+        json_parse_spill(&expected, transaction.c_str(), token_count, spill_storage, 1024, spill_to_storage);
+        std::vector<jsmntok_t> expected_spill(spill_storage, spill_storage + expected.NumberOfSpillTokens);
+
+        for (unsigned int step : {1u, 5u, 64u}) {
+            memset(spill_storage, 0, sizeof(spill_storage));
+            parsed_json_t parsed_json;
+            json_parse_job_t job;
+            ASSERT_EQ(json_parse_job_init(&job, &parsed_json, transaction.size(), token_count, 1024), 0);
+
+            int steps = 0;
+            int result;
+            while ((result = json_parse_job_step(&job, &parsed_json, transaction.c_str(), step, spill_storage, spill_to_storage)) == 1) {
+                steps++;
+                // Spilled tokens are only visible once the job is done
+                EXPECT_EQ(parsed_json.SpillTokens, nullptr);
+            }
+            ASSERT_EQ(result, 0) << "step " << step;
+            EXPECT_GE(steps, token_count / (int) step - 1) << "Every step reads a bounded number of tokens";
+
+            ASSERT_EQ(json_get_token_count(&parsed_json), token_count);
+            for (int i = 0; i < token_count; i++) {
+                const jsmntok_t* a = json_get_token(&expected, i);
+                const jsmntok_t* b = json_get_token(&parsed_json, i);
+                if (i >= MAX_NUMBER_OF_TOKENS) {
+                    a = &expected_spill[i - MAX_NUMBER_OF_TOKENS];
+                }
+                EXPECT_EQ(a->type, b->type) << "token " << i;
+                EXPECT_EQ(a->start, b->start) << "token " << i;
+                EXPECT_EQ(a->end, b->end) << "token " << i;
+                EXPECT_EQ(a->size, b->size) << "token " << i;
+            }
+        }
+    }
+
+    TEST(TransactionParserTest, ParseJob_RejectsJsonBeyond16Bit) {
+        parsed_json_t parsed_json;
+        json_parse_job_t job;
+        EXPECT_EQ(json_parse_job_init(&job, &parsed_json, UINT16_MAX, 1, 0), 0);
+        EXPECT_EQ(json_parse_job_init(&job, &parsed_json, UINT16_MAX + 1u, 1, 0), -1);
+
+        std::string transaction = "[\"" + std::string(UINT16_MAX, 'a') + "\"]";
+        EXPECT_EQ(json_parse_spill(&parsed_json, transaction.c_str(), 2, spill_storage, 1024, spill_to_storage), -1);
+    }
+
+    TEST(TransactionParserTest, DisplayCountJob_SameAsRecursiveCount) {
+
+        std::vector<std::string> transactions = {
+                transaction_with_outputs(1),
+                transaction_with_outputs(60),
+                R"({"alt_bytes":[],"chain_id":"c","fee_bytes":"","msg_bytes":[[1,[2,3]],{"a":{"b":{"c":1}}},{}],"sequences":[1]})",
+                R"({"alt_bytes":"","chain_id":"c","fee_bytes":1,"msg_bytes":{"k":["x",{"y":[1,2]}]},"sequences":[1]})",
+        };
+        for (const auto& transaction : transactions) {
+            parsed_json_t parsed_json;
+            json_parse_spill(&parsed_json, transaction.c_str(), json_count_tokens(transaction.c_str()), spill_storage, 1024, spill_to_storage);
+            setup_context(&parsed_json, 100, transaction.c_str());
+
+            for (const char* root : {"msg_bytes", "alt_bytes"}) {
+                int token_index = object_get_value(0, root, &parsed_json, transaction.c_str());
+                int expected = display_get_arbitrary_items_count(token_index);
+
+                for (int step : {1, 3, 1000}) {
+                    display_count_job_t job;
+                    display_count_job_init(&job, &parsed_json, token_index);
+                    int result;
+                    while ((result = display_count_job_step(&job, &parsed_json, step)) == 1) {
+                    }
+                    ASSERT_EQ(result, 0);
+                    EXPECT_EQ(job.count, expected) << root << " of " << transaction << ", step " << step;
+                }
+            }
+        }
+    }
+
 //    // TODO: Not yet implemented
 //    TEST(TransactionParserTest, correct_format) {
 //